@@ -0,0 +1,128 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace {
+    std::atomic<uint64_t> allocation_count{0};
+    std::atomic<uint64_t> curl_allocation_count{0};
+    std::atomic<uint64_t> free_count{0};
+
+    // Constant initialized, safe to touch from operator new at any point of a thread's life
+    thread_local uint64_t thread_allocation_count = 0;
+    thread_local uint64_t thread_curl_allocation_count = 0;
+
+    auto counted(void* pointer) -> void*
+    {
+        if (pointer)
+        {
+            allocation_count.fetch_add(1, std::memory_order_relaxed);
+            thread_allocation_count++;
+        }
+        return pointer;
+    }
+
+    auto curlCounted(void* pointer) -> void*
+    {
+        if (pointer)
+        {
+            curl_allocation_count.fetch_add(1, std::memory_order_relaxed);
+            thread_curl_allocation_count++;
+        }
+        return pointer;
+    }
+
+    auto release(void* pointer) -> void
+    {
+        if (pointer)
+        {
+            free_count.fetch_add(1, std::memory_order_relaxed);
+            std::free(pointer);
+        }
+    }
+
+    auto allocate(const std::size_t size) -> void*
+    {
+        if (void* pointer = counted(std::malloc(size ? size : 1)))
+        {
+            return pointer;
+        }
+        throw std::bad_alloc();
+    }
+
+    auto allocateAligned(const std::size_t size, const std::align_val_t alignment) -> void*
+    {
+        // aligned_alloc wants a non-zero multiple of the alignment, as malloc gets at least one byte
+        const auto align = static_cast<std::size_t>(alignment);
+        if (size > std::numeric_limits<std::size_t>::max() - align)
+        {
+            throw std::bad_alloc();
+        }
+
+        const auto rounded = size == 0 ? align : (size + align - 1) / align * align;
+        if (void* pointer = counted(std::aligned_alloc(align, rounded)))
+        {
+            return pointer;
+        }
+        throw std::bad_alloc();
+    }
+
+    auto curlMalloc(const size_t size) -> void* { return curlCounted(std::malloc(size)); }
+    auto curlFree(void* pointer) -> void { release(pointer); }
+    auto curlCalloc(const size_t count, const size_t size) -> void* { return curlCounted(std::calloc(count, size)); }
+    auto curlStrdup(const char* value) -> char* { return static_cast<char*>(curlCounted(strdup(value))); }
+
+    auto curlRealloc(void* pointer, const size_t size) -> void*
+    {
+        // Only a realloc from nothing is a new allocation
+        void* reallocated = std::realloc(pointer, size);
+        return pointer ? reallocated : curlCounted(reallocated);
+    }
+}
+
+auto AllocationCounter::process() -> Counts
+{
+    return {allocation_count.load(std::memory_order_relaxed), curl_allocation_count.load(std::memory_order_relaxed)};
+}
+
+auto AllocationCounter::currentThread() -> Counts
+{
+    return {thread_allocation_count, thread_curl_allocation_count};
+}
+
+auto AllocationCounter::live() -> int64_t
+{
+    const auto counts = process();
+    return static_cast<int64_t>(counts.allocations + counts.curl_allocations - free_count.load(std::memory_order_relaxed));
+}
+
+auto AllocationCounter::initializeCurl(const long flags) -> CURLcode
+{
+    return curl_global_init_mem(flags, curlMalloc, curlFree, curlRealloc, curlStrdup, curlCalloc);
+}
+
+void* operator new(const std::size_t size) { return allocate(size); }
+void* operator new[](const std::size_t size) { return allocate(size); }
+void* operator new(const std::size_t size, const std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](const std::size_t size, const std::align_val_t alignment) { return allocateAligned(size, alignment); }
+
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept { return counted(std::malloc(size ? size : 1)); }
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept { return counted(std::malloc(size ? size : 1)); }
+
+void operator delete(void* pointer) noexcept { release(pointer); }
+void operator delete[](void* pointer) noexcept { release(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { release(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { release(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { release(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { release(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { release(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { release(pointer); }
@@ -0,0 +1,32 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstdint>
+#include <curl/curl.h>
+
+// Counts the heap allocations of the process: every operator new, and
+// libcurl's own allocations once it is initialized through initializeCurl.
+// Counters are relaxed atomics, cheap enough to stay on in production.
+class AllocationCounter {
+public:
+    struct Counts {
+        uint64_t allocations = 0;
+        uint64_t curl_allocations = 0;
+    };
+
+    // Since the start of the process
+    [[nodiscard]] static auto process() -> Counts;
+    // Since the start of the calling thread, to measure a section without the other threads
+    [[nodiscard]] static auto currentThread() -> Counts;
+    // Allocations not freed yet, flat when memory does not grow
+    [[nodiscard]] static auto live() -> int64_t;
+
+    // curl_global_init with counting allocators
+    [[nodiscard]] static auto initializeCurl(long flags) -> CURLcode;
+};
+
+#endif //ALLOCATION_COUNTER_H
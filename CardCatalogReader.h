@@ -0,0 +1,249 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef CARD_CATALOG_READER_H
+#define CARD_CATALOG_READER_H
+
+// Header only reader for the catalog/<lang>.cat files, meant to be copied into
+// consumers: the catalog is memory-mapped and every string is a view into the
+// mapping, so opening it costs one bounds check per record and no copy.
+//
+// Layout (little endian, every section 8 bytes aligned):
+//   CardCatalogHeader
+//   CardCatalogSet[set_count], sorted by set id (byte order)
+//   CardCatalogCard[card_count], grouped by set in set order
+//   string pool (interned, not NUL terminated)
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct CardCatalogString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct CardCatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t set_count;
+    uint32_t card_count;
+    CardCatalogString language;
+    uint32_t reserved;
+    uint64_t sets_offset;
+    uint64_t cards_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct CardCatalogSet {
+    CardCatalogString id;
+    CardCatalogString name;
+    CardCatalogString serie_id;
+    CardCatalogString release_date;
+    // <quality>.<format> of the image paths, e.g. "high.jpg"
+    CardCatalogString image_variant;
+    uint32_t first_card;
+    uint32_t card_count;
+};
+
+struct CardCatalogCard {
+    uint32_t set_index;
+    CardCatalogString local_id;
+    CardCatalogString name;
+    CardCatalogString image_path;
+    // XXH3-128 of the image, all zero when it was never downloaded
+    std::array<uint8_t, 16> digest;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(CardCatalogHeader) == 64);
+static_assert(sizeof(CardCatalogSet) == 48);
+static_assert(sizeof(CardCatalogCard) == 48);
+
+inline constexpr char card_catalog_magic[8] = {'P', 'K', 'S', 'C', 'C', 'A', 'T', '\0'};
+inline constexpr uint32_t card_catalog_version = 2;
+
+class CardCatalogReader {
+    void* m_data{MAP_FAILED};
+    size_t m_size{0};
+    const CardCatalogHeader* m_header{nullptr};
+    std::span<const CardCatalogSet> m_sets;
+    std::span<const CardCatalogCard> m_cards;
+    const char* m_strings{nullptr};
+
+public:
+    CardCatalogReader() = default;
+    CardCatalogReader(const CardCatalogReader&) = delete;
+    CardCatalogReader& operator=(const CardCatalogReader&) = delete;
+
+    CardCatalogReader(CardCatalogReader&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    CardCatalogReader& operator=(CardCatalogReader&& other) noexcept
+    {
+        if (this != &other)
+        {
+            close();
+            std::swap(m_data, other.m_data);
+            std::swap(m_size, other.m_size);
+            std::swap(m_header, other.m_header);
+            std::swap(m_sets, other.m_sets);
+            std::swap(m_cards, other.m_cards);
+            std::swap(m_strings, other.m_strings);
+        }
+        return *this;
+    }
+
+    ~CardCatalogReader()
+    {
+        close();
+    }
+
+    auto open(const std::string& path) -> bool
+    {
+        close();
+
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CardCatalogHeader))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        m_size = static_cast<size_t>(st.st_size);
+        m_data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (m_data == MAP_FAILED)
+        {
+            return false;
+        }
+
+        const auto base = static_cast<const char*>(m_data);
+        m_header = reinterpret_cast<const CardCatalogHeader*>(base);
+
+        if (std::memcmp(m_header->magic, card_catalog_magic, sizeof(card_catalog_magic)) != 0 ||
+            m_header->version != card_catalog_version ||
+            !fits(m_header->sets_offset, uint64_t{m_header->set_count} * sizeof(CardCatalogSet), m_size) ||
+            !fits(m_header->cards_offset, uint64_t{m_header->card_count} * sizeof(CardCatalogCard), m_size) ||
+            !fits(m_header->strings_offset, m_header->strings_size, m_size))
+        {
+            close();
+            return false;
+        }
+
+        m_sets = {reinterpret_cast<const CardCatalogSet*>(base + m_header->sets_offset), m_header->set_count};
+        m_cards = {reinterpret_cast<const CardCatalogCard*>(base + m_header->cards_offset), m_header->card_count};
+        m_strings = base + m_header->strings_offset;
+
+        if (!isValid())
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    auto close() -> void
+    {
+        if (m_data != MAP_FAILED)
+        {
+            munmap(m_data, m_size);
+        }
+
+        m_data = MAP_FAILED;
+        m_size = 0;
+        m_header = nullptr;
+        m_sets = {};
+        m_cards = {};
+        m_strings = nullptr;
+    }
+
+    [[nodiscard]] auto isOpen() const -> bool { return m_header != nullptr; }
+    [[nodiscard]] auto size() const -> size_t { return m_size; }
+
+    [[nodiscard]] auto language() const -> std::string_view { return m_header ? string(m_header->language) : std::string_view{}; }
+    [[nodiscard]] auto sets() const -> std::span<const CardCatalogSet> { return m_sets; }
+    [[nodiscard]] auto cards() const -> std::span<const CardCatalogCard> { return m_cards; }
+
+    [[nodiscard]] auto cards(const CardCatalogSet& set) const -> std::span<const CardCatalogCard>
+    {
+        return m_cards.subspan(set.first_card, set.card_count);
+    }
+
+    [[nodiscard]] auto string(const CardCatalogString& value) const -> std::string_view
+    {
+        return {m_strings + value.offset, value.length};
+    }
+
+    [[nodiscard]] auto findSet(const std::string_view id) const -> const CardCatalogSet*
+    {
+        const auto it = std::lower_bound(m_sets.begin(), m_sets.end(), id, [this](const CardCatalogSet& set, const std::string_view value)
+        {
+            return string(set.id) < value;
+        });
+
+        return it != m_sets.end() && string(it->id) == id ? &*it : nullptr;
+    }
+
+private:
+    static auto fits(const uint64_t offset, const uint64_t length, const uint64_t size) -> bool
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    [[nodiscard]] auto fits(const CardCatalogString& value) const -> bool
+    {
+        return fits(value.offset, value.length, m_header->strings_size);
+    }
+
+    // Every index and string the accessors follow stays inside the mapping,
+    // a truncated or corrupted file is refused instead of read out of bounds
+    [[nodiscard]] auto isValid() const -> bool
+    {
+        if (!fits(m_header->language))
+        {
+            return false;
+        }
+
+        for (const auto& set : m_sets)
+        {
+            if (!fits(set.id) || !fits(set.name) || !fits(set.serie_id) || !fits(set.release_date) || !fits(set.image_variant) ||
+                !fits(set.first_card, set.card_count, m_cards.size()))
+            {
+                return false;
+            }
+        }
+
+        for (const auto& card : m_cards)
+        {
+            if (card.set_index >= m_sets.size() || !fits(card.local_id) || !fits(card.name) || !fits(card.image_path))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+#endif //CARD_CATALOG_READER_H
@@ -0,0 +1,343 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "CardCatalogWriter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fmt/format.h>
+
+#include "Hasher.h"
+#include "Logs.h"
+
+namespace {
+    // Interns every string once in the pool
+    class StringPool {
+        std::string m_data;
+        std::unordered_map<std::string, CardCatalogString> m_strings;
+
+    public:
+        auto add(const std::string_view value) -> CardCatalogString
+        {
+            if (const auto it = m_strings.find(std::string(value)); it != m_strings.end())
+            {
+                return it->second;
+            }
+
+            const CardCatalogString string {static_cast<uint32_t>(m_data.size()), static_cast<uint32_t>(value.size())};
+            m_data.append(value);
+            m_strings.emplace(value, string);
+
+            return string;
+        }
+
+        [[nodiscard]] auto data() const -> const std::string& { return m_data; }
+    };
+
+    auto align(const uint64_t offset) -> uint64_t
+    {
+        return (offset + 7) & ~static_cast<uint64_t>(7);
+    }
+}
+
+CardCatalogWriter::CardCatalogWriter(std::string lang_id, const std::filesystem::path& root)
+    : m_lang_id(std::move(lang_id)), m_path(catalogPath(m_lang_id, root))
+{
+    if (m_previous.open(m_path.string()))
+    {
+        APP_TRACE("{}: previous catalog has {} sets", m_path.string(), m_previous.sets().size());
+    }
+}
+
+auto CardCatalogWriter::catalogPath(const std::string& lang_id, const std::filesystem::path& root) -> std::filesystem::path
+{
+    return root / fmt::format("{}.cat", lang_id);
+}
+
+auto CardCatalogWriter::needsParsedSet(const std::string& set_id, const bool has_changed, const Catalog::Variant& variant) const -> bool
+{
+    if (has_changed)
+    {
+        return true;
+    }
+
+    // A set whose image variant changed points at other files
+    const auto* previous_set = m_previous.findSet(set_id);
+    return !previous_set || m_previous.string(previous_set->image_variant) != fmt::format("{}.{}", variant.quality, variant.format);
+}
+
+auto CardCatalogWriter::addSet(Catalog::Set set, Catalog::Variant variant) -> void
+{
+    auto set_id = set.set_id;
+    m_sets.insert_or_assign(std::move(set_id), ParsedSet{std::move(set), std::move(variant)});
+}
+
+auto CardCatalogWriter::keepSet(const std::string& set_id) -> void
+{
+    m_sets.try_emplace(set_id, std::nullopt);
+}
+
+auto CardCatalogWriter::write(const DatabaseManager& database_manager, const std::unordered_map<std::string, std::string>& changed_image_digests, ChangeFeed* change_feed) -> bool
+{
+    StringPool strings;
+    std::vector<CardCatalogSet> sets;
+    std::vector<CardCatalogCard> cards;
+
+    sets.reserve(m_sets.size());
+
+    // m_sets is ordered by set id, as readers expect
+    for (const auto& [set_id, parsed] : m_sets)
+    {
+        CardCatalogSet set{};
+        set.first_card = static_cast<uint32_t>(cards.size());
+
+        if (parsed.has_value())
+        {
+            set.id = strings.add(parsed->set.set_id);
+            set.name = strings.add(parsed->set.name);
+            set.serie_id = strings.add(parsed->set.serie_id);
+            set.release_date = strings.add(parsed->set.release_date);
+            set.image_variant = strings.add(fmt::format("{}.{}", parsed->variant.quality, parsed->variant.format));
+
+            for (const auto& parsed_card : parsed->set.cards)
+            {
+                const auto image_path = Catalog::imagePath(parsed->set, parsed_card, parsed->variant);
+
+                CardCatalogCard card{};
+                card.set_index = static_cast<uint32_t>(sets.size());
+                card.local_id = strings.add(parsed_card.local_id);
+                card.name = strings.add(parsed_card.name);
+                card.image_path = strings.add(image_path);
+
+                if (const auto it = changed_image_digests.find(image_path); it != changed_image_digests.end())
+                {
+                    card.digest = parseDigest(it->second);
+                }
+                else if (const auto uri_metadata = database_manager.getUriMetadata(Catalog::imageUri(parsed_card, parsed->variant)); uri_metadata.has_value())
+                {
+                    card.digest = parseDigest(uri_metadata->digest);
+                }
+
+                cards.push_back(card);
+            }
+        }
+        else if (const auto* previous_set = m_previous.findSet(set_id))
+        {
+            set.id = strings.add(m_previous.string(previous_set->id));
+            set.name = strings.add(m_previous.string(previous_set->name));
+            set.serie_id = strings.add(m_previous.string(previous_set->serie_id));
+            set.release_date = strings.add(m_previous.string(previous_set->release_date));
+            set.image_variant = strings.add(m_previous.string(previous_set->image_variant));
+
+            for (const auto& previous_card : m_previous.cards(*previous_set))
+            {
+                const auto image_path = m_previous.string(previous_card.image_path);
+
+                CardCatalogCard card = previous_card;
+                card.set_index = static_cast<uint32_t>(sets.size());
+                card.local_id = strings.add(m_previous.string(previous_card.local_id));
+                card.name = strings.add(m_previous.string(previous_card.name));
+                card.image_path = strings.add(image_path);
+
+                if (const auto it = changed_image_digests.find(std::string(image_path)); it != changed_image_digests.end())
+                {
+                    card.digest = parseDigest(it->second);
+                }
+
+                cards.push_back(card);
+            }
+        }
+        else
+        {
+            APP_WARN("{}: set {} is neither parsed nor in the previous catalog", m_path.string(), set_id);
+            continue;
+        }
+
+        set.card_count = static_cast<uint32_t>(cards.size()) - set.first_card;
+        sets.push_back(set);
+    }
+
+    CardCatalogHeader header{};
+    std::memcpy(header.magic, card_catalog_magic, sizeof(card_catalog_magic));
+    header.version = card_catalog_version;
+    header.set_count = static_cast<uint32_t>(sets.size());
+    header.card_count = static_cast<uint32_t>(cards.size());
+    header.language = strings.add(m_lang_id);
+    header.sets_offset = align(sizeof(CardCatalogHeader));
+    header.cards_offset = align(header.sets_offset + sets.size() * sizeof(CardCatalogSet));
+    header.strings_offset = align(header.cards_offset + cards.size() * sizeof(CardCatalogCard));
+    header.strings_size = strings.data().size();
+
+    // Readers may have the previous catalog mapped: write aside and rename
+    std::error_code ec;
+    std::filesystem::create_directories(m_path.parent_path(), ec);
+
+    const auto temporary_path = std::filesystem::path(m_path).concat(".tmp");
+    {
+        static constexpr char padding[8] = {};
+
+        std::ofstream ofs(temporary_path, std::ios::out | std::ios::trunc | std::ios::binary);
+
+        const auto pad_to = [&ofs](const uint64_t offset)
+        {
+            ofs.write(padding, static_cast<std::streamsize>(offset - static_cast<uint64_t>(ofs.tellp())));
+        };
+
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        pad_to(header.sets_offset);
+        ofs.write(reinterpret_cast<const char*>(sets.data()), static_cast<std::streamsize>(sets.size() * sizeof(CardCatalogSet)));
+        pad_to(header.cards_offset);
+        ofs.write(reinterpret_cast<const char*>(cards.data()), static_cast<std::streamsize>(cards.size() * sizeof(CardCatalogCard)));
+        pad_to(header.strings_offset);
+        ofs.write(strings.data().data(), static_cast<std::streamsize>(strings.data().size()));
+
+        // The last buffer is only written by close(), a full disk shows up there
+        ofs.close();
+        if (!ofs)
+        {
+            APP_ERROR("Unable to write {}", temporary_path.string());
+            return false;
+        }
+    }
+
+    // On disk before the rename makes it visible
+    const int temporary_fd = ::open(temporary_path.c_str(), O_RDONLY | O_CLOEXEC);
+    const int sync_error = temporary_fd < 0 || ::fsync(temporary_fd) != 0 ? errno : 0;
+    if (temporary_fd >= 0)
+    {
+        ::close(temporary_fd);
+    }
+
+    if (sync_error != 0)
+    {
+        APP_ERROR("Unable to sync {}: {}", temporary_path.string(), std::strerror(sync_error));
+        return false;
+    }
+
+    std::optional<std::string> catalog_digest;
+    std::optional<std::string> previous_catalog_digest;
+    uint64_t catalog_size = 0;
+
+    if (change_feed)
+    {
+        std::unordered_set<std::string_view> image_paths;
+        image_paths.reserve(cards.size());
+        for (const auto& card : cards)
+        {
+            image_paths.insert(std::string_view(strings.data()).substr(card.image_path.offset, card.image_path.length));
+        }
+
+        // Packed images have no file, their size stays 0
+        const auto file_size = [](const std::string& path) -> uint64_t
+        {
+            std::error_code size_ec;
+            const auto size = std::filesystem::file_size(path, size_ec);
+            return size_ec ? 0 : size;
+        };
+
+        std::unordered_set<std::string_view> previous_image_paths;
+        previous_image_paths.reserve(m_previous.cards().size());
+        for (const auto& previous_card : m_previous.cards())
+        {
+            const auto image_path = m_previous.string(previous_card.image_path);
+            previous_image_paths.insert(image_path);
+
+            if (!image_paths.contains(image_path))
+            {
+                auto path = std::string(image_path);
+                const auto size = file_size(path);
+                change_feed->record(ChangeFeed::Action::Removed, ChangeFeed::Kind::Image, "", std::move(path), formatDigest(previous_card.digest), size);
+            }
+        }
+
+        // Listed again without being downloaded, the file was already there. Downloaded images are recorded by the download.
+        if (m_previous.isOpen())
+        {
+            for (const auto& card : cards)
+            {
+                if (auto image_path = std::string(strings.data(), card.image_path.offset, card.image_path.length);
+                    !previous_image_paths.contains(image_path) && !changed_image_digests.contains(image_path))
+                {
+                    const auto size = file_size(image_path);
+                    change_feed->record(ChangeFeed::Action::Added, ChangeFeed::Kind::Image, "", std::move(image_path), formatDigest(card.digest), size);
+                }
+            }
+        }
+
+        uint64_t previous_size = 0;
+        catalog_digest = Hasher::fileDigest(temporary_path.string(), catalog_size);
+        previous_catalog_digest = Hasher::fileDigest(m_path.string(), previous_size);
+    }
+
+    // The previous mapping is no longer needed
+    m_previous.close();
+
+    std::filesystem::rename(temporary_path, m_path, ec);
+    if (ec)
+    {
+        APP_ERROR("Unable to write {}: {}", m_path.string(), ec.message());
+        return false;
+    }
+
+    if (change_feed && catalog_digest != previous_catalog_digest)
+    {
+        change_feed->record(previous_catalog_digest.has_value() ? ChangeFeed::Action::Modified : ChangeFeed::Action::Added,
+            ChangeFeed::Kind::Catalog, "", m_path.string(), catalog_digest.value_or(""), catalog_size);
+    }
+
+    APP_INFO("{}: {} sets, {} cards", m_path.string(), sets.size(), cards.size());
+
+    return true;
+}
+
+auto CardCatalogWriter::parseDigest(const std::string& hex) -> std::array<uint8_t, 16>
+{
+    std::array<uint8_t, 16> digest{};
+
+    if (hex.size() != digest.size() * 2)
+    {
+        return digest;
+    }
+
+    const auto nibble = [](const char c) -> uint8_t
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return 0;
+    };
+
+    for (size_t i = 0; i < digest.size(); i++)
+    {
+        digest[i] = static_cast<uint8_t>(nibble(hex[i * 2]) << 4 | nibble(hex[i * 2 + 1]));
+    }
+
+    return digest;
+}
+
+auto CardCatalogWriter::formatDigest(const std::array<uint8_t, 16>& digest) -> std::string
+{
+    static constexpr char hex[] = "0123456789abcdef";
+
+    if (std::ranges::all_of(digest, [](const uint8_t byte) { return byte == 0; }))
+    {
+        return {};
+    }
+
+    std::string result(digest.size() * 2, '0');
+    for (size_t i = 0; i < digest.size(); i++)
+    {
+        result[i * 2] = hex[digest[i] >> 4];
+        result[i * 2 + 1] = hex[digest[i] & 0x0F];
+    }
+
+    return result;
+}
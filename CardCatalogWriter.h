@@ -0,0 +1,62 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef CARD_CATALOG_WRITER_H
+#define CARD_CATALOG_WRITER_H
+
+#include <array>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "Catalog.h"
+#include "CardCatalogReader.h"
+#include "ChangeFeed.h"
+#include "DatabaseManager.h"
+
+// Builds catalog/<lang>.cat after a sync. Sets whose cards.json did not change
+// are copied from the previous catalog, only changed or new sets are taken
+// from the parsed JSON.
+class CardCatalogWriter {
+    std::string m_lang_id;
+    std::filesystem::path m_path;
+    CardCatalogReader m_previous;
+
+    struct ParsedSet {
+        Catalog::Set set;
+        // Image variant the cards point at
+        Catalog::Variant variant;
+    };
+
+    // Set id -> parsed set, or nullopt to copy it from the previous catalog
+    std::map<std::string, std::optional<ParsedSet>> m_sets;
+
+public:
+    explicit CardCatalogWriter(std::string lang_id, const std::filesystem::path& root = "catalog");
+
+    [[nodiscard]] auto langId() const -> const std::string& { return m_lang_id; }
+    // Catalog written by the previous sync, closed when there was none
+    [[nodiscard]] auto previous() const -> const CardCatalogReader& { return m_previous; }
+
+    [[nodiscard]] static auto catalogPath(const std::string& lang_id, const std::filesystem::path& root = "catalog") -> std::filesystem::path;
+
+    // Whether the set has to be given as parsed JSON
+    [[nodiscard]] auto needsParsedSet(const std::string& set_id, bool has_changed, const Catalog::Variant& variant = {}) const -> bool;
+
+    auto addSet(Catalog::Set set, Catalog::Variant variant = {}) -> void;
+    auto keepSet(const std::string& set_id) -> void;
+
+    // Digests come from uri_metadata for parsed sets, and from image path -> digest for images downloaded again.
+    // The change feed gets the images the previous catalog listed and this one does not, and the catalog itself.
+    [[nodiscard]] auto write(const DatabaseManager& database_manager, const std::unordered_map<std::string, std::string>& changed_image_digests, ChangeFeed* change_feed = nullptr) -> bool;
+
+private:
+    static auto parseDigest(const std::string& hex) -> std::array<uint8_t, 16>;
+    // Empty for a card whose digest was never recorded
+    static auto formatDigest(const std::array<uint8_t, 16>& digest) -> std::string;
+};
+
+#endif //CARD_CATALOG_WRITER_H
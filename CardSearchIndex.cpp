@@ -0,0 +1,243 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "CardSearchIndex.h"
+
+#include <algorithm>
+
+#include "Catalog.h"
+#include "Logs.h"
+
+CardSearchIndex::CardSearchIndex(std::filesystem::path root)
+    : m_root(std::move(root))
+{
+}
+
+auto CardSearchIndex::load() -> bool
+{
+    m_languages.clear();
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(m_root, ec))
+    {
+        if (entry.path().extension() != ".cat")
+        {
+            continue;
+        }
+
+        auto language = std::make_unique<Language>();
+        if (!language->catalog.open(entry.path().string()))
+        {
+            APP_ERROR("{}: Not a valid card catalog", entry.path().string());
+            continue;
+        }
+
+        build(*language);
+
+        m_languages.push_back(std::move(language));
+    }
+
+    if (ec)
+    {
+        APP_ERROR("Unable to read {}: {}", m_root.string(), ec.message());
+    }
+
+    std::ranges::sort(m_languages, {}, [](const auto& language) { return language->catalog.language(); });
+
+    return !m_languages.empty();
+}
+
+auto CardSearchIndex::build(Language& language) -> void
+{
+    const auto& catalog = language.catalog;
+    const auto cards = catalog.cards();
+
+    // Reserve the pools up front: the map keys are views into them
+    size_t keys_size = 0;
+    for (const auto& card : cards)
+    {
+        keys_size += catalog.string(catalog.sets()[card.set_index].id).size() + 1 + card.local_id.length;
+    }
+
+    language.keys.reserve(keys_size);
+    language.cards.reserve(cards.size());
+    language.name_entries.reserve(cards.size());
+
+    std::unordered_map<std::string, NameEntry> interned;
+
+    for (uint32_t i = 0; i < cards.size(); i++)
+    {
+        const auto& card = cards[i];
+
+        const auto key_offset = language.keys.size();
+        language.keys.append(catalog.string(catalog.sets()[card.set_index].id));
+        language.keys.push_back('\0');
+        language.keys.append(catalog.string(card.local_id));
+        language.cards.try_emplace(std::string_view(language.keys).substr(key_offset), i);
+
+        auto normalized = normalize(catalog.string(card.name));
+        auto [it, inserted] = interned.try_emplace(std::move(normalized));
+        if (inserted)
+        {
+            it->second = {static_cast<uint32_t>(language.names.size()), static_cast<uint32_t>(it->first.size()), 0};
+            language.names.append(it->first);
+        }
+
+        language.name_entries.push_back({it->second.offset, it->second.length, i});
+    }
+
+    language.names.shrink_to_fit();
+
+    const std::string_view names = language.names;
+    std::ranges::sort(language.name_entries, [names](const NameEntry& a, const NameEntry& b)
+    {
+        const auto a_name = names.substr(a.offset, a.length);
+        const auto b_name = names.substr(b.offset, b.length);
+        return a_name != b_name ? a_name < b_name : a.card < b.card;
+    });
+
+    APP_TRACE("{}: {} cards, {} distinct names", catalog.language(), cards.size(), interned.size());
+}
+
+auto CardSearchIndex::languages() const -> std::vector<std::string_view>
+{
+    std::vector<std::string_view> lang_ids;
+    lang_ids.reserve(m_languages.size());
+
+    for (const auto& language : m_languages)
+    {
+        lang_ids.push_back(language->catalog.language());
+    }
+
+    return lang_ids;
+}
+
+auto CardSearchIndex::cardCount() const -> size_t
+{
+    size_t count = 0;
+    for (const auto& language : m_languages)
+    {
+        count += language->catalog.cards().size();
+    }
+    return count;
+}
+
+auto CardSearchIndex::findByPrefix(const std::string_view prefix, const std::vector<std::string>& lang_ids, const size_t limit) const -> std::vector<Match>
+{
+    const auto normalized = normalize(prefix);
+    std::vector<Match> matches;
+
+    for (const auto& language : m_languages)
+    {
+        if (matches.size() >= limit)
+        {
+            break;
+        }
+
+        if (!lang_ids.empty() && std::ranges::find(lang_ids, language->catalog.language()) == lang_ids.end())
+        {
+            continue;
+        }
+
+        const std::string_view names = language->names;
+        const auto name_of = [names](const NameEntry& entry) { return names.substr(entry.offset, entry.length); };
+
+        for (auto it = std::ranges::lower_bound(language->name_entries, std::string_view(normalized), {}, name_of);
+             it != language->name_entries.end() && name_of(*it).starts_with(normalized) && matches.size() < limit;
+             ++it)
+        {
+            matches.push_back(match(*language, it->card));
+        }
+    }
+
+    return matches;
+}
+
+auto CardSearchIndex::find(const std::string_view lang_id, const std::string_view set_id, const std::string_view local_id) const -> std::optional<Match>
+{
+    const auto* language = findLanguage(lang_id);
+    if (language == nullptr)
+    {
+        return std::nullopt;
+    }
+
+    std::string key;
+    key.reserve(set_id.size() + 1 + local_id.size());
+    key.append(set_id).push_back('\0');
+    key.append(local_id);
+
+    const auto it = language->cards.find(key);
+    if (it == language->cards.end())
+    {
+        return std::nullopt;
+    }
+
+    return match(*language, it->second);
+}
+
+auto CardSearchIndex::memoryUsage() const -> size_t
+{
+    // Node based map: one node (pair, cached hash, next pointer) per card plus the buckets
+    constexpr size_t node_size = sizeof(std::pair<const std::string_view, uint32_t>) + sizeof(size_t) + sizeof(void*);
+
+    size_t bytes = m_languages.capacity() * sizeof(std::unique_ptr<Language>);
+
+    for (const auto& language : m_languages)
+    {
+        bytes += sizeof(Language);
+        bytes += language->names.capacity();
+        bytes += language->name_entries.capacity() * sizeof(NameEntry);
+        bytes += language->keys.capacity();
+        bytes += language->cards.size() * node_size + language->cards.bucket_count() * sizeof(void*);
+    }
+
+    return bytes;
+}
+
+auto CardSearchIndex::mappedSize() const -> size_t
+{
+    size_t bytes = 0;
+    for (const auto& language : m_languages)
+    {
+        bytes += language->catalog.size();
+    }
+    return bytes;
+}
+
+auto CardSearchIndex::normalize(const std::string_view name) -> std::string
+{
+    auto normalized = Catalog::sanitizeForPath(std::string(name));
+
+    for (auto& c : normalized)
+    {
+        // Bytes of UTF-8 sequences are >= 0x80 and left untouched
+        if (c >= 'A' && c <= 'Z')
+        {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+    }
+
+    return normalized;
+}
+
+auto CardSearchIndex::match(const Language& language, const uint32_t card) -> Match
+{
+    const auto& catalog = language.catalog;
+    const auto& record = catalog.cards()[card];
+
+    return {
+        catalog.language(),
+        catalog.string(catalog.sets()[record.set_index].id),
+        catalog.string(record.local_id),
+        catalog.string(record.name),
+        catalog.string(record.image_path)
+    };
+}
+
+auto CardSearchIndex::findLanguage(const std::string_view lang_id) const -> const Language*
+{
+    const auto it = std::ranges::lower_bound(m_languages, lang_id, {}, [](const auto& language) { return language->catalog.language(); });
+
+    return it != m_languages.end() && (*it)->catalog.language() == lang_id ? it->get() : nullptr;
+}
@@ -0,0 +1,81 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef CARD_SEARCH_INDEX_H
+#define CARD_SEARCH_INDEX_H
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "CardCatalogReader.h"
+
+// Card lookups over the catalog/<lang>.cat files. Set ids, local ids, names
+// and image paths are views into the mapped catalogs; only the normalized
+// names and the lookup tables are built in memory.
+class CardSearchIndex {
+public:
+    struct Match {
+        std::string_view lang_id;
+        std::string_view set_id;
+        std::string_view local_id;
+        std::string_view name;
+        std::string_view image_path;
+    };
+
+private:
+    struct NameEntry {
+        // Interned normalized name in Language::names
+        uint32_t offset;
+        uint32_t length;
+        uint32_t card;
+    };
+
+    struct Language {
+        CardCatalogReader catalog;
+        std::string names;
+        // Sorted by normalized name, then catalog order
+        std::vector<NameEntry> name_entries;
+        // "<set id>\0<local id>" in Language::keys -> card
+        std::string keys;
+        std::unordered_map<std::string_view, uint32_t> cards;
+    };
+
+    std::filesystem::path m_root;
+    // Sorted by language id, pointers keep the views stable
+    std::vector<std::unique_ptr<Language>> m_languages;
+
+public:
+    explicit CardSearchIndex(std::filesystem::path root = "catalog");
+
+    // Loads every catalog/<lang>.cat, returns false when none could be opened
+    [[nodiscard]] auto load() -> bool;
+
+    [[nodiscard]] auto languages() const -> std::vector<std::string_view>;
+    [[nodiscard]] auto cardCount() const -> size_t;
+
+    // Cards whose normalized name starts with the normalized prefix, in all
+    // languages when lang_ids is empty
+    [[nodiscard]] auto findByPrefix(std::string_view prefix, const std::vector<std::string>& lang_ids = {}, size_t limit = 50) const -> std::vector<Match>;
+    [[nodiscard]] auto find(std::string_view lang_id, std::string_view set_id, std::string_view local_id) const -> std::optional<Match>;
+
+    // Heap bytes owned by the index, the mapped catalogs are not included
+    [[nodiscard]] auto memoryUsage() const -> size_t;
+    [[nodiscard]] auto mappedSize() const -> size_t;
+
+    // ASCII lower case over the characters sanitizeForPath keeps, UTF-8
+    // sequences are compared byte for byte
+    [[nodiscard]] static auto normalize(std::string_view name) -> std::string;
+
+private:
+    static auto build(Language& language) -> void;
+    static auto match(const Language& language, uint32_t card) -> Match;
+    auto findLanguage(std::string_view lang_id) const -> const Language*;
+};
+
+#endif //CARD_SEARCH_INDEX_H
@@ -0,0 +1,332 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "Catalog.h"
+
+#include <cassert>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+#include <fmt/format.h>
+#include <rapidjson/document.h>
+#include <rapidjson/error/en.h>
+#include <zlib.h>
+
+#include "Logs.h"
+
+namespace {
+    // rapidjson input stream over zlib: gzip files are inflated while they
+    // are parsed, plain files are read as is
+    class GzipReadStream {
+    public:
+        typedef char Ch;
+
+        explicit GzipReadStream(const std::filesystem::path& path)
+            : m_file(gzopen(path.c_str(), "rb"))
+        {
+            if (m_file)
+            {
+                gzbuffer(m_file, sizeof(m_buffer));
+            }
+            read();
+        }
+
+        GzipReadStream(const GzipReadStream&) = delete;
+        GzipReadStream& operator=(const GzipReadStream&) = delete;
+
+        ~GzipReadStream()
+        {
+            close();
+        }
+
+        auto close() -> void
+        {
+            if (m_file)
+            {
+                gzclose(m_file);
+                m_file = nullptr;
+            }
+        }
+
+        [[nodiscard]] Ch Peek() const { return *m_current; }
+        Ch Take() { const Ch c = *m_current; read(); return c; }
+        [[nodiscard]] size_t Tell() const { return m_count + static_cast<size_t>(m_current - m_buffer); }
+
+        // Not an output stream
+        Ch* PutBegin() { assert(false); return nullptr; }
+        void Put(Ch) { assert(false); }
+        void Flush() { assert(false); }
+        size_t PutEnd(Ch*) { assert(false); return 0; }
+
+    private:
+        gzFile m_file;
+        char m_buffer[64 * 1024]{};
+        char* m_current{m_buffer};
+        char* m_last{m_buffer};
+        size_t m_read_count{0};
+        size_t m_count{0};
+        bool m_eof{false};
+
+        auto read() -> void
+        {
+            if (m_current < m_last)
+            {
+                ++m_current;
+                return;
+            }
+
+            if (m_eof)
+            {
+                return;
+            }
+
+            m_count += m_read_count;
+
+            const int read_count = m_file ? gzread(m_file, m_buffer, sizeof(m_buffer) - 1) : 0;
+            m_read_count = read_count > 0 ? static_cast<size_t>(read_count) : 0;
+            m_current = m_buffer;
+            m_last = m_buffer + m_read_count - 1;
+
+            // A short read is the end: put the terminating NUL after the data
+            if (m_read_count < sizeof(m_buffer) - 1)
+            {
+                m_buffer[m_read_count] = '\0';
+                ++m_last;
+                m_eof = true;
+            }
+        }
+    };
+}
+
+auto Catalog::readSetIds(const std::filesystem::path& json_sets_path) -> std::optional<std::vector<std::string>>
+{
+    APP_TRACE("{}: Read json file...", json_sets_path.string());
+
+    GzipReadStream isw(json_sets_path);
+    rapidjson::Document doc;
+
+    doc.ParseStream(isw);
+
+    if (doc.HasParseError()) {
+        APP_ERROR("{}: Does not have valid JSON, removing file !", json_sets_path.string());
+        APP_ERROR("  Reason: {}", rapidjson::GetParseError_En(doc.GetParseError()));
+        APP_ERROR("  At: {}", doc.GetErrorOffset());
+        APP_ERROR("  -> Removing file !", json_sets_path.string());
+
+        isw.close();
+
+        std::filesystem::remove(json_sets_path);
+
+        return std::nullopt;
+    }
+
+    if (!doc.IsArray())
+    {
+        APP_ERROR("{}: Root is not an array, removing file !", json_sets_path.string());
+
+        isw.close();
+
+        std::filesystem::remove(json_sets_path);
+
+        return std::nullopt;
+    }
+
+    APP_TRACE("{}: Have {} sets", json_sets_path.string(), doc.Size());
+
+    std::vector<std::string> set_ids;
+    set_ids.reserve(doc.Size());
+
+    for (const auto& set: doc.GetArray())
+    {
+        if (!set.IsObject() || !set.HasMember("id") || !set["id"].IsString())
+        {
+            APP_ERROR("{}: Invalid set format, removing file !", json_sets_path.string());
+
+            isw.close();
+
+            std::filesystem::remove(json_sets_path);
+
+            continue;
+        }
+
+        std::string set_id = set["id"].GetString();
+
+        APP_TRACE("{}: set id {}", json_sets_path.string(), set_id);
+
+        set_ids.push_back(std::move(set_id));
+    }
+
+    return set_ids;
+}
+
+auto Catalog::readSet(const std::filesystem::path& json_cards_path, const std::string& lang_id, const std::string& set_id) -> std::optional<Set>
+{
+    APP_TRACE("{}: Read json file for lang id {} and set id {}...", json_cards_path.string(), lang_id, set_id);
+
+    GzipReadStream isw(json_cards_path);
+    rapidjson::Document doc;
+
+    doc.ParseStream(isw);
+
+    if (doc.HasParseError()) {
+        APP_ERROR("{}: Does not have valid JSON, removing file !", json_cards_path.string());
+        APP_ERROR("  Reason: {}", rapidjson::GetParseError_En(doc.GetParseError()));
+        APP_ERROR("  At: {}", doc.GetErrorOffset());
+        APP_ERROR("  -> Removing file !", json_cards_path.string());
+
+        isw.close();
+
+        std::filesystem::remove(json_cards_path);
+
+        return std::nullopt;
+    }
+
+    if (!doc.IsObject())
+    {
+        APP_ERROR("{}: Root is not an object, removing file !", json_cards_path.string());
+
+        isw.close();
+
+        std::filesystem::remove(json_cards_path);
+
+        return std::nullopt;
+    }
+
+    if (!doc.HasMember("cards") || !doc["cards"].IsArray())
+    {
+        APP_ERROR("{}: No cards members found, removing file !", json_cards_path.string());
+
+        isw.close();
+
+        std::filesystem::remove(json_cards_path);
+
+        return std::nullopt;
+    }
+
+    Set set;
+    set.lang_id = lang_id;
+    set.set_id = set_id;
+
+    if (doc.HasMember("name") && doc["name"].IsString())
+    {
+        set.name = doc["name"].GetString();
+    }
+
+    if (doc.HasMember("releaseDate") && doc["releaseDate"].IsString())
+    {
+        set.release_date = doc["releaseDate"].GetString();
+    }
+
+    if (doc.HasMember("serie") && doc["serie"].IsObject() && doc["serie"].HasMember("id") && doc["serie"]["id"].IsString())
+    {
+        set.serie_id = doc["serie"]["id"].GetString();
+    }
+
+    auto cards = doc["cards"].GetArray();
+
+    APP_TRACE("{}: Have {} cards", json_cards_path.string(), cards.Size());
+
+    set.cards.reserve(cards.Size());
+
+    size_t card_index = 0;
+    for (const auto& card: cards)
+    {
+        card_index++;
+
+        if (!card.IsObject() || !card.HasMember("localId") || !card["localId"].IsString())
+        {
+            APP_ERROR("{}: No localId card definition for card index {}", json_cards_path.string(), card_index);
+            continue;
+        }
+
+        std::string local_id = card["localId"].GetString();
+
+        if (!card.IsObject() || !card.HasMember("name") || !card["name"].IsString())
+        {
+            APP_ERROR("{}: No name card definition for card index {}", json_cards_path.string(), card_index);
+            continue;
+        }
+
+        std::string name = card["name"].GetString();
+
+        if (!card.IsObject() || !card.HasMember("image") || !card["image"].IsString())
+        {
+            APP_WARN("{}: No image card definition for card index {}", json_cards_path.string(), card_index);
+            continue;
+        }
+
+        std::string image = card["image"].GetString();
+
+        set.cards.push_back(Card {std::move(local_id), std::move(name), std::move(image)});
+    }
+
+    return set;
+}
+
+auto Catalog::imageUri(const Card& card, const Variant& variant) -> std::string
+{
+    return fmt::format("{0}/{1}.{2}", card.image, variant.quality, variant.format);
+}
+
+auto Catalog::imagePath(const Set& set, const Card& card, const Variant& variant) -> std::string
+{
+    return fmt::format("data/{0}/{1}/{2}_{3}_{4}.{5}", set.lang_id, set.set_id, card.local_id, variant.quality, sanitizeForPath(card.name), variant.format);
+}
+
+auto Catalog::sanitizeForPath(std::string filename) -> std::string
+{
+    static const std::unordered_map<unsigned char, char> replacements = {
+        {'<', '('},  {'>', ')'},  {':', '-'},
+        {'"', '\''}, {'/', '-'},  {'\\', '-'},
+        {'|', '-'},  {'?', ' '},  {'*', '+'}
+    };
+
+    // Traiter octet par octet, mais préserver les séquences UTF-8
+    for (size_t i = 0; i < filename.size(); ) {
+        // Ne remplacer que les caractères ASCII interdits
+        if (const unsigned char c = filename[i]; c < 128) {
+            if (auto it = replacements.find(c); it != replacements.end()) {
+                filename[i] = it->second;
+            } else if (c < 32) {
+                filename[i] = '_';
+            }
+
+            i++;
+        }
+        // Sauter les séquences UTF-8 multi-octets
+        else if (c >= 128) {
+            if ((c & 0xE0) == 0xC0) i += 2;
+            else if ((c & 0xF0) == 0xE0) i += 3;
+            else if ((c & 0xF8) == 0xF0) i += 4;
+            else i++; // Octet invalide
+        } else {
+            i++;
+        }
+    }
+
+    return filename;
+}
+
+auto Catalog::urlEncode(const std::string& value) -> std::string
+{
+    std::ostringstream escaped;
+    escaped.fill('0');
+    escaped << std::hex;
+
+    for (const char c : value) {
+        // Garde alphanumérique et quelques caractères spéciaux intacts
+        if (std::isalnum(static_cast<unsigned char>(c)) ||
+            c == '-' || c == '_' || c == '.' || c == '~') {
+            escaped << c;
+            } else {
+                // Encode les autres caractères
+                escaped << std::uppercase;
+                escaped << '%' << std::setw(2)
+                        << static_cast<int>(static_cast<unsigned char>(c));
+                escaped << std::nouppercase;
+            }
+    }
+
+    return escaped.str();
+}
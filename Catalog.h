@@ -0,0 +1,52 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Reads the TCGdex JSON files synchronized under data/. Invalid files are
+// removed so that the next run downloads them again.
+class Catalog {
+public:
+    Catalog() = delete;
+
+    struct Card {
+        std::string local_id;
+        std::string name;
+        std::string image;
+    };
+
+    // One of the images TCGdex serves for a card: {image}/<quality>.<format>
+    struct Variant {
+        std::string quality = "high";
+        std::string format = "jpg";
+    };
+
+    struct Set {
+        std::string lang_id;
+        std::string set_id;
+        std::string name;
+        std::string serie_id;
+        std::string release_date;
+        std::vector<Card> cards;
+    };
+
+    // data/<lang>/sets.json
+    [[nodiscard]] static auto readSetIds(const std::filesystem::path& json_sets_path) -> std::optional<std::vector<std::string>>;
+    // data/<lang>/<set>/cards.json
+    [[nodiscard]] static auto readSet(const std::filesystem::path& json_cards_path, const std::string& lang_id, const std::string& set_id) -> std::optional<Set>;
+
+    [[nodiscard]] static auto imageUri(const Card& card, const Variant& variant) -> std::string;
+    [[nodiscard]] static auto imagePath(const Set& set, const Card& card, const Variant& variant) -> std::string;
+
+    [[nodiscard]] static auto sanitizeForPath(std::string filename) -> std::string;
+    [[nodiscard]] static auto urlEncode(const std::string& value) -> std::string;
+};
+
+#endif //CATALOG_H
@@ -0,0 +1,259 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "ChangeFeed.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <unordered_set>
+#include <fmt/format.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "Logs.h"
+
+namespace {
+    auto unixTime() -> int64_t
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+ChangeFeed::ChangeFeed(const Shard& shard)
+    : m_path(shard.changesPath()), m_shard(shard.isSharded() ? shard.name() : ""), m_started_at(unixTime())
+{
+}
+
+auto ChangeFeed::actionName(const Action action) -> const char*
+{
+    switch (action)
+    {
+        case Action::Added: return "added";
+        case Action::Modified: return "modified";
+        case Action::Removed: return "removed";
+    }
+    return "";
+}
+
+auto ChangeFeed::kindName(const Kind kind) -> const char*
+{
+    switch (kind)
+    {
+        case Kind::Sets: return "sets";
+        case Kind::Cards: return "cards";
+        case Kind::Image: return "image";
+        case Kind::Catalog: return "catalog";
+    }
+    return "";
+}
+
+auto ChangeFeed::record(const Action action, const Kind kind, std::string uri, std::string path, std::string digest, const uint64_t size) -> void
+{
+    record(DatabaseManager::Change {actionName(action), kindName(kind), std::move(uri), std::move(path), std::move(digest), size});
+}
+
+auto ChangeFeed::record(DatabaseManager::Change change) -> void
+{
+    const std::lock_guard lock(m_mutex);
+
+    m_changes.push_back(std::move(change));
+}
+
+auto ChangeFeed::recordDownload(const DatabaseManager& database_manager, const Kind kind, const DownloadManager::DownloadResult& result, const DatabaseManager::UriMetadata* uri_metadata) -> void
+{
+    if (!result.success || !result.has_changed)
+    {
+        return;
+    }
+
+    std::optional<DatabaseManager::UriMetadata> found;
+    if (!uri_metadata)
+    {
+        found = database_manager.getUriMetadata(result.url());
+        uri_metadata = found.has_value() ? &*found : nullptr;
+    }
+
+    // A packed body has no file of its own, the feed points at its pack
+    std::string path = result.parameter->destination_file_path;
+    if (!result.parameter->pack_group.empty())
+    {
+        if (const auto pack_entry = database_manager.getPackEntry(result.url()); pack_entry.has_value())
+        {
+            path = pack_entry->pack;
+        }
+    }
+
+    record(result.created ? Action::Added : Action::Modified, kind, result.parameter->uri, std::move(path),
+        uri_metadata ? uri_metadata->digest : "", uri_metadata ? uri_metadata->size : 0);
+}
+
+auto ChangeFeed::begin() -> void
+{
+    const std::lock_guard lock(m_mutex);
+
+    m_changes.clear();
+    m_started_at = unixTime();
+}
+
+auto ChangeFeed::commit(const DatabaseManager& database_manager) -> bool
+{
+    std::vector<DatabaseManager::Change> changes;
+    DatabaseManager::SyncRun sync_run;
+    {
+        const std::lock_guard lock(m_mutex);
+        changes.swap(m_changes);
+
+        sync_run.started_at = m_started_at;
+        sync_run.finished_at = unixTime();
+        m_started_at = sync_run.finished_at;
+    }
+
+    sync_run.shard = m_shard;
+
+    // A change reported twice in a run (by two shards, or by the catalog then
+    // by the garbage collector, which knows the URI) is only kept once
+    const auto key = [](const DatabaseManager::Change& change)
+    {
+        return fmt::format("{} {} {}", change.action, change.kind, change.path);
+    };
+
+    std::unordered_set<std::string> with_uri;
+    for (const auto& change : changes)
+    {
+        if (!change.uri.empty())
+        {
+            with_uri.insert(key(change));
+        }
+    }
+
+    std::vector<DatabaseManager::Change> unique_changes;
+    std::unordered_set<std::string> seen;
+    unique_changes.reserve(changes.size());
+
+    for (auto& change : changes)
+    {
+        if (change.uri.empty() ? with_uri.contains(key(change)) : !seen.insert(fmt::format("{} {}", key(change), change.uri)).second)
+        {
+            continue;
+        }
+
+        unique_changes.push_back(std::move(change));
+    }
+
+    changes = std::move(unique_changes);
+
+    for (const auto& change : changes)
+    {
+        if (change.action == actionName(Action::Added)) sync_run.added++;
+        else if (change.action == actionName(Action::Modified)) sync_run.modified++;
+        else sync_run.removed++;
+    }
+
+    const auto id = database_manager.insertSyncRun(sync_run, changes);
+    if (!id.has_value())
+    {
+        APP_ERROR("Unable to record the sync run");
+        return false;
+    }
+
+    sync_run.id = *id;
+
+    if (!append(sync_run, changes))
+    {
+        return false;
+    }
+
+    APP_INFO("Sync run {}: {} added, {} modified, {} removed", sync_run.id, sync_run.added, sync_run.modified, sync_run.removed);
+
+    return true;
+}
+
+auto ChangeFeed::append(const DatabaseManager::SyncRun& sync_run, const std::vector<DatabaseManager::Change>& changes) const -> bool
+{
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+    const auto string = [&writer](const std::string& value)
+    {
+        writer.String(value.c_str(), static_cast<rapidjson::SizeType>(value.size()));
+    };
+
+    // A Writer holds one root value, it is reset for every line
+    for (const auto& change : changes)
+    {
+        writer.StartObject();
+        writer.Key("run"); writer.Int64(sync_run.id);
+        writer.Key("action"); string(change.action);
+        writer.Key("kind"); string(change.kind);
+        writer.Key("uri"); string(change.uri);
+        writer.Key("path"); string(change.path);
+        writer.Key("digest"); string(change.digest);
+        writer.Key("size"); writer.Uint64(change.size);
+        writer.EndObject();
+        buffer.Put('\n');
+        writer.Reset(buffer);
+    }
+
+    // Consumers only take the changes of a run once its closing line is there
+    writer.StartObject();
+    writer.Key("run"); writer.Int64(sync_run.id);
+    writer.Key("started"); writer.Int64(sync_run.started_at);
+    writer.Key("finished"); writer.Int64(sync_run.finished_at);
+    writer.Key("shard"); string(sync_run.shard);
+    writer.Key("added"); writer.Uint64(sync_run.added);
+    writer.Key("modified"); writer.Uint64(sync_run.modified);
+    writer.Key("removed"); writer.Uint64(sync_run.removed);
+    writer.EndObject();
+    buffer.Put('\n');
+
+    if (const auto parent = std::filesystem::path(m_path).parent_path(); !parent.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(parent, ec);
+    }
+
+    const int fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        APP_ERROR("Unable to open {}: {}", m_path, std::strerror(errno));
+        return false;
+    }
+
+    const char* data = buffer.GetString();
+    size_t remaining = buffer.GetSize();
+    while (remaining > 0)
+    {
+        const ssize_t written = ::write(fd, data, remaining);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            APP_ERROR("Unable to append to {}: {}", m_path, std::strerror(errno));
+            ::close(fd);
+            return false;
+        }
+
+        data += written;
+        remaining -= static_cast<size_t>(written);
+    }
+
+    const int error = ::fsync(fd) == 0 ? 0 : errno;
+    ::close(fd);
+
+    if (error != 0)
+    {
+        APP_ERROR("Unable to sync {}: {}", m_path, std::strerror(error));
+        return false;
+    }
+
+    return true;
+}
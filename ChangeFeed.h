@@ -0,0 +1,66 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef CHANGE_FEED_H
+#define CHANGE_FEED_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "DatabaseManager.h"
+#include "DownloadManager.h"
+#include "Shard.h"
+
+// Files a sync run added, modified or removed. A run is kept in memory until
+// commit(), which records it in the sync_runs and changes tables and appends it
+// to the NDJSON feed: one line per change, then one line closing the run.
+class ChangeFeed {
+public:
+    enum class Action {
+        Added,
+        Modified,
+        Removed
+    };
+
+    enum class Kind {
+        Sets,
+        Cards,
+        Image,
+        Catalog
+    };
+
+private:
+    std::string m_path;
+    std::string m_shard;
+    int64_t m_started_at;
+
+    mutable std::mutex m_mutex;
+    std::vector<DatabaseManager::Change> m_changes;
+
+public:
+    // Written to the changes file of the shard
+    explicit ChangeFeed(const Shard& shard);
+
+    [[nodiscard]] static auto actionName(Action action) -> const char*;
+    [[nodiscard]] static auto kindName(Kind kind) -> const char*;
+
+    auto record(Action action, Kind kind, std::string uri, std::string path, std::string digest, uint64_t size) -> void;
+    // Change already recorded by another run, a merged shard
+    auto record(DatabaseManager::Change change) -> void;
+    // A download that changed its destination, with the digest uri_metadata has for it
+    auto recordDownload(const DatabaseManager& database_manager, Kind kind, const DownloadManager::DownloadResult& result, const DatabaseManager::UriMetadata* uri_metadata = nullptr) -> void;
+
+    // Changes recorded from now on belong to a run started now
+    auto begin() -> void;
+
+    // Records the run in the database, appends it to the feed, and starts the next run
+    auto commit(const DatabaseManager& database_manager) -> bool;
+
+private:
+    [[nodiscard]] auto append(const DatabaseManager::SyncRun& sync_run, const std::vector<DatabaseManager::Change>& changes) const -> bool;
+};
+
+#endif //CHANGE_FEED_H
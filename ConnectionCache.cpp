@@ -0,0 +1,399 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "ConnectionCache.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <fmt/format.h>
+
+#include "Logs.h"
+
+namespace {
+    // Resolved addresses older than this are not worth trying first
+    constexpr auto address_max_age = std::chrono::hours(1);
+
+    auto now() -> int64_t
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+}
+
+ConnectionCache::ConnectionCache()
+{
+    m_share = curl_share_init();
+    if (!m_share)
+    {
+        CURL_ERROR("curl_share_init");
+        return;
+    }
+
+    curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, lock);
+    curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, unlock);
+    curl_share_setopt(m_share, CURLSHOPT_USERDATA, this);
+
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x075800
+    curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_HSTS);
+#endif
+}
+
+ConnectionCache::~ConnectionCache()
+{
+    save();
+
+    if (auto* resolve = m_resolve.exchange(nullptr))
+    {
+        curl_slist_free_all(resolve);
+    }
+
+    if (m_share)
+    {
+        curl_share_cleanup(m_share);
+    }
+}
+
+auto ConnectionCache::load(const std::filesystem::path& directory) -> void
+{
+    m_directory = directory;
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    if (ec)
+    {
+        APP_ERROR("Unable to create {}: {}", m_directory.string(), ec.message());
+        m_directory.clear();
+        return;
+    }
+
+    m_altsvc_path = (m_directory / "altsvc.txt").string();
+    m_hsts_path = (m_directory / "hsts.txt").string();
+
+    loadAddresses();
+    loadTlsSessions();
+}
+
+auto ConnectionCache::save() -> void
+{
+    if (m_directory.empty())
+    {
+        return;
+    }
+
+    // Alt-Svc and HSTS are written by libcurl when the handles are cleaned up
+    saveAddresses();
+    saveTlsSessions();
+}
+
+auto ConnectionCache::httpVersion() -> long
+{
+#ifdef CURL_VERSION_HTTP3
+    static const bool http3 = (curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP3) != 0;
+    if (http3)
+    {
+        return CURL_HTTP_VERSION_3;
+    }
+#endif
+    return CURL_HTTP_VERSION_2_0;
+}
+
+auto ConnectionCache::takeResolveList() -> curl_slist*
+{
+    return m_resolve.exchange(nullptr);
+}
+
+auto ConnectionCache::configure(CURL* easy_handle, curl_slist* resolve, const bool writer, const bool created) const -> void
+{
+    if (m_share)
+    {
+        curl_easy_setopt(easy_handle, CURLOPT_SHARE, m_share);
+    }
+
+    if (resolve)
+    {
+        curl_easy_setopt(easy_handle, CURLOPT_RESOLVE, resolve);
+    }
+
+    curl_easy_setopt(easy_handle, CURLOPT_HSTS_CTRL, static_cast<long>(CURLHSTS_ENABLE));
+
+    if (m_directory.empty())
+    {
+        return;
+    }
+
+    if (writer)
+    {
+        curl_easy_setopt(easy_handle, CURLOPT_HSTS, m_hsts_path.c_str());
+    }
+
+    // The entries survive curl_easy_reset: setting the file again would read and parse it for every transfer
+    if (created)
+    {
+        curl_easy_setopt(easy_handle, CURLOPT_ALTSVC_CTRL, altSvcControl() | CURLALTSVC_READONLYFILE);
+        curl_easy_setopt(easy_handle, CURLOPT_ALTSVC, m_altsvc_path.c_str());
+    }
+}
+
+auto ConnectionCache::saveAltSvc(CURL* easy_handle) const -> void
+{
+    if (m_directory.empty())
+    {
+        return;
+    }
+
+    // Setting the file merges its entries first, so the handles saved in turn add up
+    curl_easy_setopt(easy_handle, CURLOPT_ALTSVC_CTRL, altSvcControl());
+    curl_easy_setopt(easy_handle, CURLOPT_ALTSVC, m_altsvc_path.c_str());
+}
+
+auto ConnectionCache::acquireWriter() -> bool
+{
+    return !m_writer_taken.exchange(true);
+}
+
+auto ConnectionCache::releaseWriter() -> void
+{
+    m_writer_taken = false;
+}
+
+auto ConnectionCache::record(CURL* easy_handle) -> void
+{
+    // A reused connection has nothing new to remember
+    long new_connections = 0;
+    if (curl_easy_getinfo(easy_handle, CURLINFO_NUM_CONNECTS, &new_connections) != CURLE_OK || new_connections == 0)
+    {
+        return;
+    }
+
+    char* url = nullptr;
+    char* address = nullptr;
+    if (curl_easy_getinfo(easy_handle, CURLINFO_EFFECTIVE_URL, &url) != CURLE_OK || !url ||
+        curl_easy_getinfo(easy_handle, CURLINFO_PRIMARY_IP, &address) != CURLE_OK || !address || !*address)
+    {
+        return;
+    }
+
+    CURLU* parsed = curl_url();
+    if (!parsed)
+    {
+        return;
+    }
+
+    char* host = nullptr;
+    char* port = nullptr;
+    if (curl_url_set(parsed, CURLUPART_URL, url, 0) == CURLUE_OK &&
+        curl_url_get(parsed, CURLUPART_HOST, &host, 0) == CURLUE_OK &&
+        curl_url_get(parsed, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT) == CURLUE_OK)
+    {
+        std::lock_guard lock(m_addresses_mutex);
+        m_addresses.insert_or_assign(fmt::format("{}:{}", host, port), address);
+    }
+
+    curl_free(host);
+    curl_free(port);
+    curl_url_cleanup(parsed);
+}
+
+auto ConnectionCache::loadAddresses() -> void
+{
+    std::ifstream ifs(m_directory / "dns.txt");
+
+    curl_slist* resolve = nullptr;
+    size_t count = 0;
+
+    // <host>:<port> <address> <saved at>
+    std::string host_port;
+    std::string address;
+    int64_t saved_at = 0;
+    while (ifs >> host_port >> address >> saved_at)
+    {
+        if (now() - saved_at > std::chrono::duration_cast<std::chrono::seconds>(address_max_age).count())
+        {
+            continue;
+        }
+
+        // '+': a regular cache entry that times out, not a permanent override
+        const auto entry = address.find(':') != std::string::npos
+            ? fmt::format("+{}:[{}]", host_port, address)
+            : fmt::format("+{}:{}", host_port, address);
+        resolve = curl_slist_append(resolve, entry.c_str());
+        count++;
+    }
+
+    if (auto* previous = m_resolve.exchange(resolve))
+    {
+        curl_slist_free_all(previous);
+    }
+
+    APP_TRACE("{}: {} resolved addresses reloaded", (m_directory / "dns.txt").string(), count);
+}
+
+auto ConnectionCache::saveAddresses() -> void
+{
+    std::lock_guard lock(m_addresses_mutex);
+
+    if (m_addresses.empty())
+    {
+        return;
+    }
+
+    const auto path = m_directory / "dns.txt";
+    const auto temporary_path = std::filesystem::path(path).concat(".tmp");
+
+    {
+        std::ofstream ofs(temporary_path, std::ios::out | std::ios::trunc);
+        for (const auto saved_at = now(); const auto& [host_port, address] : m_addresses)
+        {
+            ofs << host_port << ' ' << address << ' ' << saved_at << '\n';
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporary_path, path, ec);
+    if (ec)
+    {
+        APP_ERROR("Unable to write {}: {}", path.string(), ec.message());
+    }
+}
+
+#if LIBCURL_VERSION_NUM >= 0x080c00
+namespace {
+    // tls-sessions.bin: records of <key length><key><shmac length><shmac><data length><data>
+    auto writeBlob(std::ofstream& ofs, const void* data, const uint32_t length) -> void
+    {
+        ofs.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        ofs.write(static_cast<const char*>(data), length);
+    }
+
+    auto readBlob(std::ifstream& ifs, std::vector<unsigned char>& data) -> bool
+    {
+        uint32_t length = 0;
+        if (!ifs.read(reinterpret_cast<char*>(&length), sizeof(length)) || length > 1024 * 1024)
+        {
+            return false;
+        }
+
+        data.resize(length);
+        return static_cast<bool>(ifs.read(reinterpret_cast<char*>(data.data()), length));
+    }
+
+    auto exportSession(CURL*, void* user_data, const char* session_key,
+                       const unsigned char* shmac, const size_t shmac_len,
+                       const unsigned char* sdata, const size_t sdata_len,
+                       const curl_off_t valid_until, int, const char*, size_t) -> CURLcode
+    {
+        if (valid_until > 0 && valid_until < now())
+        {
+            return CURLE_OK;
+        }
+
+        auto& ofs = *static_cast<std::ofstream*>(user_data);
+        const std::string key = session_key ? session_key : "";
+        writeBlob(ofs, key.data(), static_cast<uint32_t>(key.size()));
+        writeBlob(ofs, shmac, static_cast<uint32_t>(shmac_len));
+        writeBlob(ofs, sdata, static_cast<uint32_t>(sdata_len));
+
+        return CURLE_OK;
+    }
+}
+#endif
+
+auto ConnectionCache::loadTlsSessions() -> void
+{
+#if LIBCURL_VERSION_NUM >= 0x080c00
+    std::ifstream ifs(m_directory / "tls-sessions.bin", std::ios::binary);
+    if (!ifs || !m_share)
+    {
+        return;
+    }
+
+    // Sessions are imported into the share through a handle attached to it
+    CURL* easy_handle = curl_easy_init();
+    if (!easy_handle)
+    {
+        return;
+    }
+    curl_easy_setopt(easy_handle, CURLOPT_SHARE, m_share);
+
+    size_t count = 0;
+    std::vector<unsigned char> key;
+    std::vector<unsigned char> shmac;
+    std::vector<unsigned char> sdata;
+    while (readBlob(ifs, key) && readBlob(ifs, shmac) && readBlob(ifs, sdata))
+    {
+        const std::string session_key(key.begin(), key.end());
+        if (curl_easy_ssls_import(easy_handle, session_key.empty() ? nullptr : session_key.c_str(),
+                                  shmac.data(), shmac.size(), sdata.data(), sdata.size()) == CURLE_OK)
+        {
+            count++;
+        }
+    }
+
+    curl_easy_cleanup(easy_handle);
+
+    APP_TRACE("{}: {} TLS sessions reloaded", (m_directory / "tls-sessions.bin").string(), count);
+#endif
+}
+
+auto ConnectionCache::saveTlsSessions() -> void
+{
+#if LIBCURL_VERSION_NUM >= 0x080c00
+    if (!m_share)
+    {
+        return;
+    }
+
+    CURL* easy_handle = curl_easy_init();
+    if (!easy_handle)
+    {
+        return;
+    }
+    curl_easy_setopt(easy_handle, CURLOPT_SHARE, m_share);
+
+    const auto path = m_directory / "tls-sessions.bin";
+    const auto temporary_path = std::filesystem::path(path).concat(".tmp");
+
+    CURLcode exported;
+    {
+        std::ofstream ofs(temporary_path, std::ios::out | std::ios::trunc | std::ios::binary);
+        exported = curl_easy_ssls_export(easy_handle, exportSession, &ofs);
+    }
+
+    curl_easy_cleanup(easy_handle);
+
+    std::error_code ec;
+    if (exported != CURLE_OK)
+    {
+        std::filesystem::remove(temporary_path, ec);
+        return;
+    }
+
+    std::filesystem::rename(temporary_path, path, ec);
+#endif
+}
+
+auto ConnectionCache::altSvcControl() -> long
+{
+    long altsvc_ctrl = CURLALTSVC_H1 | CURLALTSVC_H2;
+#ifdef CURL_VERSION_HTTP3
+    if (httpVersion() == CURL_HTTP_VERSION_3)
+    {
+        altsvc_ctrl |= CURLALTSVC_H3;
+    }
+#endif
+    return altsvc_ctrl;
+}
+
+auto ConnectionCache::lock(CURL*, const curl_lock_data data, curl_lock_access, void* user_data) -> void
+{
+    static_cast<ConnectionCache*>(user_data)->m_share_locks[data].lock();
+}
+
+auto ConnectionCache::unlock(CURL*, const curl_lock_data data, void* user_data) -> void
+{
+    static_cast<ConnectionCache*>(user_data)->m_share_locks[data].unlock();
+}
@@ -0,0 +1,84 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef CONNECTION_CACHE_H
+#define CONNECTION_CACHE_H
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <curl/curl.h>
+
+// State that makes the first requests of a run as fast as the last ones of
+// the previous run. The share handle keeps DNS entries, TLS sessions and the
+// HSTS cache across the transfers of a process; with a cache directory,
+// the Alt-Svc and HSTS caches, the resolved addresses and (libcurl >= 8.12)
+// the TLS session tickets are also saved there and reloaded on startup.
+// libcurl keeps Alt-Svc entries per easy handle, outside the share: a pooled
+// handle reads the file once when it is created and writes back what it
+// learned when the pool is destroyed.
+class ConnectionCache {
+    CURLSH* m_share{nullptr};
+    std::array<std::mutex, CURL_LOCK_DATA_LAST> m_share_locks;
+
+    std::filesystem::path m_directory;
+    // Built once rather than per handle
+    std::string m_altsvc_path;
+    std::string m_hsts_path;
+
+    // Addresses resolved by a previous run, handed to the first download only
+    std::atomic<curl_slist*> m_resolve{nullptr};
+
+    std::mutex m_addresses_mutex;
+    // "<host>:<port>" -> address used by the last transfer
+    std::map<std::string, std::string> m_addresses;
+
+    // One handle per download writes the HSTS file on cleanup
+    std::atomic<bool> m_writer_taken{false};
+
+public:
+    ConnectionCache();
+    ~ConnectionCache();
+
+    ConnectionCache(const ConnectionCache&) = delete;
+    ConnectionCache& operator=(const ConnectionCache&) = delete;
+
+    // Reloads the caches saved in directory and saves them there from now on
+    auto load(const std::filesystem::path& directory) -> void;
+    auto save() -> void;
+
+    // HTTP/3 when this libcurl supports it (falling back to HTTP/2), HTTP/2 otherwise
+    [[nodiscard]] static auto httpVersion() -> long;
+
+    // Resolved addresses of the previous run, to set on the handles of one download
+    [[nodiscard]] auto takeResolveList() -> curl_slist*;
+
+    // writer: whether this handle writes the HSTS file back
+    // created: whether the handle is new, the only time it reads the Alt-Svc file
+    auto configure(CURL* easy_handle, curl_slist* resolve, bool writer, bool created) const -> void;
+    // Makes a handle about to be cleaned up write back the Alt-Svc entries it learned
+    auto saveAltSvc(CURL* easy_handle) const -> void;
+    // The first handle asking is the writer until releaseWriter
+    [[nodiscard]] auto acquireWriter() -> bool;
+    auto releaseWriter() -> void;
+
+    // Remembers the address a finished transfer connected to
+    auto record(CURL* easy_handle) -> void;
+
+private:
+    auto loadAddresses() -> void;
+    auto saveAddresses() -> void;
+    auto loadTlsSessions() -> void;
+    auto saveTlsSessions() -> void;
+
+    [[nodiscard]] static auto altSvcControl() -> long;
+
+    static auto lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* user_data) -> void;
+    static auto unlock(CURL* handle, curl_lock_data data, void* user_data) -> void;
+};
+
+#endif //CONNECTION_CACHE_H
@@ -0,0 +1,196 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "ControlSocket.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Logs.h"
+
+namespace {
+    // SOCK_CLOEXEC and accept4 are Linux only
+    auto setCloseOnExec(const int fd) -> bool
+    {
+        const int flags = ::fcntl(fd, F_GETFD);
+        return flags >= 0 && ::fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == 0;
+    }
+
+    // A client gone before the response must not kill the daemon with SIGPIPE
+#if defined(__linux__)
+    constexpr int send_flags = MSG_NOSIGNAL;
+#else
+    constexpr int send_flags = 0;
+#endif
+}
+
+ControlSocket::ControlSocket(std::filesystem::path path, Handler handler)
+    : m_path(std::move(path)), m_handler(std::move(handler))
+{
+}
+
+ControlSocket::~ControlSocket()
+{
+    stop();
+}
+
+auto ControlSocket::start() -> bool
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+
+    if (m_path.string().size() >= sizeof(address.sun_path))
+    {
+        APP_ERROR("Control socket path too long: {}", m_path.string());
+        return false;
+    }
+    std::strncpy(address.sun_path, m_path.c_str(), sizeof(address.sun_path) - 1);
+
+    // A daemon still running answers, a socket left by one that did not stop cleanly refuses
+    if (const int probe_fd = ::socket(AF_UNIX, SOCK_STREAM, 0); probe_fd >= 0)
+    {
+        const int rc = ::connect(probe_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+        const int error = rc == 0 ? 0 : errno;
+        ::close(probe_fd);
+
+        if (rc == 0)
+        {
+            APP_ERROR("A daemon is already listening on {}", m_path.string());
+            return false;
+        }
+
+        if (error == ECONNREFUSED)
+        {
+            std::error_code ec;
+            std::filesystem::remove(m_path, ec);
+        }
+        else if (error != ENOENT)
+        {
+            APP_ERROR("Unable to check {}: {}", m_path.string(), std::strerror(error));
+            return false;
+        }
+    }
+
+    m_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_fd < 0 || !setCloseOnExec(m_fd))
+    {
+        APP_ERROR("Unable to create control socket: {}", std::strerror(errno));
+        if (m_fd >= 0)
+        {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        return false;
+    }
+
+    if (::bind(m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(m_fd, 8) != 0)
+    {
+        APP_ERROR("Unable to listen on {}: {}", m_path.string(), std::strerror(errno));
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_stopping = false;
+    m_thread = std::thread(&ControlSocket::run, this);
+
+    APP_INFO("Control socket listening on {}", m_path.string());
+
+    return true;
+}
+
+auto ControlSocket::stop() -> void
+{
+    m_stopping = true;
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    if (m_fd >= 0)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+
+        std::error_code ec;
+        std::filesystem::remove(m_path, ec);
+    }
+}
+
+auto ControlSocket::run() -> void
+{
+    while (!m_stopping)
+    {
+        // Wakes up regularly to notice stop()
+        pollfd listening{m_fd, POLLIN, 0};
+        if (::poll(&listening, 1, 200) <= 0)
+        {
+            continue;
+        }
+
+        const int client_fd = ::accept(m_fd, nullptr, nullptr);
+        if (client_fd < 0)
+        {
+            continue;
+        }
+
+        setCloseOnExec(client_fd);
+#if defined(__APPLE__)
+        constexpr int no_sigpipe = 1;
+        ::setsockopt(client_fd, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+
+        serve(client_fd);
+
+        ::close(client_fd);
+    }
+}
+
+auto ControlSocket::serve(const int client_fd) const -> void
+{
+    std::string command;
+    char buffer[256];
+
+    // One line, or whatever arrived within a second
+    while (command.find('\n') == std::string::npos && command.size() < 4096)
+    {
+        pollfd client{client_fd, POLLIN, 0};
+        if (::poll(&client, 1, 1000) <= 0)
+        {
+            break;
+        }
+
+        const auto count = ::read(client_fd, buffer, sizeof(buffer));
+        if (count <= 0)
+        {
+            break;
+        }
+
+        command.append(buffer, static_cast<size_t>(count));
+    }
+
+    if (const auto end = command.find_first_of("\r\n"); end != std::string::npos)
+    {
+        command.erase(end);
+    }
+
+    auto response = m_handler(command);
+    response.push_back('\n');
+
+    for (size_t written = 0; written < response.size(); )
+    {
+        const auto count = ::send(client_fd, response.data() + written, response.size() - written, send_flags);
+        if (count <= 0)
+        {
+            break;
+        }
+        written += static_cast<size_t>(count);
+    }
+}
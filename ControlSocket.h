@@ -0,0 +1,43 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef CONTROL_SOCKET_H
+#define CONTROL_SOCKET_H
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Local Unix socket of the daemon: a client writes one command line and
+// reads the handler's answer, then the connection is closed.
+class ControlSocket {
+public:
+    using Handler = std::function<std::string(std::string_view command)>;
+
+private:
+    std::filesystem::path m_path;
+    Handler m_handler;
+    int m_fd{-1};
+    std::atomic<bool> m_stopping{false};
+    std::thread m_thread;
+
+public:
+    ControlSocket(std::filesystem::path path, Handler handler);
+    ~ControlSocket();
+
+    ControlSocket(const ControlSocket&) = delete;
+    ControlSocket& operator=(const ControlSocket&) = delete;
+
+    [[nodiscard]] auto start() -> bool;
+    auto stop() -> void;
+
+private:
+    auto run() -> void;
+    auto serve(int client_fd) const -> void;
+};
+
+#endif //CONTROL_SOCKET_H
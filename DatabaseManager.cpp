@@ -2,11 +2,95 @@
 // Created by Zéro Cool on 01/11/2025.
 //
 
+#include <chrono>
 #include <iostream>
+#include <ranges>
+#include <string_view>
 
 #include "DatabaseManager.h"
 #include "Logs.h"
 
+namespace {
+    // Writers retry for about 30 s: 1, 2, 4 ... 64 ms, then every 100 ms
+    constexpr int max_busy_retries = 300;
+
+    // Cached statements are reset when leaving the scope, so no read
+    // transaction stays open on the connection between two calls
+    class StatementScope {
+        sqlite3_stmt* m_stmt;
+
+    public:
+        explicit StatementScope(sqlite3_stmt* stmt) : m_stmt(stmt) {}
+        ~StatementScope()
+        {
+            sqlite3_reset(m_stmt);
+            sqlite3_clear_bindings(m_stmt);
+        }
+
+        StatementScope(const StatementScope&) = delete;
+        auto operator=(const StatementScope&) -> StatementScope& = delete;
+    };
+
+    constexpr auto select_uri_metadata_sql = R"(SELECT uri, etag, last_updated, digest, size, file_path, parent_uri, parent_etag, validated_at FROM uri_metadata WHERE uri = ?)";
+
+    constexpr auto upsert_uri_metadata_sql = R"(
+        INSERT INTO uri_metadata (uri, etag, last_updated, digest, size, file_path, parent_uri, parent_etag, validated_at)
+        VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)
+        ON CONFLICT(uri) DO UPDATE SET
+            etag=excluded.etag,
+            last_updated=excluded.last_updated,
+            digest=excluded.digest,
+            size=excluded.size,
+            file_path=excluded.file_path,
+            parent_uri=excluded.parent_uri,
+            parent_etag=excluded.parent_etag,
+            validated_at=excluded.validated_at
+    )";
+
+    constexpr auto select_validators_sql = R"(SELECT etag, last_updated FROM uri_metadata WHERE uri = ?)";
+
+    constexpr auto select_uri_metadata_by_parent_sql = R"(SELECT uri, etag, last_updated, digest, size, file_path, parent_uri, parent_etag, validated_at FROM uri_metadata WHERE parent_uri = ?)";
+
+    constexpr auto delete_uri_metadata_sql = R"(DELETE FROM uri_metadata WHERE uri = ?)";
+
+    constexpr auto delete_blob_sql = R"(DELETE FROM blobs WHERE uri = ?)";
+
+    constexpr auto delete_pack_entry_sql = R"(DELETE FROM pack_entries WHERE uri = ?)";
+
+    constexpr auto is_blob_shared_sql = R"(SELECT 1 FROM blobs WHERE digest = ? AND uri <> ? LIMIT 1)";
+
+    constexpr auto mark_validated_sql = R"(UPDATE uri_metadata SET parent_uri = ?, parent_etag = ?, validated_at = ? WHERE uri = ?)";
+
+    constexpr auto select_blob_sql = R"(SELECT uri, digest, size FROM blobs WHERE uri = ?)";
+
+    constexpr auto upsert_blob_sql = R"(
+        INSERT INTO blobs (uri, digest, size)
+        VALUES (?, ?, ?)
+        ON CONFLICT(uri) DO UPDATE SET
+            digest=excluded.digest,
+            size=excluded.size
+    )";
+
+    constexpr auto select_pack_entry_sql = R"(SELECT uri, pack_group, pack, offset, length, etag FROM pack_entries WHERE uri = ?)";
+
+    constexpr auto has_pack_entry_sql = R"(SELECT 1 FROM pack_entries WHERE uri = ?)";
+
+    constexpr auto upsert_pack_entry_sql = R"(
+        INSERT INTO pack_entries (uri, pack_group, pack, offset, length, etag)
+        VALUES (?, ?, ?, ?, ?, ?)
+        ON CONFLICT(uri) DO UPDATE SET
+            pack_group=excluded.pack_group,
+            pack=excluded.pack,
+            offset=excluded.offset,
+            length=excluded.length,
+            etag=excluded.etag
+    )";
+
+    constexpr auto insert_sync_run_sql = R"(INSERT INTO sync_runs (started_at, finished_at, shard, added, modified, removed) VALUES (?, ?, ?, ?, ?, ?))";
+
+    constexpr auto insert_change_sql = R"(INSERT INTO changes (run_id, action, kind, uri, path, digest, size) VALUES (?, ?, ?, ?, ?, ?, ?))";
+}
+
 DatabaseManager::DatabaseManager() = default;
 
 DatabaseManager::~DatabaseManager()
@@ -14,42 +98,63 @@ DatabaseManager::~DatabaseManager()
     close();
 }
 
-auto DatabaseManager::open(const std::string& path) -> bool
+DatabaseManager::Connection::~Connection()
 {
-    if (const int rc = sqlite3_open(path.c_str(), &m_db); rc != SQLITE_OK)
+    for (const auto stmt : statements | std::views::values)
     {
-        DB_ERROR("Open database error: {}", sqlite3_errmsg(m_db));
+        sqlite3_finalize(stmt);
+    }
 
-        return false;
+    if (db) sqlite3_close(db);
+}
+
+auto DatabaseManager::Connection::statement(const char* sql) -> sqlite3_stmt*
+{
+    if (const auto it = statements.find(sql); it != statements.end())
+    {
+        return it->second;
     }
 
-    if (!createModel())
+    sqlite3_stmt* stmt = nullptr;
+    if (const int rc = sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr); rc != SQLITE_OK)
     {
-        return false;
+        DB_ERROR("Prepare error: {}", sqlite3_errmsg(db));
+        return nullptr;
     }
 
-    prepareStatements();
+    statements.emplace(sql, stmt);
 
-    return true;
+    return stmt;
 }
 
-auto DatabaseManager::close() -> void
+auto DatabaseManager::open(const std::string& path) -> bool
 {
-    if (m_selectUriMetadataStmt) sqlite3_finalize(m_selectUriMetadataStmt);
-    if (m_upsertUriMetadataStmt) sqlite3_finalize(m_upsertUriMetadataStmt);
+    close();
+
+    m_path = path;
+    m_commits = 0;
+    m_pending_rows = 0;
+
+    // The model is created on the connection of the opening thread
+    if (!connection())
+    {
+        return false;
+    }
 
-    if (m_db) sqlite3_close(m_db);
+    return createModel();
+}
 
-    m_db = nullptr;
+auto DatabaseManager::close() -> void
+{
+    const std::lock_guard lock(m_connections_mutex);
 
-    m_selectUriMetadataStmt = nullptr;
-    m_upsertUriMetadataStmt = nullptr;
+    m_connections.clear();
 }
 
 auto DatabaseManager::beginTransaction() const -> bool
 {
     char* errMsg = nullptr;
-    if (const int rc = sqlite3_exec(m_db, "BEGIN TRANSACTION", nullptr, nullptr, &errMsg); rc != SQLITE_OK)
+    if (const int rc = sqlite3_exec(handle(), "BEGIN IMMEDIATE", nullptr, nullptr, &errMsg); rc != SQLITE_OK)
     {
         DB_ERROR("BEGIN Error: {}", errMsg);
 
@@ -62,30 +167,62 @@ auto DatabaseManager::beginTransaction() const -> bool
 auto DatabaseManager::commit() const -> bool
 {
     char* errMsg = nullptr;
-    if (const int rc = sqlite3_exec(m_db, "COMMIT", nullptr, nullptr, &errMsg); rc != SQLITE_OK)
+    if (const int rc = sqlite3_exec(handle(), "COMMIT", nullptr, nullptr, &errMsg); rc != SQLITE_OK)
     {
         DB_ERROR("COMMIT Error: {}", errMsg);
 
         sqlite3_free(errMsg);
         return false;
     }
+
+    m_commits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+auto DatabaseManager::rollback() const -> bool
+{
+    char* errMsg = nullptr;
+    if (const int rc = sqlite3_exec(handle(), "ROLLBACK", nullptr, nullptr, &errMsg); rc != SQLITE_OK)
+    {
+        DB_ERROR("ROLLBACK Error: {}", errMsg);
+
+        sqlite3_free(errMsg);
+        return false;
+    }
     return true;
 }
 
 auto DatabaseManager::getUriMetadata(const std::string& uri) const -> std::optional<UriMetadata>
 {
-    sqlite3_reset(m_selectUriMetadataStmt);
-    sqlite3_bind_text(m_selectUriMetadataStmt, 1, uri.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_stmt* stmt = statement(select_uri_metadata_sql);
+    if (!stmt)
+    {
+        return std::nullopt;
+    }
 
-    if (const int rc = sqlite3_step(m_selectUriMetadataStmt); rc == SQLITE_ROW) {
-        const unsigned char* c_uri = sqlite3_column_text(m_selectUriMetadataStmt, 0);
-        const unsigned char* c_etag = sqlite3_column_text(m_selectUriMetadataStmt, 1);
-        const unsigned char* c_last_update = sqlite3_column_text(m_selectUriMetadataStmt, 2);
+    const StatementScope scope(stmt);
+
+    sqlite3_bind_text(stmt, 1, uri.c_str(), -1, SQLITE_TRANSIENT);
+
+    if (const int rc = sqlite3_step(stmt); rc == SQLITE_ROW) {
+        const unsigned char* c_uri = sqlite3_column_text(stmt, 0);
+        const unsigned char* c_etag = sqlite3_column_text(stmt, 1);
+        const unsigned char* c_last_update = sqlite3_column_text(stmt, 2);
+        const unsigned char* c_digest = sqlite3_column_text(stmt, 3);
+        const unsigned char* c_file_path = sqlite3_column_text(stmt, 5);
+        const unsigned char* c_parent_uri = sqlite3_column_text(stmt, 6);
+        const unsigned char* c_parent_etag = sqlite3_column_text(stmt, 7);
 
         return UriMetadata {
             c_uri ? reinterpret_cast<const char*>(c_uri) : "",
             c_etag ? reinterpret_cast<const char*>(c_etag) : "",
-            c_last_update ? reinterpret_cast<const char*>(c_last_update) : ""
+            c_last_update ? reinterpret_cast<const char*>(c_last_update) : "",
+            c_digest ? reinterpret_cast<const char*>(c_digest) : "",
+            static_cast<uint64_t>(sqlite3_column_int64(stmt, 4)),
+            c_file_path ? reinterpret_cast<const char*>(c_file_path) : "",
+            c_parent_uri ? reinterpret_cast<const char*>(c_parent_uri) : "",
+            c_parent_etag ? reinterpret_cast<const char*>(c_parent_etag) : "",
+            sqlite3_column_int64(stmt, 8)
         };
     }
 
@@ -94,36 +231,664 @@ auto DatabaseManager::getUriMetadata(const std::string& uri) const -> std::optio
 
 auto DatabaseManager::upsertUriMetadata(const UriMetadata& uri_metadata) const -> bool
 {
-    sqlite3_reset(m_upsertUriMetadataStmt);
-    sqlite3_bind_text(m_upsertUriMetadataStmt, 1, uri_metadata.uri.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(m_upsertUriMetadataStmt, 2, uri_metadata.etag.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(m_upsertUriMetadataStmt, 3, uri_metadata.last_update.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_stmt* stmt = statement(upsert_uri_metadata_sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    const StatementScope scope(stmt);
+
+    sqlite3_bind_text(stmt, 1, uri_metadata.uri.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, uri_metadata.etag.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, uri_metadata.last_update.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 4, uri_metadata.digest.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 5, static_cast<sqlite3_int64>(uri_metadata.size));
+    sqlite3_bind_text(stmt, 6, uri_metadata.file_path.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 7, uri_metadata.parent_uri.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 8, uri_metadata.parent_etag.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 9, uri_metadata.validated_at);
+
+    const int rc = sqlite3_step(stmt);
+    return rc == SQLITE_DONE;
+}
+
+auto DatabaseManager::getValidators(const std::string& uri, std::string& etag, std::string& last_update) const -> bool
+{
+    etag.clear();
+    last_update.clear();
+
+    sqlite3_stmt* stmt = statement(select_validators_sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    const StatementScope scope(stmt);
+
+    sqlite3_bind_text(stmt, 1, uri.c_str(), -1, SQLITE_STATIC);
+
+    if (sqlite3_step(stmt) != SQLITE_ROW)
+    {
+        return false;
+    }
+
+    if (const unsigned char* c_etag = sqlite3_column_text(stmt, 0))
+    {
+        etag.assign(reinterpret_cast<const char*>(c_etag));
+    }
+    if (const unsigned char* c_last_update = sqlite3_column_text(stmt, 1))
+    {
+        last_update.assign(reinterpret_cast<const char*>(c_last_update));
+    }
+
+    return true;
+}
+
+auto DatabaseManager::markValidated(const std::string& uri, const std::string& parent_uri, const std::string& parent_etag, const int64_t validated_at) const -> bool
+{
+    sqlite3_stmt* stmt = statement(mark_validated_sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    const StatementScope scope(stmt);
+
+    sqlite3_bind_text(stmt, 1, parent_uri.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, parent_etag.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 3, validated_at);
+    sqlite3_bind_text(stmt, 4, uri.c_str(), -1, SQLITE_TRANSIENT);
+
+    const int rc = sqlite3_step(stmt);
+    return rc == SQLITE_DONE;
+}
+
+auto DatabaseManager::listHashedUriMetadata() const -> std::vector<UriMetadata>
+{
+    std::vector<UriMetadata> uri_metadata;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (const int rc = sqlite3_prepare_v2(handle(),
+        R"(SELECT uri, etag, last_updated, digest, size, file_path, parent_uri, parent_etag, validated_at FROM uri_metadata WHERE digest <> '' AND file_path <> '')",
+        -1, &stmt, nullptr); rc != SQLITE_OK)
+    {
+        DB_ERROR("Prepare error for listHashedUriMetadata: {}", sqlite3_errmsg(handle()));
+        return uri_metadata;
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const unsigned char* c_uri = sqlite3_column_text(stmt, 0);
+        const unsigned char* c_etag = sqlite3_column_text(stmt, 1);
+        const unsigned char* c_last_update = sqlite3_column_text(stmt, 2);
+        const unsigned char* c_digest = sqlite3_column_text(stmt, 3);
+        const unsigned char* c_file_path = sqlite3_column_text(stmt, 5);
+        const unsigned char* c_parent_uri = sqlite3_column_text(stmt, 6);
+        const unsigned char* c_parent_etag = sqlite3_column_text(stmt, 7);
+
+        uri_metadata.push_back(UriMetadata {
+            c_uri ? reinterpret_cast<const char*>(c_uri) : "",
+            c_etag ? reinterpret_cast<const char*>(c_etag) : "",
+            c_last_update ? reinterpret_cast<const char*>(c_last_update) : "",
+            c_digest ? reinterpret_cast<const char*>(c_digest) : "",
+            static_cast<uint64_t>(sqlite3_column_int64(stmt, 4)),
+            c_file_path ? reinterpret_cast<const char*>(c_file_path) : "",
+            c_parent_uri ? reinterpret_cast<const char*>(c_parent_uri) : "",
+            c_parent_etag ? reinterpret_cast<const char*>(c_parent_etag) : "",
+            sqlite3_column_int64(stmt, 8)
+        });
+    }
+
+    sqlite3_finalize(stmt);
+
+    return uri_metadata;
+}
+
+auto DatabaseManager::listUriMetadataByParent(const std::string& parent_uri) const -> std::vector<UriMetadata>
+{
+    std::vector<UriMetadata> uri_metadata;
+
+    sqlite3_stmt* stmt = statement(select_uri_metadata_by_parent_sql);
+    if (!stmt)
+    {
+        return uri_metadata;
+    }
+
+    const StatementScope scope(stmt);
+
+    sqlite3_bind_text(stmt, 1, parent_uri.c_str(), -1, SQLITE_STATIC);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const unsigned char* c_uri = sqlite3_column_text(stmt, 0);
+        const unsigned char* c_etag = sqlite3_column_text(stmt, 1);
+        const unsigned char* c_last_update = sqlite3_column_text(stmt, 2);
+        const unsigned char* c_digest = sqlite3_column_text(stmt, 3);
+        const unsigned char* c_file_path = sqlite3_column_text(stmt, 5);
+        const unsigned char* c_parent_uri = sqlite3_column_text(stmt, 6);
+        const unsigned char* c_parent_etag = sqlite3_column_text(stmt, 7);
+
+        uri_metadata.push_back(UriMetadata {
+            c_uri ? reinterpret_cast<const char*>(c_uri) : "",
+            c_etag ? reinterpret_cast<const char*>(c_etag) : "",
+            c_last_update ? reinterpret_cast<const char*>(c_last_update) : "",
+            c_digest ? reinterpret_cast<const char*>(c_digest) : "",
+            static_cast<uint64_t>(sqlite3_column_int64(stmt, 4)),
+            c_file_path ? reinterpret_cast<const char*>(c_file_path) : "",
+            c_parent_uri ? reinterpret_cast<const char*>(c_parent_uri) : "",
+            c_parent_etag ? reinterpret_cast<const char*>(c_parent_etag) : "",
+            sqlite3_column_int64(stmt, 8)
+        });
+    }
+
+    return uri_metadata;
+}
+
+auto DatabaseManager::deleteUriMetadata(const std::string& uri) const -> bool
+{
+    for (const auto sql : {delete_uri_metadata_sql, delete_blob_sql, delete_pack_entry_sql})
+    {
+        sqlite3_stmt* stmt = statement(sql);
+        if (!stmt)
+        {
+            return false;
+        }
+
+        const StatementScope scope(stmt);
+
+        sqlite3_bind_text(stmt, 1, uri.c_str(), -1, SQLITE_STATIC);
+
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            DB_ERROR("DELETE {} error: {}", uri, sqlite3_errmsg(handle()));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+auto DatabaseManager::getBlob(const std::string& uri) const -> std::optional<Blob>
+{
+    sqlite3_stmt* stmt = statement(select_blob_sql);
+    if (!stmt)
+    {
+        return std::nullopt;
+    }
+
+    const StatementScope scope(stmt);
+
+    sqlite3_bind_text(stmt, 1, uri.c_str(), -1, SQLITE_TRANSIENT);
+
+    if (const int rc = sqlite3_step(stmt); rc == SQLITE_ROW) {
+        const unsigned char* c_uri = sqlite3_column_text(stmt, 0);
+        const unsigned char* c_digest = sqlite3_column_text(stmt, 1);
+
+        return Blob {
+            c_uri ? reinterpret_cast<const char*>(c_uri) : "",
+            c_digest ? reinterpret_cast<const char*>(c_digest) : "",
+            static_cast<uint64_t>(sqlite3_column_int64(stmt, 2))
+        };
+    }
+
+    return std::nullopt;
+}
+
+auto DatabaseManager::upsertBlob(const Blob& blob) const -> bool
+{
+    sqlite3_stmt* stmt = statement(upsert_blob_sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    const StatementScope scope(stmt);
+
+    sqlite3_bind_text(stmt, 1, blob.uri.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, blob.digest.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 3, static_cast<sqlite3_int64>(blob.size));
+
+    const int rc = sqlite3_step(stmt);
+    return rc == SQLITE_DONE;
+}
+
+auto DatabaseManager::isBlobShared(const std::string& digest, const std::string& uri) const -> bool
+{
+    // On error the blob is taken as shared, so its object is kept
+    sqlite3_stmt* stmt = statement(is_blob_shared_sql);
+    if (!stmt)
+    {
+        return true;
+    }
+
+    const StatementScope scope(stmt);
+
+    sqlite3_bind_text(stmt, 1, digest.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, uri.c_str(), -1, SQLITE_STATIC);
+
+    return sqlite3_step(stmt) != SQLITE_DONE;
+}
+
+auto DatabaseManager::getPackEntry(const std::string& uri) const -> std::optional<PackEntry>
+{
+    sqlite3_stmt* stmt = statement(select_pack_entry_sql);
+    if (!stmt)
+    {
+        return std::nullopt;
+    }
+
+    const StatementScope scope(stmt);
+
+    sqlite3_bind_text(stmt, 1, uri.c_str(), -1, SQLITE_TRANSIENT);
+
+    if (const int rc = sqlite3_step(stmt); rc == SQLITE_ROW) {
+        const unsigned char* c_uri = sqlite3_column_text(stmt, 0);
+        const unsigned char* c_pack_group = sqlite3_column_text(stmt, 1);
+        const unsigned char* c_pack = sqlite3_column_text(stmt, 2);
+        const unsigned char* c_etag = sqlite3_column_text(stmt, 5);
+
+        return PackEntry {
+            c_uri ? reinterpret_cast<const char*>(c_uri) : "",
+            c_pack_group ? reinterpret_cast<const char*>(c_pack_group) : "",
+            c_pack ? reinterpret_cast<const char*>(c_pack) : "",
+            static_cast<uint64_t>(sqlite3_column_int64(stmt, 3)),
+            static_cast<uint64_t>(sqlite3_column_int64(stmt, 4)),
+            c_etag ? reinterpret_cast<const char*>(c_etag) : ""
+        };
+    }
+
+    return std::nullopt;
+}
+
+auto DatabaseManager::hasPackEntry(const std::string& uri) const -> bool
+{
+    sqlite3_stmt* stmt = statement(has_pack_entry_sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    const StatementScope scope(stmt);
+
+    sqlite3_bind_text(stmt, 1, uri.c_str(), -1, SQLITE_STATIC);
+
+    return sqlite3_step(stmt) == SQLITE_ROW;
+}
+
+auto DatabaseManager::upsertPackEntry(const PackEntry& pack_entry) const -> bool
+{
+    sqlite3_stmt* stmt = statement(upsert_pack_entry_sql);
+    if (!stmt)
+    {
+        return false;
+    }
+
+    const StatementScope scope(stmt);
 
-    const int rc = sqlite3_step(m_upsertUriMetadataStmt);
+    sqlite3_bind_text(stmt, 1, pack_entry.uri.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, pack_entry.pack_group.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, pack_entry.pack.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(pack_entry.offset));
+    sqlite3_bind_int64(stmt, 5, static_cast<sqlite3_int64>(pack_entry.length));
+    sqlite3_bind_text(stmt, 6, pack_entry.etag.c_str(), -1, SQLITE_TRANSIENT);
+
+    const int rc = sqlite3_step(stmt);
     return rc == SQLITE_DONE;
 }
 
-auto DatabaseManager::prepareStatements() -> void
+auto DatabaseManager::listPackEntries(const std::string& pack_group) const -> std::vector<PackEntry>
+{
+    std::vector<PackEntry> pack_entries;
+
+    sqlite3_stmt* stmt = nullptr;
+    if (const int rc = sqlite3_prepare_v2(handle(),
+        R"(SELECT uri, pack_group, pack, offset, length, etag FROM pack_entries WHERE pack_group = ? ORDER BY uri)",
+        -1, &stmt, nullptr); rc != SQLITE_OK)
+    {
+        DB_ERROR("Prepare error for listPackEntries: {}", sqlite3_errmsg(handle()));
+        return pack_entries;
+    }
+
+    sqlite3_bind_text(stmt, 1, pack_group.c_str(), -1, SQLITE_TRANSIENT);
+
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const unsigned char* c_uri = sqlite3_column_text(stmt, 0);
+        const unsigned char* c_pack_group = sqlite3_column_text(stmt, 1);
+        const unsigned char* c_pack = sqlite3_column_text(stmt, 2);
+        const unsigned char* c_etag = sqlite3_column_text(stmt, 5);
+
+        pack_entries.push_back(PackEntry {
+            c_uri ? reinterpret_cast<const char*>(c_uri) : "",
+            c_pack_group ? reinterpret_cast<const char*>(c_pack_group) : "",
+            c_pack ? reinterpret_cast<const char*>(c_pack) : "",
+            static_cast<uint64_t>(sqlite3_column_int64(stmt, 3)),
+            static_cast<uint64_t>(sqlite3_column_int64(stmt, 4)),
+            c_etag ? reinterpret_cast<const char*>(c_etag) : ""
+        });
+    }
+
+    sqlite3_finalize(stmt);
+
+    return pack_entries;
+}
+
+auto DatabaseManager::insertSyncRun(const SyncRun& sync_run, const std::vector<Change>& changes) const -> std::optional<int64_t>
+{
+    if (!beginTransaction())
+    {
+        return std::nullopt;
+    }
+
+    const auto rollback = [this]
+    {
+        if (!this->rollback())
+        {
+            DB_ERROR("Unable to roll the sync run back");
+        }
+        return std::nullopt;
+    };
+
+    sqlite3_stmt* run_stmt = statement(insert_sync_run_sql);
+    sqlite3_stmt* change_stmt = statement(insert_change_sql);
+    if (!run_stmt || !change_stmt)
+    {
+        return rollback();
+    }
+
+    int64_t id = 0;
+    {
+        const StatementScope scope(run_stmt);
+
+        sqlite3_bind_int64(run_stmt, 1, sync_run.started_at);
+        sqlite3_bind_int64(run_stmt, 2, sync_run.finished_at);
+        sqlite3_bind_text(run_stmt, 3, sync_run.shard.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(run_stmt, 4, static_cast<sqlite3_int64>(sync_run.added));
+        sqlite3_bind_int64(run_stmt, 5, static_cast<sqlite3_int64>(sync_run.modified));
+        sqlite3_bind_int64(run_stmt, 6, static_cast<sqlite3_int64>(sync_run.removed));
+
+        if (sqlite3_step(run_stmt) != SQLITE_DONE)
+        {
+            DB_ERROR("INSERT sync_runs error: {}", sqlite3_errmsg(handle()));
+            return rollback();
+        }
+
+        id = sqlite3_last_insert_rowid(handle());
+    }
+
+    for (const auto& change : changes)
+    {
+        const StatementScope scope(change_stmt);
+
+        sqlite3_bind_int64(change_stmt, 1, id);
+        sqlite3_bind_text(change_stmt, 2, change.action.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(change_stmt, 3, change.kind.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(change_stmt, 4, change.uri.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(change_stmt, 5, change.path.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(change_stmt, 6, change.digest.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(change_stmt, 7, static_cast<sqlite3_int64>(change.size));
+
+        if (sqlite3_step(change_stmt) != SQLITE_DONE)
+        {
+            DB_ERROR("INSERT changes error: {}", sqlite3_errmsg(handle()));
+            return rollback();
+        }
+    }
+
+    if (!commit())
+    {
+        return rollback();
+    }
+
+    return id;
+}
+
+auto DatabaseManager::beginMerge() const -> bool
+{
+    // URIs already taken from a shard during this session
+    return execute("CREATE TEMP TABLE IF NOT EXISTS merged_uris (uri TEXT PRIMARY KEY); DELETE FROM temp.merged_uris;");
+}
+
+auto DatabaseManager::endMerge() const -> void
+{
+    if (!execute("DROP TABLE IF EXISTS temp.merged_uris"))
+    {
+        DB_ERROR("Unable to end the merge session");
+    }
+}
+
+auto DatabaseManager::mergeShard(const std::string& path) const -> std::optional<MergeResult>
+{
+    sqlite3_stmt* attach_stmt = nullptr;
+    if (const int rc = sqlite3_prepare_v2(handle(), "ATTACH DATABASE ? AS shard", -1, &attach_stmt, nullptr); rc != SQLITE_OK)
+    {
+        DB_ERROR("Prepare error for mergeShard: {}", sqlite3_errmsg(handle()));
+        return std::nullopt;
+    }
+
+    sqlite3_bind_text(attach_stmt, 1, path.c_str(), -1, SQLITE_TRANSIENT);
+    const int attach_rc = sqlite3_step(attach_stmt);
+    sqlite3_finalize(attach_stmt);
+
+    if (attach_rc != SQLITE_DONE)
+    {
+        DB_ERROR("ATTACH {} error: {}", path, sqlite3_errmsg(handle()));
+        return std::nullopt;
+    }
+
+    MergeResult result;
+
+    const auto rollback = [this, &path]
+    {
+        if (!this->rollback())
+        {
+            DB_ERROR("Unable to roll the merge of {} back", path);
+        }
+    };
+
+    const auto merge = [this, &result, &rollback]
+    {
+        if (!beginTransaction())
+        {
+            return false;
+        }
+
+        sqlite3_stmt* stmt = nullptr;
+        if (const int rc = sqlite3_prepare_v2(handle(),
+            R"(SELECT s.uri, m.etag, m.digest, s.etag, s.digest
+               FROM shard.uri_metadata s JOIN main.uri_metadata m ON m.uri = s.uri
+               WHERE s.uri IN (SELECT uri FROM temp.merged_uris) AND (m.etag <> s.etag OR m.digest <> s.digest))",
+            -1, &stmt, nullptr); rc != SQLITE_OK)
+        {
+            DB_ERROR("Prepare error for mergeShard: {}", sqlite3_errmsg(handle()));
+            rollback();
+            return false;
+        }
+
+        const auto text = [&stmt](const int column) -> std::string
+        {
+            const unsigned char* value = sqlite3_column_text(stmt, column);
+            return value ? reinterpret_cast<const char*>(value) : "";
+        };
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            result.conflicts.push_back(MergeConflict {text(0), text(1), text(2), text(3), text(4)});
+        }
+
+        sqlite3_finalize(stmt);
+
+        // Columns are named, databases upgraded by addColumnIfMissing do not share the column order
+        if (!execute(R"(
+                INSERT OR REPLACE INTO main.uri_metadata (uri, etag, last_updated, digest, size, file_path, parent_uri, parent_etag, validated_at)
+                SELECT uri, etag, last_updated, digest, size, file_path, parent_uri, parent_etag, validated_at FROM shard.uri_metadata
+                WHERE uri NOT IN (SELECT uri FROM temp.merged_uris);
+            )"))
+        {
+            rollback();
+            return false;
+        }
+
+        result.merged = static_cast<uint64_t>(sqlite3_changes(handle()));
+
+        // The parent records the last run of the shard in its own change feed
+        if (const int rc = sqlite3_prepare_v2(handle(),
+            R"(SELECT action, kind, uri, path, digest, size FROM shard.changes
+               WHERE run_id = (SELECT MAX(id) FROM shard.sync_runs) ORDER BY rowid)",
+            -1, &stmt, nullptr); rc != SQLITE_OK)
+        {
+            DB_ERROR("Prepare error for mergeShard: {}", sqlite3_errmsg(handle()));
+            rollback();
+            return false;
+        }
+
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            result.changes.push_back(Change {text(0), text(1), text(2), text(3), text(4), static_cast<uint64_t>(sqlite3_column_int64(stmt, 5))});
+        }
+
+        sqlite3_finalize(stmt);
+
+        if (!execute(R"(
+                INSERT OR REPLACE INTO main.blobs (uri, digest, size)
+                SELECT uri, digest, size FROM shard.blobs
+                WHERE uri NOT IN (SELECT uri FROM temp.merged_uris);
+                INSERT OR REPLACE INTO main.pack_entries (uri, pack_group, pack, offset, length, etag)
+                SELECT uri, pack_group, pack, offset, length, etag FROM shard.pack_entries
+                WHERE uri NOT IN (SELECT uri FROM temp.merged_uris);
+            )"))
+        {
+            rollback();
+            return false;
+        }
+
+        if (!execute("INSERT OR IGNORE INTO temp.merged_uris (uri) SELECT uri FROM shard.uri_metadata"))
+        {
+            rollback();
+            return false;
+        }
+
+        return commit();
+    };
+
+    const bool merged = merge();
+
+    if (!execute("DETACH DATABASE shard") || !merged)
+    {
+        return std::nullopt;
+    }
+
+    return result;
+}
+
+auto DatabaseManager::execute(const char* sql) const -> bool
 {
-    if (const int rc = sqlite3_prepare_v2(m_db,
-        R"(SELECT uri, etag, last_updated FROM uri_metadata WHERE uri = ?)",
-        -1, &m_selectUriMetadataStmt, nullptr); rc != SQLITE_OK)
+    char* errMsg = nullptr;
+    if (const int rc = sqlite3_exec(handle(), sql, nullptr, nullptr, &errMsg); rc != SQLITE_OK)
     {
-        DB_ERROR("Prepare error for m_selectUriMetadataStmt: {}", sqlite3_errmsg(m_db));
+        DB_ERROR("SQL error: {}", errMsg);
+
+        sqlite3_free(errMsg);
+        return false;
     }
+    return true;
+}
+
+auto DatabaseManager::connection() const -> Connection*
+{
+    const std::lock_guard lock(m_connections_mutex);
 
-    if (const int rc = sqlite3_prepare_v2(m_db,
-        R"(
-            INSERT INTO uri_metadata (uri, etag, last_updated)
-            VALUES (?, ?, ?)
-            ON CONFLICT(uri) DO UPDATE SET
-                etag=excluded.etag,
-                last_updated=excluded.last_updated
-        )",
-        -1, &m_upsertUriMetadataStmt, nullptr); rc != SQLITE_OK)
+    auto& connection = m_connections[std::this_thread::get_id()];
+    if (!connection)
     {
-        DB_ERROR("Prepare error for m_upsertUriMetadataStmt: {}", sqlite3_errmsg(m_db));
+        connection = openConnection(m_path, m_pending_rows);
     }
+
+    return connection.get();
+}
+
+auto DatabaseManager::connectionCount() const -> size_t
+{
+    const std::lock_guard lock(m_connections_mutex);
+
+    return m_connections.size();
+}
+
+auto DatabaseManager::handle() const -> sqlite3*
+{
+    const auto connection = this->connection();
+    return connection ? connection->db : nullptr;
+}
+
+auto DatabaseManager::statement(const char* sql) const -> sqlite3_stmt*
+{
+    const auto connection = this->connection();
+    return connection ? connection->statement(sql) : nullptr;
+}
+
+auto DatabaseManager::openConnection(const std::string& path, std::atomic<uint64_t>& pending_rows) -> std::unique_ptr<Connection>
+{
+    auto connection = std::make_unique<Connection>();
+    connection->pending_rows = &pending_rows;
+
+    // A connection never leaves its thread, SQLite does not need to lock it
+    if (const int rc = sqlite3_open_v2(path.c_str(), &connection->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr); rc != SQLITE_OK)
+    {
+        DB_ERROR("Open database error: {}", sqlite3_errmsg(connection->db));
+
+        return nullptr;
+    }
+
+    sqlite3_busy_handler(connection->db, busyHandler, nullptr);
+
+    sqlite3_update_hook(connection->db, updateHook, connection.get());
+    sqlite3_commit_hook(connection->db, endTransactionHook, connection.get());
+    sqlite3_rollback_hook(connection->db, [](void* user_data) { endTransactionHook(user_data); }, connection.get());
+
+    // WAL lets readers go on while a writer commits; NORMAL only syncs at checkpoints, which WAL keeps consistent
+    char* errMsg = nullptr;
+    if (const int rc = sqlite3_exec(connection->db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;", nullptr, nullptr, &errMsg); rc != SQLITE_OK)
+    {
+        DB_ERROR("PRAGMA journal_mode error: {}", errMsg);
+
+        sqlite3_free(errMsg);
+        return nullptr;
+    }
+
+    return connection;
+}
+
+auto DatabaseManager::busyHandler(void*, const int count) -> int
+{
+    if (count >= max_busy_retries)
+    {
+        DB_WARN("Database still locked after {} retries", count);
+        return 0;
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(count < 7 ? 1 << count : 100));
+
+    return 1;
+}
+
+auto DatabaseManager::updateHook(void* user_data, int, const char*, const char*, sqlite3_int64) -> void
+{
+    const auto connection = static_cast<Connection*>(user_data);
+
+    connection->uncommitted_rows++;
+    connection->pending_rows->fetch_add(1, std::memory_order_relaxed);
+}
+
+auto DatabaseManager::endTransactionHook(void* user_data) -> int
+{
+    const auto connection = static_cast<Connection*>(user_data);
+
+    connection->pending_rows->fetch_sub(connection->uncommitted_rows, std::memory_order_relaxed);
+    connection->uncommitted_rows = 0;
+
+    // 0 lets the commit go on
+    return 0;
 }
 
 auto DatabaseManager::createModel() const -> bool
@@ -134,11 +899,17 @@ auto DatabaseManager::createModel() const -> bool
             CREATE TABLE IF NOT EXISTS uri_metadata (
                 uri TEXT PRIMARY KEY,
                 etag TEXT NOT NULL,
-                last_updated TEXT NOT NULL
+                last_updated TEXT NOT NULL,
+                digest TEXT NOT NULL DEFAULT '',
+                size INTEGER NOT NULL DEFAULT 0,
+                file_path TEXT NOT NULL DEFAULT '',
+                parent_uri TEXT NOT NULL DEFAULT '',
+                parent_etag TEXT NOT NULL DEFAULT '',
+                validated_at INTEGER NOT NULL DEFAULT 0
             )
         )";
 
-    if (const int rc = sqlite3_exec(m_db, createUriMetadataTableSQL, nullptr, nullptr, &errMsg); rc != SQLITE_OK)
+    if (const int rc = sqlite3_exec(handle(), createUriMetadataTableSQL, nullptr, nullptr, &errMsg); rc != SQLITE_OK)
     {
         DB_ERROR("CREATE TABLE languages error: {}", errMsg);
 
@@ -146,5 +917,126 @@ auto DatabaseManager::createModel() const -> bool
         return false;
     }
 
+    // Databases created before integrity hashes were recorded
+    if (!addColumnIfMissing("uri_metadata", "digest", "TEXT NOT NULL DEFAULT ''") ||
+        !addColumnIfMissing("uri_metadata", "size", "INTEGER NOT NULL DEFAULT 0") ||
+        !addColumnIfMissing("uri_metadata", "file_path", "TEXT NOT NULL DEFAULT ''") ||
+        !addColumnIfMissing("uri_metadata", "parent_uri", "TEXT NOT NULL DEFAULT ''") ||
+        !addColumnIfMissing("uri_metadata", "parent_etag", "TEXT NOT NULL DEFAULT ''") ||
+        !addColumnIfMissing("uri_metadata", "validated_at", "INTEGER NOT NULL DEFAULT 0"))
+    {
+        return false;
+    }
+
+    // The garbage collector looks the images of a set up by their cards.json
+    if (!execute("CREATE INDEX IF NOT EXISTS uri_metadata_parent_uri ON uri_metadata (parent_uri)"))
+    {
+        return false;
+    }
+
+    const auto createBlobsTableSQL = R"(
+            CREATE TABLE IF NOT EXISTS blobs (
+                uri TEXT PRIMARY KEY,
+                digest TEXT NOT NULL,
+                size INTEGER NOT NULL
+            );
+            CREATE INDEX IF NOT EXISTS blobs_digest ON blobs (digest);
+        )";
+
+    if (const int rc = sqlite3_exec(handle(), createBlobsTableSQL, nullptr, nullptr, &errMsg); rc != SQLITE_OK)
+    {
+        DB_ERROR("CREATE TABLE blobs error: {}", errMsg);
+
+        sqlite3_free(errMsg);
+        return false;
+    }
+
+    const auto createPackEntriesTableSQL = R"(
+            CREATE TABLE IF NOT EXISTS pack_entries (
+                uri TEXT PRIMARY KEY,
+                pack_group TEXT NOT NULL,
+                pack TEXT NOT NULL,
+                offset INTEGER NOT NULL,
+                length INTEGER NOT NULL,
+                etag TEXT NOT NULL
+            );
+            CREATE INDEX IF NOT EXISTS pack_entries_pack_group ON pack_entries (pack_group);
+        )";
+
+    if (const int rc = sqlite3_exec(handle(), createPackEntriesTableSQL, nullptr, nullptr, &errMsg); rc != SQLITE_OK)
+    {
+        DB_ERROR("CREATE TABLE pack_entries error: {}", errMsg);
+
+        sqlite3_free(errMsg);
+        return false;
+    }
+
+    const auto createChangesTablesSQL = R"(
+            CREATE TABLE IF NOT EXISTS sync_runs (
+                id INTEGER PRIMARY KEY AUTOINCREMENT,
+                started_at INTEGER NOT NULL,
+                finished_at INTEGER NOT NULL,
+                shard TEXT NOT NULL,
+                added INTEGER NOT NULL,
+                modified INTEGER NOT NULL,
+                removed INTEGER NOT NULL
+            );
+            CREATE TABLE IF NOT EXISTS changes (
+                run_id INTEGER NOT NULL REFERENCES sync_runs (id),
+                action TEXT NOT NULL,
+                kind TEXT NOT NULL,
+                uri TEXT NOT NULL,
+                path TEXT NOT NULL,
+                digest TEXT NOT NULL,
+                size INTEGER NOT NULL
+            );
+            CREATE INDEX IF NOT EXISTS changes_run_id ON changes (run_id);
+        )";
+
+    if (const int rc = sqlite3_exec(handle(), createChangesTablesSQL, nullptr, nullptr, &errMsg); rc != SQLITE_OK)
+    {
+        DB_ERROR("CREATE TABLE changes error: {}", errMsg);
+
+        sqlite3_free(errMsg);
+        return false;
+    }
+
+    return true;
+}
+
+auto DatabaseManager::addColumnIfMissing(const char* table, const char* column, const char* definition) const -> bool
+{
+    sqlite3_stmt* stmt = nullptr;
+    if (const int rc = sqlite3_prepare_v2(handle(), fmt::format("PRAGMA table_info({})", table).c_str(), -1, &stmt, nullptr); rc != SQLITE_OK)
+    {
+        DB_ERROR("PRAGMA table_info({}) error: {}", table, sqlite3_errmsg(handle()));
+        return false;
+    }
+
+    bool found = false;
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const unsigned char* c_name = sqlite3_column_text(stmt, 1);
+        found = c_name && std::string_view(reinterpret_cast<const char*>(c_name)) == column;
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (found)
+    {
+        return true;
+    }
+
+    char* errMsg = nullptr;
+    if (const int rc = sqlite3_exec(handle(), fmt::format("ALTER TABLE {} ADD COLUMN {} {}", table, column, definition).c_str(), nullptr, nullptr, &errMsg); rc != SQLITE_OK)
+    {
+        DB_ERROR("ALTER TABLE {} ADD COLUMN {} error: {}", table, column, errMsg);
+
+        sqlite3_free(errMsg);
+        return false;
+    }
+
+    DB_INFO("Added column {}.{}", table, column);
+
     return true;
 }
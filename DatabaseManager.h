@@ -6,13 +6,38 @@
 #define DATABASE_MANAGER_H
 
 #include <sqlite3.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
+// Every thread gets its own connection to the database, in WAL mode, so
+// several threads and processes can read while one writes. Writers wait for
+// each other with a backoff instead of failing with SQLITE_BUSY.
 class DatabaseManager {
-    sqlite3* m_db{nullptr};
-    sqlite3_stmt* m_selectUriMetadataStmt{nullptr};
-    sqlite3_stmt* m_upsertUriMetadataStmt{nullptr};
+    struct Connection {
+        sqlite3* db{nullptr};
+        // SQL text -> statement prepared on first use
+        std::unordered_map<const char*, sqlite3_stmt*> statements;
+        // Rows written since the last commit or rollback, counted by SQLite's hooks into pending_rows too
+        uint64_t uncommitted_rows = 0;
+        std::atomic<uint64_t>* pending_rows = nullptr;
+
+        ~Connection();
+
+        [[nodiscard]] auto statement(const char* sql) -> sqlite3_stmt*;
+    };
+
+    std::string m_path;
+    mutable std::mutex m_connections_mutex;
+    mutable std::unordered_map<std::thread::id, std::unique_ptr<Connection>> m_connections;
+    mutable std::atomic<uint64_t> m_commits{0};
+    mutable std::atomic<uint64_t> m_pending_rows{0};
 
 public:
     DatabaseManager();
@@ -22,20 +47,131 @@ public:
         std::string uri;
         std::string etag;
         std::string last_update;
+        std::string digest;
+        uint64_t size = 0;
+        std::string file_path;
+        // cards.json the image was listed in, and its ETag when the image was last validated
+        std::string parent_uri;
+        std::string parent_etag;
+        // Unix time of the last 200 or 304 for the uri
+        int64_t validated_at = 0;
+    };
+
+    struct Blob {
+        std::string uri;
+        std::string digest;
+        uint64_t size = 0;
+    };
+
+    struct PackEntry {
+        std::string uri;
+        std::string pack_group;
+        std::string pack;
+        uint64_t offset = 0;
+        uint64_t length = 0;
+        std::string etag;
+    };
+
+    // Same URI recorded with a different ETag or digest by two shards
+    struct MergeConflict {
+        std::string uri;
+        std::string etag;
+        std::string digest;
+        std::string shard_etag;
+        std::string shard_digest;
+    };
+
+    // One sync, with the number of changes it recorded of each action
+    struct SyncRun {
+        int64_t id = 0;
+        int64_t started_at = 0;
+        int64_t finished_at = 0;
+        std::string shard;
+        uint64_t added = 0;
+        uint64_t modified = 0;
+        uint64_t removed = 0;
+    };
+
+    // A file a sync added, modified or removed
+    struct Change {
+        std::string action;
+        std::string kind;
+        std::string uri;
+        std::string path;
+        std::string digest;
+        uint64_t size = 0;
+    };
+
+    struct MergeResult {
+        uint64_t merged = 0;
+        std::vector<MergeConflict> conflicts;
+        // Changes of the last run of the shard
+        std::vector<Change> changes;
     };
 
     auto open(const std::string& path) -> bool;
     auto close() -> void;
 
+    // BEGIN IMMEDIATE on the connection of the calling thread, so the write lock
+    // is taken (or waited for) upfront instead of failing on the first write
     [[nodiscard]] auto beginTransaction() const -> bool;
     [[nodiscard]] auto commit() const -> bool;
+    // Ends the transaction of the calling thread without writing its rows
+    auto rollback() const -> bool;
+    // Transactions committed since the database was opened
+    [[nodiscard]] auto commits() const -> uint64_t { return m_commits.load(std::memory_order_relaxed); }
+    // Rows written in transactions still open, on every connection
+    [[nodiscard]] auto pendingRows() const -> uint64_t { return m_pending_rows.load(std::memory_order_relaxed); }
+    // One per thread that used the database
+    [[nodiscard]] auto connectionCount() const -> size_t;
 
     [[nodiscard]] auto getUriMetadata(const std::string& uri) const -> std::optional<UriMetadata>;
     [[nodiscard]] auto upsertUriMetadata(const UriMetadata& uri_metadata) const -> bool;
+    // ETag and Last-Modified of uri read into the caller's buffers, cleared when unknown
+    auto getValidators(const std::string& uri, std::string& etag, std::string& last_update) const -> bool;
+    [[nodiscard]] auto listHashedUriMetadata() const -> std::vector<UriMetadata>;
+    // Images recorded as listed in the cards.json of parent_uri
+    [[nodiscard]] auto listUriMetadataByParent(const std::string& parent_uri) const -> std::vector<UriMetadata>;
+    // Drops the uri_metadata, blobs and pack_entries rows of uri
+    [[nodiscard]] auto deleteUriMetadata(const std::string& uri) const -> bool;
+    // Records a 304: the uri is still valid under the given parent
+    [[nodiscard]] auto markValidated(const std::string& uri, const std::string& parent_uri, const std::string& parent_etag, int64_t validated_at) const -> bool;
+
+    [[nodiscard]] auto getBlob(const std::string& uri) const -> std::optional<Blob>;
+    [[nodiscard]] auto upsertBlob(const Blob& blob) const -> bool;
+    // Whether another uri than uri is stored as the blob of digest
+    [[nodiscard]] auto isBlobShared(const std::string& digest, const std::string& uri) const -> bool;
+
+    [[nodiscard]] auto getPackEntry(const std::string& uri) const -> std::optional<PackEntry>;
+    [[nodiscard]] auto hasPackEntry(const std::string& uri) const -> bool;
+    [[nodiscard]] auto upsertPackEntry(const PackEntry& pack_entry) const -> bool;
+    [[nodiscard]] auto listPackEntries(const std::string& pack_group) const -> std::vector<PackEntry>;
+
+    // Records the run and its changes in one transaction, returns the id of the run
+    [[nodiscard]] auto insertSyncRun(const SyncRun& sync_run, const std::vector<Change>& changes) const -> std::optional<int64_t>;
+
+    // Starts a merge session on the connection of the calling thread, the
+    // URIs taken by an earlier session no longer count
+    [[nodiscard]] auto beginMerge() const -> bool;
+    // Copies the rows of a shard database over this one. The first shard
+    // merged in the session wins for a URI several shards recorded, the others
+    // are reported.
+    [[nodiscard]] auto mergeShard(const std::string& path) const -> std::optional<MergeResult>;
+    auto endMerge() const -> void;
 
 private:
-    auto prepareStatements() -> void;
+    [[nodiscard]] auto connection() const -> Connection*;
+    [[nodiscard]] auto handle() const -> sqlite3*;
+    [[nodiscard]] auto statement(const char* sql) const -> sqlite3_stmt*;
+    [[nodiscard]] static auto openConnection(const std::string& path, std::atomic<uint64_t>& pending_rows) -> std::unique_ptr<Connection>;
+    static auto busyHandler(void* user_data, int count) -> int;
+    static auto updateHook(void* user_data, int operation, const char* database, const char* table, sqlite3_int64 rowid) -> void;
+    // Commit and rollback both end the pending rows of the connection
+    static auto endTransactionHook(void* user_data) -> int;
+
     [[nodiscard]] auto createModel() const -> bool;
+    [[nodiscard]] auto execute(const char* sql) const -> bool;
+    [[nodiscard]] auto addColumnIfMissing(const char* table, const char* column, const char* definition) const -> bool;
 };
 
 #endif //DATABASE_MANAGER_H
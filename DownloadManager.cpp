@@ -4,37 +4,131 @@
 
 #include "DownloadManager.h"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
-#include <fstream>
+#include <iterator>
+#include <memory>
 #include <string>
 #include <filesystem>
+#include <thread>
 #include <curl/curl.h>
+#include <fcntl.h>
+#include <unistd.h>
 
+#include "AllocationCounter.h"
+#include "ConnectionCache.h"
+#include "FileSink.h"
+#include "Hasher.h"
 #include "Logs.h"
+#include "ObjectStore.h"
+#include "PackArchive.h"
 
 bool DownloadManager::m_initialized = false;
 
+namespace {
+    auto unixTime() -> int64_t
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // std::filesystem::exists builds a path, access does not allocate
+    auto fileExists(const std::string& path) -> bool
+    {
+        return ::access(path.c_str(), F_OK) == 0;
+    }
+
+    char accept_header[] = "accept: application/json";
+}
+
+// Per-transfer state, pooled by DownloadManager: its strings keep their
+// capacity and its easy handle is reset rather than recreated, so once the
+// pool is warm a transfer allocates nothing of its own.
 struct transfer_private_data {
     size_t download_index = 0;
-    std::ofstream* file = nullptr;
+    CURL* easy_handle = nullptr;
+    // Saves the HSTS cache on cleanup, so it goes back to the pool without its handle
+    bool writer = false;
+    // The handle was created for this transfer and has not read the Alt-Svc file yet
+    bool created = false;
+    FileSink* sink = nullptr;
+    FileSink::File* file = nullptr;
     std::string file_path;
-    curl_slist* list = nullptr;
-};
+    // The same temporary file is reused by every transfer of this context
+    std::string pack_temporary_path;
+    std::string object_temporary_path;
+    bool content_addressed = false;
+    bool packed = false;
+    Hasher hasher;
+
+    // Request headers point at these buffers instead of curl_slist_append copies
+    std::array<curl_slist, 3> headers{};
+    std::string if_none_match;
+    std::string if_modified_since;
+
+    // Validators of the cached copy, then the row recorded for the new body
+    DatabaseManager::UriMetadata row;
+
+    transfer_private_data() = default;
+    ~transfer_private_data()
+    {
+        if (easy_handle)
+        {
+            curl_easy_cleanup(easy_handle);
+        }
+    }
+
+    transfer_private_data(const transfer_private_data&) = delete;
+    transfer_private_data& operator=(const transfer_private_data&) = delete;
 
-size_t WriteCallback(void* contents, const size_t size, const size_t nmemb, const transfer_private_data* transfer) {
-    if (!transfer->file->is_open())
+    auto setHeaders() -> curl_slist*
     {
-        // We create the path if needed
-        if (const auto parent_path = std::filesystem::path(transfer->file_path).parent_path(); !std::filesystem::exists(parent_path))
+        size_t count = 0;
+        headers[count++].data = accept_header;
+        if (!if_none_match.empty())
+        {
+            headers[count++].data = if_none_match.data();
+        }
+        if (!if_modified_since.empty())
         {
-            std::filesystem::create_directories(parent_path);
+            headers[count++].data = if_modified_since.data();
         }
 
-        transfer->file->open(transfer->file_path, std::ios::out | std::ios::trunc | std::ios::binary);
+        for (size_t i = 0; i < count; i++)
+        {
+            headers[i].next = i + 1 < count ? &headers[i + 1] : nullptr;
+        }
+
+        return headers.data();
+    }
+};
+
+size_t WriteCallback(void* contents, const size_t size, const size_t nmemb, transfer_private_data* transfer) {
+    if (!transfer->file)
+    {
+        // Headers are in, Content-Length (if any) lets the sink preallocate the file
+        curl_off_t content_length = -1;
+        curl_easy_getinfo(transfer->easy_handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+
+        transfer->file = transfer->sink->open(transfer->file_path, content_length > 0 ? static_cast<uint64_t>(content_length) : 0);
+
+        if (!transfer->file)
+        {
+            // Aborts the transfer with CURLE_WRITE_ERROR
+            return 0;
+        }
     }
 
     const size_t totalSize = size * nmemb;
-    transfer->file->write(static_cast<char*>(contents), totalSize);
+    if (!transfer->sink->write(transfer->file, contents, totalSize))
+    {
+        return 0;
+    }
+    transfer->hasher.update(contents, totalSize);
+
     return totalSize;
 }
 
@@ -45,58 +139,248 @@ auto DownloadManager::download(std::vector<DownloadParameter>& download_paramete
     // Initialize empty result
     auto result = std::vector<DownloadResult>(download_parameters.size());
 
-    // Initialize multi download
-    const auto multi_handle = curl_multi_init();
+    // Reuse an idle multi handle, and with it its open connections
+    const auto multi_handle = acquireMultiHandle();
     if (!multi_handle)
     {
-        CURL_ERROR("curl_multi_init");
+        for (size_t index = 0; index < download_parameters.size(); index++)
+        {
+            result[index].parameter = &download_parameters[index];
+            result[index].success = false;
+            result[index].error = "Unable to create a multi handle";
+        }
+
+        m_failures.fetch_add(download_parameters.size(), std::memory_order_relaxed);
+        return result;
     }
 
-    // Configurer le multiplexing HTTP/2
-    curl_multi_setopt(multi_handle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
-    curl_multi_setopt(multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS, 1L);
+    const auto file_sink = acquireFileSink();
+
+    // Primary parameter of each URI -> the other parameters asking for it
+    std::unordered_map<size_t, std::vector<size_t>> followers;
+    // Parameters whose URI is being fetched by an overlapping call
+    std::vector<std::pair<size_t, std::shared_ptr<InFlight>>> awaited;
+    // Parameters fetched by this call, with the entry the overlapping calls wait on
+    std::vector<std::pair<size_t, std::shared_ptr<InFlight>>> transfers;
+    std::unordered_map<size_t, std::shared_ptr<InFlight>> owned;
+
+    {
+        // Coalescing key -> primary index, or SIZE_MAX when awaited
+        std::unordered_map<std::string, std::pair<size_t, std::shared_ptr<InFlight>>> planned;
+
+        const std::lock_guard lock(m_in_flight_mutex);
+
+        for (size_t index = 0; index < download_parameters.size(); index++)
+        {
+            const auto& parameter = download_parameters[index];
+            result[index].parameter = &download_parameters[index];
+
+            // A packed body has no file to link, so it only coalesces within its pack group,
+            // and a body kept compressed is not the same file as the decoded one
+            auto key = fmt::format("{}\n{}\n{}", parameter.uri, isPacked(parameter) ? parameter.pack_group : "", static_cast<int>(parameter.encoding));
+
+            if (const auto it = planned.find(key); it != planned.end())
+            {
+                if (it->second.first == SIZE_MAX)
+                {
+                    awaited.emplace_back(index, it->second.second);
+                    it->second.second->waiters++;
+                }
+                else
+                {
+                    followers[it->second.first].push_back(index);
+                }
+                continue;
+            }
+
+            if (const auto it = m_in_flight.find(key); it != m_in_flight.end())
+            {
+                awaited.emplace_back(index, it->second);
+                it->second->waiters++;
+                planned.emplace(std::move(key), std::make_pair(SIZE_MAX, it->second));
+                continue;
+            }
+
+            auto in_flight = std::make_shared<InFlight>();
+            in_flight->key = key;
+            m_in_flight.emplace(key, in_flight);
+            transfers.emplace_back(index, in_flight);
+            owned.emplace(index, in_flight);
+            planned.emplace(std::move(key), std::make_pair(index, std::move(in_flight)));
+        }
+    }
+
+    if (transfers.size() != download_parameters.size())
+    {
+        CURL_INFO("{} parameters, {} transfers ({} awaited from other downloads)", download_parameters.size(), transfers.size(), awaited.size());
+    }
+
+    // Links the primary body to its followers and releases the overlapping calls
+    const auto complete = [&](const size_t download_index)
+    {
+        const auto& in_flight = owned.at(download_index);
+
+        // No call can start waiting once the entry is gone
+        size_t waiters;
+        {
+            const std::lock_guard lock(m_in_flight_mutex);
+            m_in_flight.erase(in_flight->key);
+            waiters = in_flight->waiters;
+        }
+
+        const auto it = followers.find(download_index);
+        if (it != followers.end() || waiters > 0)
+        {
+            const auto& parameter = *result[download_index].parameter;
+            const auto source_path = isPacked(parameter) ? std::string() : parameter.destination_file_path;
+
+            if (it != followers.end())
+            {
+                for (const auto follower : it->second)
+                {
+                    fanOut(result[download_index], source_path, result[follower]);
+                }
+            }
+
+            const std::lock_guard lock(in_flight->mutex);
+            in_flight->result = result[download_index];
+            in_flight->result.parameter = nullptr;
+            in_flight->source_path = source_path;
+        }
+
+        {
+            const std::lock_guard lock(in_flight->mutex);
+            in_flight->done = true;
+        }
+        in_flight->condition.notify_all();
+    };
+
+    // Addresses of the previous run and the HSTS writer go to the first handles only
+    curl_slist* resolve = m_connection_cache->takeResolveList();
+    const bool owns_writer = m_connection_cache->acquireWriter();
+    bool writer = owns_writer;
 
     size_t batch_size = 0;
-    size_t i = 0;
+    size_t next_transfer = 0;
+    uint64_t received_bytes = 0;
+    uint64_t written_bytes = 0;
+
+    std::vector<size_t> completed;
+    completed.reserve(std::min(m_max_parallel, transfers.size()));
 
-    while (i < download_parameters.size())
+    // Transfers in the multi handle, taken out by hand if a poll fails
+    std::vector<transfer_private_data*> running;
+    running.reserve(std::min(m_max_parallel, transfers.size()));
+    bool poll_failed = false;
+
+    // Running transfers are capped again as others start and end, their shares add up to the limits
+    uint64_t shares = m_governor->shares();
+    const auto share_bandwidth = [&]
     {
-        CURL_TRACE("{}/{} ({} %)", i, download_parameters.size(), static_cast<float>(i) / static_cast<float>(download_parameters.size()) * 100.0f);
+        if (const auto current = m_governor->shares(); current != shares)
+        {
+            shares = current;
+            for (const auto private_data : running)
+            {
+                const auto& uri = result[private_data->download_index].parameter->uri;
+                curl_easy_setopt(private_data->easy_handle, CURLOPT_MAX_RECV_SPEED_LARGE, m_governor->receiveSpeed(RateGovernor::hostOf(uri)));
+            }
+        }
+    };
+
+    m_queued.fetch_add(transfers.size(), std::memory_order_relaxed);
+
+    // Only this thread drives the transfers, so its counters are the cost of the loop
+    const auto allocations_before = AllocationCounter::currentThread();
+
+    while (next_transfer < transfers.size() && !poll_failed)
+    {
+        CURL_TRACE("{}/{} ({} %)", next_transfer, transfers.size(), static_cast<float>(next_transfer) / static_cast<float>(transfers.size()) * 100.0f);
 
         // Add download to multi download
-        while (batch_size < m_max_parallel && i < download_parameters.size())
+        while (batch_size < m_max_parallel && next_transfer < transfers.size())
         {
-            std::string etag;
-            std::string last_update;
-
-            // We get the current download
-            result[i].parameter = &download_parameters[i];
+            const auto i = transfers[next_transfer].first;
+            const auto& parameter = *result[i].parameter;
+            const auto host = RateGovernor::hostOf(parameter.uri);
 
-            if (std::filesystem::exists(result[i].parameter->destination_file_path))
+            // Admission control: wait for a token only when nothing else runs
+            if (const auto wait = m_governor->admit(host); wait > RateGovernor::Clock::duration::zero())
             {
-                // If the file exists, we get metadata
-                if (auto uri_metadata = m_database_manager.getUriMetadata(result[i].parameter->uri); uri_metadata.has_value())
+                if (batch_size > 0)
                 {
-                    etag = uri_metadata->etag;
-                    last_update = uri_metadata->last_update;
+                    break;
                 }
+
+                std::this_thread::sleep_for(wait);
+                continue;
             }
 
             // Prepare private data
-            auto private_data = new transfer_private_data();
+            const auto private_data = acquireTransfer();
             private_data->download_index = i;
-            private_data->file = new std::ofstream();
-            private_data->file_path = result[i].parameter->destination_file_path;
+            private_data->sink = file_sink;
 
-            // We prepare curl download for this file
-            CURL* curl_easy_handle = curl_easy_init();
-            if (!curl_easy_handle)
+            // We get the current download
+            const bool packed = isPacked(parameter);
+
+            // A 304 is only usable when every destination of the URI is there
+            bool cached = packed ? m_database_manager.hasPackEntry(parameter.uri) : fileExists(parameter.destination_file_path);
+            result[i].created = !cached;
+            if (const auto it = followers.find(i); cached && !packed && it != followers.end())
             {
-                CURL_ERROR("curl_easy_init for {}", result[i].parameter->uri);
+                cached = std::ranges::all_of(it->second, [&](const size_t follower)
+                {
+                    return fileExists(download_parameters[follower].destination_file_path);
+                });
             }
 
+            auto& etag = private_data->row.etag;
+            auto& last_update = private_data->row.last_update;
+
+            if (cached)
+            {
+                // If the file exists, we get metadata
+                m_database_manager.getValidators(parameter.uri, etag, last_update);
+            }
+            else
+            {
+                etag.clear();
+                last_update.clear();
+            }
+
+            if (packed)
+            {
+                // Body is appended to the pack once complete
+                private_data->packed = true;
+                if (private_data->pack_temporary_path.empty())
+                {
+                    private_data->pack_temporary_path = m_pack_archive->temporaryPath().string();
+                }
+                private_data->file_path = private_data->pack_temporary_path;
+            }
+            else if (m_object_store)
+            {
+                // Body goes to a temporary blob, linked to its destination once its hash is known
+                private_data->content_addressed = true;
+                if (private_data->object_temporary_path.empty())
+                {
+                    private_data->object_temporary_path = m_object_store->temporaryPath().string();
+                }
+                private_data->file_path = private_data->object_temporary_path;
+            }
+            else
+            {
+                // Body goes next to its destination and replaces it only once complete
+                private_data->file_path.clear();
+                fmt::format_to(std::back_inserter(private_data->file_path), "{}.{}.part", parameter.destination_file_path, getpid());
+            }
+
+            // We prepare curl download for this file
+            CURL* curl_easy_handle = private_data->easy_handle;
+
             // Configuration HTTP/2
-            curl_easy_setopt(curl_easy_handle, CURLOPT_URL, download_parameters[i].uri.c_str());
+            curl_easy_setopt(curl_easy_handle, CURLOPT_URL, parameter.uri.c_str());
 
             // Callback d'écriture
             curl_easy_setopt(curl_easy_handle, CURLOPT_WRITEFUNCTION, WriteCallback);
@@ -113,8 +397,29 @@ auto DownloadManager::download(std::vector<DownloadParameter>& download_paramete
             /* enlarge the receive buffer for potentially higher transfer speeds */
             curl_easy_setopt(curl_easy_handle, CURLOPT_BUFFERSIZE, 100000L);
 
-            /* HTTP/2 please */
-            curl_easy_setopt(curl_easy_handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_0);
+            // Share of the bandwidth limits, 0 when there are none
+            curl_easy_setopt(curl_easy_handle, CURLOPT_MAX_RECV_SPEED_LARGE, m_governor->receiveSpeed(host));
+
+            switch (parameter.encoding)
+            {
+            case Encoding::Identity:
+                break;
+            case Encoding::Compressed:
+                // Every encoding this libcurl can decode (gzip, deflate, br, zstd)
+                curl_easy_setopt(curl_easy_handle, CURLOPT_ACCEPT_ENCODING, "");
+                break;
+            case Encoding::KeepCompressed:
+                curl_easy_setopt(curl_easy_handle, CURLOPT_ACCEPT_ENCODING, "gzip");
+                curl_easy_setopt(curl_easy_handle, CURLOPT_HTTP_CONTENT_DECODING, 0L);
+                break;
+            }
+
+            m_connection_cache->configure(curl_easy_handle, resolve, writer, private_data->created);
+            private_data->writer = writer;
+            writer = false;
+
+            /* HTTP/2 please, HTTP/3 when available */
+            curl_easy_setopt(curl_easy_handle, CURLOPT_HTTP_VERSION, ConnectionCache::httpVersion());
 
 #if (CURLPIPE_MULTIPLEX > 0)
             /* wait for pipe connection to confirm */
@@ -122,45 +427,53 @@ auto DownloadManager::download(std::vector<DownloadParameter>& download_paramete
             curl_easy_setopt(curl_easy_handle, CURLOPT_PIPEWAIT, 1L);
 #endif
 
-            private_data->list = nullptr;
-            private_data->list = curl_slist_append(private_data->list, "accept: application/json");
-
+            private_data->if_none_match.clear();
             if (!etag.empty()) {
-                const std::string ifNoneMatch = "If-None-Match: " + etag;
-                private_data->list = curl_slist_append(private_data->list, ifNoneMatch.c_str());
+                private_data->if_none_match.append("If-None-Match: ").append(etag);
             }
 
+            private_data->if_modified_since.clear();
             if (!last_update.empty()) {
-                const std::string ifModifiedSince = "If-Modified-Since: " + last_update;
-                private_data->list = curl_slist_append(private_data->list, ifModifiedSince.c_str());
+                private_data->if_modified_since.append("If-Modified-Since: ").append(last_update);
             }
 
-            if (private_data->list) {
-                curl_easy_setopt(curl_easy_handle, CURLOPT_HTTPHEADER, private_data->list);
-            }
+            curl_easy_setopt(curl_easy_handle, CURLOPT_HTTPHEADER, private_data->setHeaders());
 
             curl_multi_add_handle(multi_handle, curl_easy_handle);
+            running.push_back(private_data);
 
             batch_size++;
-            i++;
+            next_transfer++;
+
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            m_active.fetch_add(1, std::memory_order_relaxed);
         }
 
         // Downloads items
+        share_bandwidth();
         int still_running = 0;
         curl_multi_perform(multi_handle, &still_running);
 
         while (still_running) {
             int num_file_descriptors = 0;
 
-            if (auto mc = curl_multi_wait(multi_handle, nullptr, 0, 100, &num_file_descriptors); mc != CURLM_OK) {
-                CURL_ERROR("Erreur curl_multi_wait: {}", curl_multi_strerror(mc));
+            // Unlike curl_multi_wait, still sleeps when every transfer is held back by its receive speed
+            if (auto mc = curl_multi_poll(multi_handle, nullptr, 0, 100, &num_file_descriptors); mc != CURLM_OK) {
+                CURL_ERROR("Erreur curl_multi_poll: {}", curl_multi_strerror(mc));
+                poll_failed = true;
                 break;
             }
 
+            share_bandwidth();
             curl_multi_perform(multi_handle, &still_running);
         }
 
         // We get results
+        completed.clear();
+
+        // The rows of a whole batch go in one write transaction instead of one per transfer
+        const bool batched = m_database_manager.beginTransaction();
+
         CURLMsg* msg;
         int msgs_left;
         while ((msg = curl_multi_info_read(multi_handle, &msgs_left))) {
@@ -182,19 +495,44 @@ auto DownloadManager::download(std::vector<DownloadParameter>& download_paramete
             curl_easy_getinfo(eh, CURLINFO_EFFECTIVE_URL, &url);
             curl_easy_getinfo(eh, CURLINFO_PRIVATE, &private_data);
 
+            std::erase(running, private_data);
+
+            // Back to the pool once the result has been handled
+            const auto private_data_owner = std::unique_ptr<transfer_private_data, TransferRelease>(private_data, TransferRelease{this});
+
             auto download_index = private_data->download_index;
+            completed.push_back(download_index);
+
+            const auto& parameter = *result[download_index].parameter;
+            const auto host = RateGovernor::hostOf(parameter.uri);
+
+            // Body bytes as they came over the wire, before any content decoding
+            curl_off_t received = 0;
+            curl_easy_getinfo(eh, CURLINFO_SIZE_DOWNLOAD_T, &received);
+
+            m_governor->release(host, static_cast<uint64_t>(received));
 
             // Free all memories
-            if (private_data->file->is_open())
+            bool written = true;
+            if (private_data->file)
             {
-                private_data->file->close();
+                written = file_sink->close(private_data->file);
+                private_data->file = nullptr;
             }
-            if (private_data->list) {
-                curl_slist_free_all(private_data->list);
+
+            // Partial bodies are only kept for new content
+            const auto discard_partial_file = [private_data]
+            {
+                ::unlink(private_data->file_path.c_str());
+            };
+
+            // The URI itself unless a redirect was followed
+            if (parameter.uri != url)
+            {
+                result[download_index].effective_url = url;
             }
-            delete private_data;
 
-            result[download_index].effective_url = url;
+            m_connection_cache->record(eh);
 
             // Check if any curl error
             if (CURLcode data_result = msg->data.result; data_result != CURLE_OK)
@@ -205,9 +543,16 @@ auto DownloadManager::download(std::vector<DownloadParameter>& download_paramete
                 result[download_index].success = false;
                 result[download_index].error = curl_easy_strerror(data_result);
 
+                discard_partial_file();
+
                 continue;
             }
 
+            received_bytes += static_cast<uint64_t>(received);
+            written_bytes += private_data->hasher.size();
+            m_bytes_received.fetch_add(static_cast<uint64_t>(received), std::memory_order_relaxed);
+            m_bytes_written.fetch_add(private_data->hasher.size(), std::memory_order_relaxed);
+
             long httpCode = 0;
             curl_easy_getinfo(eh, CURLINFO_RESPONSE_CODE, &httpCode);
 
@@ -216,11 +561,22 @@ auto DownloadManager::download(std::vector<DownloadParameter>& download_paramete
                 // TODO : Get headers ?
                 CURL_ERROR("Download error for {}, status code {}", url, httpCode);
 
+                // The server asks to slow down: hold the host back for the rest of the run
+                if (httpCode == 429 || httpCode == 503)
+                {
+                    curl_off_t retry_after = 0;
+                    curl_easy_getinfo(eh, CURLINFO_RETRY_AFTER, &retry_after);
+
+                    // Capped, a run should not sleep for hours on one answer
+                    const auto delay = std::chrono::seconds(std::clamp<curl_off_t>(retry_after, 1, 600));
+                    CURL_WARN("{} answered {}, no request to it for {} s", host, httpCode, delay.count());
+                    m_governor->pause(host, delay);
+                }
+
                 result[download_index].success = false;
                 result[download_index].error = fmt::format("HTTP status {}", httpCode);
 
-                // cleanup
-                curl_easy_cleanup(eh);
+                discard_partial_file();
 
                 continue;
             }
@@ -238,30 +594,122 @@ auto DownloadManager::download(std::vector<DownloadParameter>& download_paramete
                     CURL_INFO("No change for {}", url);
                 }
 
+                if (!m_database_manager.markValidated(result[download_index].url(), parameter.parent_uri, parameter.parent_etag, unixTime()))
+                {
+                    CURL_ERROR("Erreur markValidated: {}", url);
+                }
+
                 result[download_index].success = true;
 
-                // cleanup
-                curl_easy_cleanup(eh);
+                discard_partial_file();
 
                 continue;
             }
 
             if (httpCode == 200) {
-                std::string etag;
-                std::string last_update;
+                const auto& destination = parameter.destination_file_path;
+
+                // Reuses the capacity of the row of the previous transfer
+                auto& row = private_data->row;
+                row.uri.assign(url);
+                private_data->hasher.hexDigest(row.digest);
+                row.size = private_data->hasher.size();
+
+                row.etag.clear();
+                row.last_update.clear();
 
                 curl_header *etagHeader = nullptr;
                 if (const CURLHcode result_code = curl_easy_header(eh, "etag", 0, CURLH_HEADER, -1, &etagHeader); result_code == CURLHE_OK)
                 {
-                    etag.append(etagHeader->value);
+                    row.etag.append(etagHeader->value);
                 }
                 curl_header *lastModifiedHeader = nullptr;
                 if (const CURLHcode result_code = curl_easy_header(eh, "last-modified", 0, CURLH_HEADER, -1, &lastModifiedHeader); result_code == CURLHE_OK)
                 {
-                    last_update.append(lastModifiedHeader->value);
+                    row.last_update.append(lastModifiedHeader->value);
+                }
+
+                // Empty bodies never reach WriteCallback
+                if (!private_data->hasher.size() && !fileExists(private_data->file_path))
+                {
+                    if (const int fd = ::open(private_data->file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644); fd >= 0)
+                    {
+                        ::close(fd);
+                    }
+                }
+
+                if (!written)
+                {
+                    result[download_index].success = false;
+                    result[download_index].error = fmt::format("Unable to write {}", private_data->file_path);
+
+                    discard_partial_file();
+
+                    continue;
+                }
+
+                if (private_data->packed)
+                {
+                    auto pack_entry = m_pack_archive->append(parameter.pack_group, private_data->file_path);
+                    if (!pack_entry.has_value())
+                    {
+                        result[download_index].success = false;
+                        result[download_index].error = fmt::format("Unable to append {} to pack {}", url, parameter.pack_group);
+
+                        discard_partial_file();
+
+                        continue;
+                    }
+
+                    pack_entry->uri = parameter.uri;
+                    pack_entry->etag = row.etag;
+
+                    if (!m_database_manager.upsertPackEntry(*pack_entry))
+                    {
+                        CURL_ERROR("Erreur upsertPackEntry: {}", url);
+                    }
                 }
+                else if (private_data->content_addressed)
+                {
+                    if (!m_object_store->store(private_data->file_path, row.digest) || !m_object_store->materialize(row.digest, destination))
+                    {
+                        result[download_index].success = false;
+                        result[download_index].error = fmt::format("Unable to store {} as {}", url, destination);
+
+                        discard_partial_file();
 
-                if (!m_database_manager.upsertUriMetadata({url, etag, last_update}))
+                        continue;
+                    }
+
+                    if (!m_database_manager.upsertBlob({parameter.uri, row.digest, row.size}))
+                    {
+                        CURL_ERROR("Erreur upsertBlob: {}", url);
+                    }
+                }
+                else if (::rename(private_data->file_path.c_str(), destination.c_str()) != 0)
+                {
+                    result[download_index].success = false;
+                    result[download_index].error = fmt::format("Unable to move {} to {}: {}", private_data->file_path, destination, std::strerror(errno));
+
+                    discard_partial_file();
+
+                    continue;
+                }
+
+                // Packed bodies have no file of their own to verify
+                if (private_data->packed)
+                {
+                    row.file_path.clear();
+                }
+                else
+                {
+                    row.file_path.assign(destination);
+                }
+                row.parent_uri.assign(parameter.parent_uri);
+                row.parent_etag.assign(parameter.parent_etag);
+                row.validated_at = unixTime();
+
+                if (!m_database_manager.upsertUriMetadata(row))
                 {
                     CURL_ERROR("Erreur upsertUriMetadata: {}", url);
                 }
@@ -276,26 +724,262 @@ auto DownloadManager::download(std::vector<DownloadParameter>& download_paramete
 
                 result[download_index].success = true;
                 result[download_index].has_changed = true;
+            }
+        }
 
-                // cleanup
-                curl_easy_cleanup(eh);
+        if (batched && !m_database_manager.commit())
+        {
+            CURL_ERROR("Unable to commit the metadata of {} transfers", completed.size());
+        }
+
+        m_active.fetch_sub(completed.size(), std::memory_order_relaxed);
+        m_transfers.fetch_add(completed.size(), std::memory_order_relaxed);
+
+        for (const auto download_index : completed)
+        {
+            if (!result[download_index].success)
+            {
+                m_failures.fetch_add(1, std::memory_order_relaxed);
             }
+
+            complete(download_index);
         }
     }
 
-    if (curl_multi_cleanup(multi_handle) != CURLM_OK)
+    const auto allocations_after = AllocationCounter::currentThread();
+
+    // Handles left in the multi handle by a failed poll, reported as not completed below
+    for (const auto private_data : running)
     {
-        CURL_ERROR("curl_multi_cleanup");
+        curl_multi_remove_handle(multi_handle, private_data->easy_handle);
+
+        // Admitted, so its slot and bytes go back to the governor like a completed one
+        curl_off_t received = 0;
+        curl_easy_getinfo(private_data->easy_handle, CURLINFO_SIZE_DOWNLOAD_T, &received);
+        m_governor->release(RateGovernor::hostOf(result[private_data->download_index].parameter->uri), static_cast<uint64_t>(received));
+
+        if (private_data->file)
+        {
+            (void)file_sink->close(private_data->file);
+            private_data->file = nullptr;
+        }
+        ::unlink(private_data->file_path.c_str());
+
+        releaseTransfer(private_data);
+    }
+    running.clear();
+
+    m_active.fetch_sub(batch_size, std::memory_order_relaxed);
+
+    // Never leave an overlapping call waiting on a transfer that did not report
+    for (const auto& [download_index, in_flight] : transfers)
+    {
+        if (!in_flight->done)
+        {
+            m_failures.fetch_add(1, std::memory_order_relaxed);
+            result[download_index].success = false;
+            result[download_index].error = "Transfer did not complete";
+            complete(download_index);
+        }
+    }
+
+    for (const auto& [download_index, in_flight] : awaited)
+    {
+        std::unique_lock lock(in_flight->mutex);
+        in_flight->condition.wait(lock, [&in_flight] { return in_flight->done; });
+
+        fanOut(in_flight->result, in_flight->source_path, result[download_index]);
+    }
+
+    // Pooled contexts and buffers: once warm, only libcurl allocates for a transfer
+    const auto allocations = allocations_after.allocations - allocations_before.allocations;
+    const auto curl_allocations = allocations_after.curl_allocations - allocations_before.curl_allocations;
+    CURL_INFO("{} transfers: {} bytes received, {} bytes written, {} allocations ({:.1f} per transfer), {} in libcurl",
+        transfers.size(), received_bytes, written_bytes, allocations,
+        transfers.empty() ? 0.0 : static_cast<double>(allocations) / static_cast<double>(transfers.size()), curl_allocations);
+
+    // A multi handle whose poll failed is not handed to another call
+    if (poll_failed)
+    {
+        curl_multi_cleanup(multi_handle);
+        m_multi_handles.fetch_sub(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        releaseMultiHandle(multi_handle);
+    }
+    releaseFileSink(file_sink);
+
+    if (owns_writer)
+    {
+        m_connection_cache->releaseWriter();
+    }
+
+    if (resolve)
+    {
+        curl_slist_free_all(resolve);
     }
 
     return result;
 }
 
+auto DownloadManager::acquireMultiHandle() const -> CURLM*
+{
+    {
+        const std::lock_guard lock(m_multi_handles_mutex);
+        if (!m_idle_multi_handles.empty())
+        {
+            const auto multi_handle = m_idle_multi_handles.back();
+            m_idle_multi_handles.pop_back();
+            return multi_handle;
+        }
+    }
+
+    const auto multi_handle = curl_multi_init();
+    if (!multi_handle)
+    {
+        CURL_ERROR("curl_multi_init");
+        return nullptr;
+    }
+
+    m_multi_handles.fetch_add(1, std::memory_order_relaxed);
+
+    // Configurer le multiplexing HTTP/2
+    curl_multi_setopt(multi_handle, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS, 1L);
+
+    return multi_handle;
+}
+
+auto DownloadManager::releaseMultiHandle(CURLM* multi_handle) const -> void
+{
+    if (!multi_handle)
+    {
+        return;
+    }
+
+    const std::lock_guard lock(m_multi_handles_mutex);
+    m_idle_multi_handles.push_back(multi_handle);
+}
+
+auto DownloadManager::acquireFileSink() const -> FileSink*
+{
+    const std::lock_guard lock(m_file_sinks_mutex);
+    if (!m_idle_file_sinks.empty())
+    {
+        const auto file_sink = m_idle_file_sinks.back();
+        m_idle_file_sinks.pop_back();
+        return file_sink;
+    }
+
+    m_file_sinks.push_back(FileSink::create(m_max_parallel));
+    return m_file_sinks.back().get();
+}
+
+auto DownloadManager::releaseFileSink(FileSink* file_sink) const -> void
+{
+    const std::lock_guard lock(m_file_sinks_mutex);
+    m_idle_file_sinks.push_back(file_sink);
+}
+
+auto DownloadManager::acquireTransfer() const -> transfer_private_data*
+{
+    transfer_private_data* transfer = nullptr;
+    {
+        const std::lock_guard lock(m_transfers_mutex);
+        if (!m_idle_transfers.empty())
+        {
+            transfer = m_idle_transfers.back();
+            m_idle_transfers.pop_back();
+        }
+    }
+
+    if (!transfer)
+    {
+        transfer = new transfer_private_data();
+    }
+
+    // Keeps the handle's buffers, drops the options of its previous transfer
+    if (transfer->easy_handle)
+    {
+        curl_easy_reset(transfer->easy_handle);
+        transfer->created = false;
+    }
+    else if (transfer->easy_handle = curl_easy_init(); !transfer->easy_handle)
+    {
+        CURL_ERROR("curl_easy_init");
+    }
+    else
+    {
+        m_easy_handles.fetch_add(1, std::memory_order_relaxed);
+        transfer->created = true;
+    }
+
+    transfer->file = nullptr;
+    transfer->content_addressed = false;
+    transfer->packed = false;
+    transfer->writer = false;
+    transfer->hasher.reset();
+
+    return transfer;
+}
+
+auto DownloadManager::releaseTransfer(transfer_private_data* transfer) const -> void
+{
+    // The writer saves the HSTS file on cleanup; its Alt-Svc entries are the ones every handle learns
+    if (transfer->writer && transfer->easy_handle)
+    {
+        curl_easy_cleanup(transfer->easy_handle);
+        transfer->easy_handle = nullptr;
+        m_easy_handles.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    const std::lock_guard lock(m_transfers_mutex);
+    m_idle_transfers.push_back(transfer);
+}
+
+auto DownloadManager::isPacked(const DownloadParameter& parameter) const -> bool
+{
+    return m_pack_archive && !parameter.pack_group.empty();
+}
+
+auto DownloadManager::fanOut(const DownloadResult& source, const std::string& source_path, DownloadResult& target) -> void
+{
+    target.effective_url = source.effective_url;
+    target.success = source.success;
+    target.error = source.error;
+    target.has_changed = source.has_changed;
+    target.created = source.created;
+
+    if (!source.success || source_path.empty() || source_path == target.parameter->destination_file_path)
+    {
+        return;
+    }
+
+    // A 304 still has to give a copy to a destination that was never written
+    const bool exists = std::filesystem::exists(target.parameter->destination_file_path);
+    if (!source.has_changed && exists)
+    {
+        return;
+    }
+
+    if (!ObjectStore::link(source_path, target.parameter->destination_file_path))
+    {
+        target.success = false;
+        target.error = fmt::format("Unable to link {} to {}", source_path, target.parameter->destination_file_path);
+        return;
+    }
+
+    target.has_changed = true;
+    target.created = !exists;
+}
+
 auto DownloadManager::initialize() -> void
 {
     if (!m_initialized)
     {
-        if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK)
+        // Counts libcurl's allocations next to ours
+        if (AllocationCounter::initializeCurl(CURL_GLOBAL_DEFAULT) != CURLE_OK)
         {
             CURL_ERROR("CURL global init error");
             return;
@@ -310,10 +994,78 @@ DownloadManager::DownloadManager(DatabaseManager& database_manager, const size_t
 {
     initialize();
 
+    m_connection_cache = std::make_unique<ConnectionCache>();
+    m_governor = std::make_unique<RateGovernor>();
+
     // m_multi_handle = curl_multi_init();
     // curl_multi_setopt(m_multi_handle, CURLMOPT_MAXCONNECTS, max_parallel);
 }
 
+DownloadManager::~DownloadManager()
+{
+    for (const auto transfer : m_idle_transfers)
+    {
+        if (transfer->easy_handle)
+        {
+            m_connection_cache->saveAltSvc(transfer->easy_handle);
+        }
+        delete transfer;
+    }
+
+    for (const auto multi_handle : m_idle_multi_handles)
+    {
+        if (curl_multi_cleanup(multi_handle) != CURLM_OK)
+        {
+            CURL_ERROR("curl_multi_cleanup");
+        }
+    }
+}
+
+auto DownloadManager::counters() const -> Counters
+{
+    Counters counters;
+    counters.transfers = m_transfers.load(std::memory_order_relaxed);
+    counters.failures = m_failures.load(std::memory_order_relaxed);
+    counters.bytes_received = m_bytes_received.load(std::memory_order_relaxed);
+    counters.bytes_written = m_bytes_written.load(std::memory_order_relaxed);
+    counters.queued = m_queued.load(std::memory_order_relaxed);
+    counters.active = m_active.load(std::memory_order_relaxed);
+    counters.easy_handles = m_easy_handles.load(std::memory_order_relaxed);
+    counters.multi_handles = m_multi_handles.load(std::memory_order_relaxed);
+
+    const std::lock_guard lock(m_file_sinks_mutex);
+    for (const auto& file_sink : m_file_sinks)
+    {
+        counters.write_queue += file_sink->queuedBuffers();
+    }
+    return counters;
+}
+
+auto DownloadManager::setCacheDirectory(const std::filesystem::path& directory) -> void
+{
+    m_connection_cache->load(directory);
+}
+
+auto DownloadManager::setPackArchive(PackArchive* pack_archive) -> void
+{
+    m_pack_archive = pack_archive;
+}
+
+auto DownloadManager::setRateLimits(const RateGovernor::Limits& limits) const -> void
+{
+    m_governor->setLimits(limits);
+}
+
+auto DownloadManager::rateLimits() const -> RateGovernor::Limits
+{
+    return m_governor->limits();
+}
+
+auto DownloadManager::setObjectStore(const ObjectStore* object_store) -> void
+{
+    m_object_store = object_store;
+}
+
 // DownloadManager::~DownloadManager()
 // {
 //     // if (m_multi_handle)
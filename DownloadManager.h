@@ -5,34 +5,156 @@
 #ifndef DOWNLOAD_MANAGER_H
 #define DOWNLOAD_MANAGER_H
 
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 #include <string>
+#include <curl/curl.h>
 
 #include "DatabaseManager.h"
+#include "RateGovernor.h"
+
+class ConnectionCache;
+class FileSink;
+class ObjectStore;
+class PackArchive;
+struct transfer_private_data;
 
 class DownloadManager {
     static bool m_initialized;
     DatabaseManager& m_database_manager;
     size_t m_max_parallel;
+    const ObjectStore* m_object_store{nullptr};
+    PackArchive* m_pack_archive{nullptr};
+    std::unique_ptr<ConnectionCache> m_connection_cache;
+    std::unique_ptr<RateGovernor> m_governor;
 public:
     explicit DownloadManager(DatabaseManager& database_manager, size_t max_parallel = 50);
+    ~DownloadManager();
+
+    // When set, bodies are deduplicated in the object store and destinations become links onto them
+    auto setObjectStore(const ObjectStore* object_store) -> void;
+    // Persists the DNS, TLS session, HSTS and Alt-Svc caches in directory
+    auto setCacheDirectory(const std::filesystem::path& directory) -> void;
+    // When set, parameters with a pack group are appended to that group's pack instead of their destination
+    auto setPackArchive(PackArchive* pack_archive) -> void;
+    // Requests/s and bytes/s of every download, applied from the next transfer admitted
+    auto setRateLimits(const RateGovernor::Limits& limits) const -> void;
+    [[nodiscard]] auto rateLimits() const -> RateGovernor::Limits;
+
+    // Totals since construction, then gauges of the transfers in progress
+    struct Counters {
+        uint64_t transfers = 0;
+        uint64_t failures = 0;
+        uint64_t bytes_received = 0;
+        uint64_t bytes_written = 0;
+        // Waiting for a slot in their multi handle, then in one
+        uint64_t queued = 0;
+        uint64_t active = 0;
+        // Easy handles alive, running or pooled, and multi handles
+        uint64_t easy_handles = 0;
+        uint64_t multi_handles = 0;
+        // Buffers waiting for the disk
+        uint64_t write_queue = 0;
+    };
+
+    // Relaxed reads and a short lock on the sinks, for a sampler running next to the transfers
+    [[nodiscard]] auto counters() const -> Counters;
+
+    enum class Encoding {
+        // No Accept-Encoding: bodies that do not compress, such as images
+        Identity,
+        // gzip, br or zstd, decoded in the write path
+        Compressed,
+        // gzip, stored as received for consumers that inflate while parsing
+        KeepCompressed
+    };
 
     struct DownloadParameter {
         std::string uri;
         std::string destination_file_path;
+        std::string pack_group;
+        Encoding encoding = Encoding::Identity;
+        // cards.json listing the image and its current ETag, recorded with the image
+        std::string parent_uri;
+        std::string parent_etag;
     };
 
     struct DownloadResult {
         DownloadParameter* parameter;
+        // Only set when the transfer was redirected
         std::string effective_url;
         bool success;
         std::string error;
         bool has_changed = false;
+        // Nothing was at the destination before the call
+        bool created = false;
+
+        // URL the body came from
+        [[nodiscard]] auto url() const -> const std::string& { return effective_url.empty() ? parameter->uri : effective_url; }
     };
 
+    // A URI is fetched once per call and once across overlapping calls, the
+    // other destinations asking for it get a link or copy of the body
     [[nodiscard]] auto download(std::vector<DownloadParameter>& download_parameters) const -> std::vector<DownloadResult>;
 private:
+    // Transfer started by a download() call, awaited by the overlapping ones
+    struct InFlight {
+        std::string key;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool done = false;
+        DownloadResult result{};
+        // Local copy of the body, empty when it went to a pack
+        std::string source_path;
+        // Overlapping calls waiting on it, guarded by m_in_flight_mutex
+        size_t waiters = 0;
+    };
+
+    // Multi handles between downloads, they keep their connections open
+    mutable std::mutex m_multi_handles_mutex;
+    mutable std::vector<CURLM*> m_idle_multi_handles;
+
+    // File sinks between downloads, one per download() in progress: a sink and
+    // its buffers are never shared by overlapping calls
+    mutable std::mutex m_file_sinks_mutex;
+    mutable std::vector<std::unique_ptr<FileSink>> m_file_sinks;
+    mutable std::vector<FileSink*> m_idle_file_sinks;
+
+    // Transfer contexts between downloads, sized by the peak of parallel transfers
+    mutable std::mutex m_transfers_mutex;
+    mutable std::vector<transfer_private_data*> m_idle_transfers;
+
+    mutable std::atomic<uint64_t> m_transfers{0};
+    mutable std::atomic<uint64_t> m_failures{0};
+    mutable std::atomic<uint64_t> m_bytes_received{0};
+    mutable std::atomic<uint64_t> m_bytes_written{0};
+    mutable std::atomic<uint64_t> m_queued{0};
+    mutable std::atomic<uint64_t> m_active{0};
+    mutable std::atomic<uint64_t> m_easy_handles{0};
+    mutable std::atomic<uint64_t> m_multi_handles{0};
+
+    mutable std::mutex m_in_flight_mutex;
+    mutable std::unordered_map<std::string, std::shared_ptr<InFlight>> m_in_flight;
+
     static auto initialize() -> void;
+    [[nodiscard]] auto acquireMultiHandle() const -> CURLM*;
+    auto releaseMultiHandle(CURLM* multi_handle) const -> void;
+    [[nodiscard]] auto acquireFileSink() const -> FileSink*;
+    auto releaseFileSink(FileSink* file_sink) const -> void;
+    [[nodiscard]] auto acquireTransfer() const -> transfer_private_data*;
+    auto releaseTransfer(transfer_private_data* transfer) const -> void;
+
+    struct TransferRelease {
+        const DownloadManager* download_manager;
+        auto operator()(transfer_private_data* transfer) const -> void { download_manager->releaseTransfer(transfer); }
+    };
+    [[nodiscard]] auto isPacked(const DownloadParameter& parameter) const -> bool;
+    static auto fanOut(const DownloadResult& source, const std::string& source_path, DownloadResult& target) -> void;
 };
 
 #endif //DOWNLOAD_MANAGER_H
@@ -0,0 +1,297 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "FileSink.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "IoUringFileSink.h"
+#include "Logs.h"
+#include "PwriteFileSink.h"
+
+FileSink::FileSink(const size_t max_buffers)
+    : m_max_buffers(std::max<size_t>(max_buffers, 1))
+{
+}
+
+FileSink::~FileSink() = default;
+
+auto FileSink::create(const size_t queue_depth) -> std::unique_ptr<FileSink>
+{
+#ifdef HAVE_LIBURING
+    if (auto sink = std::make_unique<IoUringFileSink>(queue_depth); sink->isReady())
+    {
+        APP_DEBUG("File sink: {}", sink->name());
+        return sink;
+    }
+
+    APP_WARN("io_uring unavailable, falling back to a pwrite thread pool");
+#endif
+
+    auto sink = std::make_unique<PwriteFileSink>(queue_depth);
+    APP_DEBUG("File sink: {}", sink->name());
+    return sink;
+}
+
+auto FileSink::open(const std::string& path, const uint64_t expected_size) -> File*
+{
+    const auto separator = path.find_last_of('/');
+    const auto directory = separator == std::string::npos ? std::string_view() : std::string_view(path).substr(0, separator);
+    if (!createParentDirectories(directory))
+    {
+        return nullptr;
+    }
+
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    // Removed since it was created, e.g. data/ wiped by a re-sync: create it again
+    if (fd < 0 && errno == ENOENT && !directory.empty())
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            if (const auto it = m_created_directories.find(directory); it != m_created_directories.end())
+            {
+                m_created_directories.erase(it);
+            }
+        }
+
+        if (createParentDirectories(directory))
+        {
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        }
+    }
+
+    if (fd < 0)
+    {
+        APP_ERROR("Unable to open {}: {}", path, std::strerror(errno));
+        return nullptr;
+    }
+
+    uint64_t preallocated = 0;
+#ifdef __linux__
+    // Content-Length is known: reserve the extents up front to avoid fragmentation
+    if (expected_size > 0 && fallocate(fd, 0, 0, static_cast<off_t>(expected_size)) == 0)
+    {
+        preallocated = expected_size;
+    }
+#else
+    (void)expected_size;
+#endif
+
+    File* file;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_free_files.empty())
+        {
+            m_files.push_back(std::make_unique<File>());
+            m_free_files.push_back(m_files.back().get());
+        }
+        file = m_free_files.back();
+        m_free_files.pop_back();
+
+        file->pending = 0;
+        file->failed = false;
+    }
+
+    file->fd = fd;
+    file->path = path;
+    file->offset = 0;
+    file->preallocated = preallocated;
+    file->buffer = nullptr;
+
+    return file;
+}
+
+auto FileSink::write(File* file, const void* data, size_t size) -> bool
+{
+    auto bytes = static_cast<const char*>(data);
+
+    while (size > 0)
+    {
+        if (!file->buffer)
+        {
+            file->buffer = acquireBuffer();
+        }
+
+        const size_t chunk = std::min(size, buffer_size - file->buffer->size);
+        std::memcpy(file->buffer->data.get() + file->buffer->size, bytes, chunk);
+
+        file->buffer->size += chunk;
+        bytes += chunk;
+        size -= chunk;
+
+        if (file->buffer->size == buffer_size)
+        {
+            flush(file);
+        }
+    }
+
+    std::lock_guard lock(m_mutex);
+    return !file->failed;
+}
+
+auto FileSink::close(File* file) -> bool
+{
+    if (file->buffer && file->buffer->size > 0)
+    {
+        flush(file);
+    }
+    else if (file->buffer)
+    {
+        completed(file->buffer, true);
+        file->buffer = nullptr;
+    }
+
+    wait(file);
+
+    bool success;
+    {
+        std::lock_guard lock(m_mutex);
+        success = !file->failed;
+    }
+
+    // The body may be shorter than announced (or compressed on the wire)
+    if (file->preallocated != 0 && file->preallocated != file->offset)
+    {
+        if (ftruncate(file->fd, static_cast<off_t>(file->offset)) != 0)
+        {
+            success = false;
+        }
+    }
+
+    if (::close(file->fd) != 0)
+    {
+        success = false;
+    }
+
+    if (!success)
+    {
+        APP_ERROR("Write error on {}", file->path);
+    }
+
+    file->fd = -1;
+
+    std::lock_guard lock(m_mutex);
+    m_free_files.push_back(file);
+
+    return success;
+}
+
+auto FileSink::wait(File* file) -> void
+{
+    std::unique_lock lock(m_mutex);
+    m_completion.wait(lock, [file] { return file->pending == 0; });
+}
+
+auto FileSink::progress() -> void
+{
+    std::unique_lock lock(m_mutex);
+    m_completion.wait(lock, [this] { return !m_free_buffers.empty(); });
+}
+
+auto FileSink::completed(Buffer* buffer, const bool success) -> void
+{
+    {
+        std::lock_guard lock(m_mutex);
+
+        if (buffer->file)
+        {
+            m_queued_buffers.fetch_sub(1, std::memory_order_relaxed);
+            buffer->file->pending--;
+            buffer->file->failed |= !success;
+        }
+
+        buffer->file = nullptr;
+        buffer->size = 0;
+        buffer->written = 0;
+
+        m_free_buffers.push_back(buffer);
+    }
+
+    m_completion.notify_all();
+}
+
+auto FileSink::pending(const File* file) -> size_t
+{
+    std::lock_guard lock(m_mutex);
+    return file->pending;
+}
+
+auto FileSink::flush(File* file) -> void
+{
+    Buffer* buffer = file->buffer;
+    file->buffer = nullptr;
+
+    buffer->file = file;
+    buffer->offset = file->offset;
+    buffer->written = 0;
+
+    file->offset += buffer->size;
+
+    {
+        std::lock_guard lock(m_mutex);
+        file->pending++;
+    }
+
+    m_queued_buffers.fetch_add(1, std::memory_order_relaxed);
+    submit(buffer);
+}
+
+auto FileSink::acquireBuffer() -> Buffer*
+{
+    std::unique_lock lock(m_mutex);
+
+    if (m_free_buffers.empty() && m_buffers.size() < m_max_buffers)
+    {
+        m_buffers.push_back(std::make_unique<Buffer>());
+        return m_buffers.back().get();
+    }
+
+    // Every buffer is in flight: the disk is the bottleneck, apply back pressure
+    while (m_free_buffers.empty())
+    {
+        lock.unlock();
+        progress();
+        lock.lock();
+    }
+
+    Buffer* buffer = m_free_buffers.back();
+    m_free_buffers.pop_back();
+
+    return buffer;
+}
+
+auto FileSink::createParentDirectories(const std::string_view directory) -> bool
+{
+    if (directory.empty())
+    {
+        return true;
+    }
+
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_created_directories.contains(directory))
+        {
+            return true;
+        }
+    }
+
+    const auto path = std::filesystem::path(directory);
+
+    std::error_code ec;
+    std::filesystem::create_directories(path, ec);
+    if (ec)
+    {
+        APP_ERROR("Unable to create {}: {}", path.string(), ec.message());
+        return false;
+    }
+
+    std::lock_guard lock(m_mutex);
+    m_created_directories.emplace(directory);
+
+    return true;
+}
@@ -0,0 +1,109 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef FILE_SINK_H
+#define FILE_SINK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Asynchronous file writer used by DownloadManager: write() only copies the
+// body into a staging buffer, full buffers are handed to the implementation
+// so that disk latency never stalls the curl event loop. A sink serves one
+// download() call at a time, overlapping calls each get their own.
+class FileSink {
+public:
+    static constexpr size_t buffer_size = 256 * 1024;
+    // Page aligned, so the kernel copies whole pages into the page cache
+    static constexpr size_t buffer_alignment = 4096;
+
+    struct File;
+
+    struct AlignedDelete {
+        auto operator()(char* data) const -> void { operator delete[](data, std::align_val_t{buffer_alignment}); }
+    };
+
+    struct Buffer {
+        std::unique_ptr<char[], AlignedDelete> data{new (std::align_val_t{buffer_alignment}) char[buffer_size]};
+        size_t size = 0;
+
+        // In-flight bookkeeping, set when the buffer is submitted
+        File* file = nullptr;
+        uint64_t offset = 0;
+        size_t written = 0;
+    };
+
+    struct File {
+        int fd = -1;
+        std::string path;
+        uint64_t offset = 0;
+        uint64_t preallocated = 0;
+        Buffer* buffer = nullptr;
+
+        // Guarded by the sink mutex
+        size_t pending = 0;
+        bool failed = false;
+    };
+
+    explicit FileSink(size_t max_buffers);
+    virtual ~FileSink();
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    [[nodiscard]] auto open(const std::string& path, uint64_t expected_size) -> File*;
+    [[nodiscard]] auto write(File* file, const void* data, size_t size) -> bool;
+    [[nodiscard]] auto close(File* file) -> bool;
+
+    [[nodiscard]] virtual auto name() const -> const char* = 0;
+
+    // Buffers handed to the implementation and not written yet
+    [[nodiscard]] auto queuedBuffers() const -> size_t { return m_queued_buffers.load(std::memory_order_relaxed); }
+
+    // io_uring when available at build and run time, pwrite thread pool otherwise
+    [[nodiscard]] static auto create(size_t queue_depth) -> std::unique_ptr<FileSink>;
+
+protected:
+    virtual auto submit(Buffer* buffer) -> void = 0;
+    virtual auto wait(File* file) -> void;
+    // Blocks until a submission completes, default waits for another thread to complete it
+    virtual auto progress() -> void;
+
+    auto completed(Buffer* buffer, bool success) -> void;
+    [[nodiscard]] auto pending(const File* file) -> size_t;
+
+private:
+    auto flush(File* file) -> void;
+    auto acquireBuffer() -> Buffer*;
+    auto createParentDirectories(std::string_view directory) -> bool;
+
+    std::mutex m_mutex;
+    std::condition_variable m_completion;
+
+    size_t m_max_buffers;
+    std::atomic<size_t> m_queued_buffers{0};
+    std::vector<std::unique_ptr<Buffer>> m_buffers;
+    std::vector<Buffer*> m_free_buffers;
+
+    std::vector<std::unique_ptr<File>> m_files;
+    std::vector<File*> m_free_files;
+
+    // Looked up by string_view, opening a file in a known directory allocates nothing
+    struct DirectoryHash {
+        using is_transparent = void;
+        auto operator()(const std::string_view directory) const -> size_t { return std::hash<std::string_view>{}(directory); }
+    };
+    std::unordered_set<std::string, DirectoryHash, std::equal_to<>> m_created_directories;
+};
+
+#endif //FILE_SINK_H
@@ -0,0 +1,189 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "GarbageCollector.h"
+
+#include <algorithm>
+#include <span>
+#include <fmt/format.h>
+
+#include "Logs.h"
+
+GarbageCollector::GarbageCollector(const DatabaseManager& database_manager, const ObjectStore* object_store, std::filesystem::path quarantine, const size_t batch_size)
+    : m_database_manager(database_manager)
+    , m_object_store(object_store)
+    , m_quarantine(std::move(quarantine))
+    , m_batch_size(std::max<size_t>(batch_size, 1))
+{
+}
+
+auto GarbageCollector::findOrphans(const std::string& parent_uri, const Mark& mark) const -> std::vector<Orphan>
+{
+    std::vector<Orphan> orphans;
+
+    for (auto& row : m_database_manager.listUriMetadataByParent(parent_uri))
+    {
+        const bool planned_path = mark.paths.contains(row.file_path);
+
+        if (!mark.uris.contains(row.uri))
+        {
+            if (planned_path)
+            {
+                row.file_path.clear();
+            }
+
+            orphans.push_back({std::move(row), false});
+        }
+        else if (!row.file_path.empty() && !planned_path)
+        {
+            orphans.push_back({std::move(row), true});
+        }
+    }
+
+    return orphans;
+}
+
+auto GarbageCollector::sweep(const std::vector<Orphan>& orphans, ChangeFeed* change_feed) const -> size_t
+{
+    size_t swept = 0;
+    size_t kept = 0;
+
+    for (size_t first = 0; first < orphans.size(); first += m_batch_size)
+    {
+        const auto batch = std::span(orphans).subspan(first, std::min(m_batch_size, orphans.size() - first));
+
+        // Files first: a run stopped before the commit finds the rows again
+        std::vector<const DatabaseManager::UriMetadata*> discarded;
+        discarded.reserve(batch.size());
+
+        for (const auto& [row, file_only] : batch)
+        {
+            if (file_only)
+            {
+                if (const auto current = m_database_manager.getUriMetadata(row.uri); !current.has_value() || current->file_path == row.file_path || !discard(row.file_path))
+                {
+                    kept++;
+                    continue;
+                }
+
+                if (change_feed)
+                {
+                    change_feed->record(ChangeFeed::Action::Removed, ChangeFeed::Kind::Image, row.uri, row.file_path, row.digest, row.size);
+                }
+
+                swept++;
+                continue;
+            }
+
+            if (!row.file_path.empty() && !discard(row.file_path))
+            {
+                kept++;
+                continue;
+            }
+
+            discarded.push_back(&row);
+        }
+
+        if (discarded.empty())
+        {
+            continue;
+        }
+
+        if (!m_database_manager.beginTransaction())
+        {
+            return swept;
+        }
+
+        std::vector<std::filesystem::path> objects;
+        bool deleted = true;
+
+        for (const auto* orphan : discarded)
+        {
+            // Rows dropped earlier in the transaction no longer count as users of the object
+            if (m_object_store)
+            {
+                if (const auto blob = m_database_manager.getBlob(orphan->uri); blob.has_value() && !m_database_manager.isBlobShared(blob->digest, orphan->uri))
+                {
+                    objects.push_back(m_object_store->objectPath(blob->digest));
+                }
+            }
+
+            if (!m_database_manager.deleteUriMetadata(orphan->uri))
+            {
+                deleted = false;
+                break;
+            }
+        }
+
+        // Nothing of a failed batch is applied, the next run finds its rows again
+        if (!deleted || !m_database_manager.commit())
+        {
+            m_database_manager.rollback();
+            APP_ERROR("Garbage collection stopped: unable to delete a batch of {} rows", discarded.size());
+            return swept;
+        }
+
+        for (const auto* orphan : discarded)
+        {
+            // A packed image has no file to report, the catalog reported it is gone
+            if (change_feed && !orphan->file_path.empty())
+            {
+                change_feed->record(ChangeFeed::Action::Removed, ChangeFeed::Kind::Image, orphan->uri, orphan->file_path, orphan->digest, orphan->size);
+            }
+        }
+        swept += discarded.size();
+
+        // The bytes of packed orphans stay in their pack until compact
+        for (const auto& object : objects)
+        {
+            if (!discard(object))
+            {
+                APP_WARN("Unable to discard {}", object.string());
+            }
+        }
+    }
+
+    APP_INFO("Garbage collection: {} orphans swept, {} kept{}", swept, kept, m_quarantine.empty() ? "" : fmt::format(" (files moved to {})", m_quarantine.string()));
+
+    return swept;
+}
+
+auto GarbageCollector::discard(const std::filesystem::path& path) const -> bool
+{
+    std::error_code ec;
+
+    if (m_quarantine.empty())
+    {
+        std::filesystem::remove(path, ec);
+        if (ec)
+        {
+            APP_WARN("Unable to remove {}: {}", path.string(), ec.message());
+            return false;
+        }
+        return true;
+    }
+
+    if (!std::filesystem::exists(path, ec))
+    {
+        return true;
+    }
+
+    const auto destination = m_quarantine / path.relative_path();
+    std::filesystem::create_directories(destination.parent_path(), ec);
+
+    // A quarantine on another file system gets a copy
+    std::filesystem::rename(path, destination, ec);
+    if (ec && std::filesystem::copy_file(path, destination, std::filesystem::copy_options::overwrite_existing, ec))
+    {
+        std::filesystem::remove(path, ec);
+    }
+
+    if (ec)
+    {
+        APP_WARN("Unable to move {} to {}: {}", path.string(), destination.string(), ec.message());
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,59 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef GARBAGE_COLLECTOR_H
+#define GARBAGE_COLLECTOR_H
+
+#include <filesystem>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "ChangeFeed.h"
+#include "DatabaseManager.h"
+#include "ObjectStore.h"
+
+// Mark-and-sweep of the images a sync no longer plans. The mark is the plan of
+// a set whose cards.json was parsed again, the sweep candidates are the
+// uri_metadata rows recorded under that cards.json (parent_uri is indexed), so
+// finding the orphans costs one lookup per planned set instead of a walk of data/.
+class GarbageCollector {
+public:
+    // Image URIs and destinations planned for a set, requested or not
+    struct Mark {
+        std::unordered_set<std::string> uris;
+        std::unordered_set<std::string> paths;
+    };
+
+    struct Orphan {
+        DatabaseManager::UriMetadata row;
+        // The URI is still planned, under another destination (the card was renamed): only its previous file goes
+        bool file_only = false;
+    };
+
+private:
+    const DatabaseManager& m_database_manager;
+    const ObjectStore* m_object_store;
+    // Orphaned files are moved there, under their relative path, instead of being deleted
+    std::filesystem::path m_quarantine;
+    size_t m_batch_size;
+
+public:
+    GarbageCollector(const DatabaseManager& database_manager, const ObjectStore* object_store, std::filesystem::path quarantine = {}, size_t batch_size = 256);
+
+    // Rows of parent_uri the mark does not have, and files of marked rows that are
+    // not planned destinations. A file that is a planned destination is never an orphan.
+    [[nodiscard]] auto findOrphans(const std::string& parent_uri, const Mark& mark) const -> std::vector<Orphan>;
+
+    // Discards the files, then drops the rows, m_batch_size rows per transaction.
+    // Objects of the content-addressed store go once no other URI uses them.
+    // A file only orphan is kept while its row still points at it (its new
+    // destination failed to download). Returns the number of orphans swept.
+    auto sweep(const std::vector<Orphan>& orphans, ChangeFeed* change_feed = nullptr) const -> size_t;
+
+private:
+    [[nodiscard]] auto discard(const std::filesystem::path& path) const -> bool;
+};
+
+#endif //GARBAGE_COLLECTOR_H
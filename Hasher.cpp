@@ -0,0 +1,96 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "Hasher.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+Hasher::Hasher()
+    : m_state(XXH3_createState())
+{
+    reset();
+}
+
+Hasher::~Hasher()
+{
+    XXH3_freeState(m_state);
+}
+
+auto Hasher::reset() -> void
+{
+    XXH3_128bits_reset(m_state);
+    m_size = 0;
+}
+
+auto Hasher::update(const void* data, const size_t size) -> void
+{
+    XXH3_128bits_update(m_state, data, size);
+    m_size += size;
+}
+
+auto Hasher::hexDigest() const -> std::string
+{
+    std::string digest;
+    hexDigest(digest);
+
+    return digest;
+}
+
+auto Hasher::hexDigest(std::string& digest) const -> void
+{
+    static constexpr char hex[] = "0123456789abcdef";
+
+    XXH128_canonical_t canonical;
+    XXH128_canonicalFromHash(&canonical, XXH3_128bits_digest(m_state));
+
+    digest.resize(sizeof(canonical.digest) * 2);
+    for (size_t i = 0; i < sizeof(canonical.digest); i++)
+    {
+        digest[i * 2] = hex[canonical.digest[i] >> 4];
+        digest[i * 2 + 1] = hex[canonical.digest[i] & 0x0F];
+    }
+}
+
+auto Hasher::fileDigest(const std::string& path, uint64_t& size) -> std::optional<std::string>
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return std::nullopt;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    Hasher hasher;
+    size = static_cast<uint64_t>(st.st_size);
+
+    if (size > 0)
+    {
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            ::close(fd);
+            return std::nullopt;
+        }
+
+        madvise(data, size, MADV_SEQUENTIAL);
+        hasher.update(data, size);
+        munmap(data, size);
+    }
+
+    ::close(fd);
+
+    return hasher.hexDigest();
+}
@@ -0,0 +1,38 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef HASHER_H
+#define HASHER_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+struct XXH3_state_s;
+
+// Streaming XXH3-128 hash, fed chunk by chunk as the body arrives.
+class Hasher {
+    XXH3_state_s* m_state{nullptr};
+    uint64_t m_size{0};
+
+public:
+    Hasher();
+    ~Hasher();
+
+    Hasher(const Hasher&) = delete;
+    Hasher& operator=(const Hasher&) = delete;
+
+    auto reset() -> void;
+    auto update(const void* data, size_t size) -> void;
+
+    [[nodiscard]] auto size() const -> uint64_t { return m_size; }
+    [[nodiscard]] auto hexDigest() const -> std::string;
+    // Same digest written into digest, reusing its capacity
+    auto hexDigest(std::string& digest) const -> void;
+
+    // Hash a whole file through a read-only mapping
+    [[nodiscard]] static auto fileDigest(const std::string& path, uint64_t& size) -> std::optional<std::string>;
+};
+
+#endif //HASHER_H
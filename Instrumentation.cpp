@@ -0,0 +1,218 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "AllocationCounter.h"
+#include "Logs.h"
+
+namespace {
+    auto unixTimeMs() -> int64_t
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // Resident pages are the second field of /proc/self/statm
+    auto residentKiB() -> uint64_t
+    {
+        FILE* statm = std::fopen("/proc/self/statm", "r");
+        if (!statm)
+        {
+            return 0;
+        }
+
+        uint64_t size = 0;
+        uint64_t resident = 0;
+        const int read = std::fscanf(statm, "%" SCNu64 " %" SCNu64, &size, &resident);
+        std::fclose(statm);
+
+        return read == 2 ? resident * static_cast<uint64_t>(::sysconf(_SC_PAGESIZE)) / 1024 : 0;
+    }
+
+    auto peakResidentKiB() -> uint64_t
+    {
+        rusage usage{};
+        return ::getrusage(RUSAGE_SELF, &usage) == 0 ? static_cast<uint64_t>(usage.ru_maxrss) : 0;
+    }
+
+    // Entries of /proc/self/fd, without the descriptor reading it
+    auto openDescriptors() -> uint64_t
+    {
+        DIR* directory = ::opendir("/proc/self/fd");
+        if (!directory)
+        {
+            return 0;
+        }
+
+        uint64_t count = 0;
+        while (const dirent* entry = ::readdir(directory))
+        {
+            if (entry->d_name[0] != '.')
+            {
+                count++;
+            }
+        }
+        ::closedir(directory);
+
+        return count > 0 ? count - 1 : 0;
+    }
+}
+
+Instrumentation::Instrumentation(const Shard& shard, const std::chrono::milliseconds interval, const DownloadManager& download_manager, const DatabaseManager& database_manager, const ThreadPool* thread_pool)
+    : m_path(shard.metricsPath())
+    , m_interval(interval)
+    , m_download_manager(download_manager)
+    , m_database_manager(database_manager)
+    , m_thread_pool(thread_pool)
+{
+}
+
+Instrumentation::~Instrumentation()
+{
+    stop();
+}
+
+auto Instrumentation::start() -> bool
+{
+    if (const auto parent = std::filesystem::path(m_path).parent_path(); !parent.empty())
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(parent, ec);
+    }
+
+    m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_fd < 0)
+    {
+        APP_ERROR("Unable to open {}: {}", m_path, std::strerror(errno));
+        return false;
+    }
+
+    record();
+
+    m_stopping = false;
+    m_thread = std::thread(&Instrumentation::run, this);
+
+    APP_INFO("Sampling resources every {} ms into {}", m_interval.count(), m_path);
+
+    return true;
+}
+
+auto Instrumentation::stop() -> void
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+
+    {
+        const std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+
+    record();
+
+    const auto last = latest();
+    APP_INFO("Resources: {} KiB resident ({} KiB peak), {} open files, {} live allocations, {} curl handles",
+        last.rss_kib, last.peak_rss_kib, last.open_fds, last.live_allocations, last.downloads.easy_handles);
+
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+auto Instrumentation::sample() const -> Sample
+{
+    const auto allocations = AllocationCounter::process();
+
+    Sample sample;
+    sample.time = unixTimeMs();
+    sample.rss_kib = residentKiB();
+    // The kernel updates the peak lazily, it can lag behind the resident size
+    sample.peak_rss_kib = std::max(peakResidentKiB(), sample.rss_kib);
+    sample.open_fds = openDescriptors();
+    sample.allocations = allocations.allocations;
+    sample.curl_allocations = allocations.curl_allocations;
+    sample.live_allocations = AllocationCounter::live();
+    sample.downloads = m_download_manager.counters();
+    sample.sqlite_connections = m_database_manager.connectionCount();
+    sample.sqlite_pending_rows = m_database_manager.pendingRows();
+    sample.sqlite_commits = m_database_manager.commits();
+    sample.planning_queue = m_thread_pool ? m_thread_pool->queued() : 0;
+    return sample;
+}
+
+auto Instrumentation::latest() const -> Sample
+{
+    const std::lock_guard lock(m_latest_mutex);
+    return m_latest;
+}
+
+auto Instrumentation::write(rapidjson::Writer<rapidjson::StringBuffer>& writer, const Sample& sample) -> void
+{
+    writer.StartObject();
+    writer.Key("time"); writer.Int64(sample.time);
+    writer.Key("rssKiB"); writer.Uint64(sample.rss_kib);
+    writer.Key("peakRssKiB"); writer.Uint64(sample.peak_rss_kib);
+    writer.Key("openFds"); writer.Uint64(sample.open_fds);
+    writer.Key("allocations"); writer.Uint64(sample.allocations);
+    writer.Key("curlAllocations"); writer.Uint64(sample.curl_allocations);
+    writer.Key("liveAllocations"); writer.Int64(sample.live_allocations);
+    writer.Key("transfers"); writer.Uint64(sample.downloads.transfers);
+    writer.Key("failures"); writer.Uint64(sample.downloads.failures);
+    writer.Key("bytesReceived"); writer.Uint64(sample.downloads.bytes_received);
+    writer.Key("bytesWritten"); writer.Uint64(sample.downloads.bytes_written);
+    writer.Key("queuedTransfers"); writer.Uint64(sample.downloads.queued);
+    writer.Key("activeTransfers"); writer.Uint64(sample.downloads.active);
+    writer.Key("curlEasyHandles"); writer.Uint64(sample.downloads.easy_handles);
+    writer.Key("curlMultiHandles"); writer.Uint64(sample.downloads.multi_handles);
+    writer.Key("writeQueue"); writer.Uint64(sample.downloads.write_queue);
+    writer.Key("sqliteConnections"); writer.Uint64(sample.sqlite_connections);
+    writer.Key("sqlitePendingRows"); writer.Uint64(sample.sqlite_pending_rows);
+    writer.Key("sqliteCommits"); writer.Uint64(sample.sqlite_commits);
+    writer.Key("planningQueue"); writer.Uint64(sample.planning_queue);
+    writer.EndObject();
+}
+
+auto Instrumentation::run() -> void
+{
+    std::unique_lock lock(m_mutex);
+
+    while (!m_condition.wait_for(lock, m_interval, [this] { return m_stopping; }))
+    {
+        lock.unlock();
+        record();
+        lock.lock();
+    }
+}
+
+auto Instrumentation::record() -> void
+{
+    const auto current = sample();
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    write(writer, current);
+    buffer.Put('\n');
+
+    // One line per write(), O_APPEND keeps the lines of a sample whole
+    if (const ssize_t written = ::write(m_fd, buffer.GetString(), buffer.GetSize()); written != static_cast<ssize_t>(buffer.GetSize()))
+    {
+        APP_WARN("Unable to append to {}: {}", m_path, written < 0 ? std::strerror(errno) : "short write");
+    }
+
+    const std::lock_guard lock(m_latest_mutex);
+    m_latest = current;
+}
@@ -0,0 +1,87 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+#include "DatabaseManager.h"
+#include "DownloadManager.h"
+#include "Shard.h"
+#include "ThreadPool.h"
+
+// Resources of a long run, sampled at a fixed interval from a thread of its
+// own and appended to a time series next to the change feed, one NDJSON line
+// per sample. Every gauge is a relaxed read or a /proc lookup, so sampling
+// never waits for the transfers or the database.
+class Instrumentation {
+public:
+    struct Sample {
+        // Unix time in milliseconds
+        int64_t time = 0;
+        uint64_t rss_kib = 0;
+        uint64_t peak_rss_kib = 0;
+        uint64_t open_fds = 0;
+        // Heap allocations since the start of the process, and not freed yet
+        uint64_t allocations = 0;
+        uint64_t curl_allocations = 0;
+        int64_t live_allocations = 0;
+        DownloadManager::Counters downloads;
+        uint64_t sqlite_connections = 0;
+        uint64_t sqlite_pending_rows = 0;
+        uint64_t sqlite_commits = 0;
+        // Tasks of the planning pool not started yet
+        uint64_t planning_queue = 0;
+    };
+
+private:
+    std::string m_path;
+    std::chrono::milliseconds m_interval;
+    const DownloadManager& m_download_manager;
+    const DatabaseManager& m_database_manager;
+    const ThreadPool* m_thread_pool;
+    int m_fd{-1};
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping{false};
+    std::thread m_thread;
+
+    mutable std::mutex m_latest_mutex;
+    Sample m_latest;
+
+public:
+    // Written to the metrics file of the shard
+    Instrumentation(const Shard& shard, std::chrono::milliseconds interval, const DownloadManager& download_manager, const DatabaseManager& database_manager, const ThreadPool* thread_pool = nullptr);
+    ~Instrumentation();
+
+    Instrumentation(const Instrumentation&) = delete;
+    Instrumentation& operator=(const Instrumentation&) = delete;
+
+    // Opens the time series and takes the first sample
+    [[nodiscard]] auto start() -> bool;
+    // Takes a last sample, the end of the run is in the series
+    auto stop() -> void;
+
+    // Now, without writing it
+    [[nodiscard]] auto sample() const -> Sample;
+    // Last sample written, for the daemon status
+    [[nodiscard]] auto latest() const -> Sample;
+
+    static auto write(rapidjson::Writer<rapidjson::StringBuffer>& writer, const Sample& sample) -> void;
+
+private:
+    auto run() -> void;
+    auto record() -> void;
+};
+
+#endif //INSTRUMENTATION_H
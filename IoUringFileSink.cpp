@@ -0,0 +1,142 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "IoUringFileSink.h"
+
+#ifdef HAVE_LIBURING
+
+#include <cstring>
+
+#include "Logs.h"
+
+IoUringFileSink::IoUringFileSink(const size_t queue_depth)
+    : FileSink(queue_depth * 2), m_queue_depth(static_cast<unsigned>(std::max<size_t>(queue_depth, 8)))
+{
+    if (const int rc = io_uring_queue_init(m_queue_depth, &m_ring, 0); rc < 0)
+    {
+        APP_DEBUG("io_uring_queue_init: {}", std::strerror(-rc));
+        return;
+    }
+
+    m_ready = true;
+}
+
+IoUringFileSink::~IoUringFileSink()
+{
+    if (!m_ready)
+    {
+        return;
+    }
+
+    while (m_in_flight > 0)
+    {
+        reap(true);
+    }
+
+    io_uring_queue_exit(&m_ring);
+}
+
+auto IoUringFileSink::submit(Buffer* buffer) -> void
+{
+    // Keep the completion queue from overflowing
+    while (m_in_flight >= m_queue_depth)
+    {
+        reap(true);
+    }
+
+    queue(buffer);
+
+    // Submit in batches, one io_uring_enter for several writes
+    if (m_unsubmitted >= m_queue_depth / 4)
+    {
+        io_uring_submit(&m_ring);
+        m_unsubmitted = 0;
+    }
+
+    reap(false);
+}
+
+auto IoUringFileSink::wait(File* file) -> void
+{
+    while (pending(file) > 0)
+    {
+        reap(true);
+    }
+}
+
+auto IoUringFileSink::progress() -> void
+{
+    if (m_in_flight > 0)
+    {
+        reap(true);
+    }
+}
+
+auto IoUringFileSink::queue(Buffer* buffer) -> void
+{
+    io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+    while (!sqe)
+    {
+        io_uring_submit(&m_ring);
+        m_unsubmitted = 0;
+        sqe = io_uring_get_sqe(&m_ring);
+    }
+
+    io_uring_prep_write(sqe, buffer->file->fd,
+        buffer->data.get() + buffer->written,
+        static_cast<unsigned>(buffer->size - buffer->written),
+        buffer->offset + buffer->written);
+    io_uring_sqe_set_data(sqe, buffer);
+
+    m_unsubmitted++;
+    m_in_flight++;
+}
+
+auto IoUringFileSink::reap(const bool block) -> void
+{
+    if (m_unsubmitted > 0)
+    {
+        io_uring_submit(&m_ring);
+        m_unsubmitted = 0;
+    }
+
+    io_uring_cqe* cqe = nullptr;
+    if (block)
+    {
+        if (io_uring_wait_cqe(&m_ring, &cqe) < 0)
+        {
+            return;
+        }
+    }
+    else if (io_uring_peek_cqe(&m_ring, &cqe) != 0)
+    {
+        return;
+    }
+
+    do
+    {
+        auto buffer = static_cast<Buffer*>(io_uring_cqe_get_data(cqe));
+        const int res = cqe->res;
+
+        io_uring_cqe_seen(&m_ring, cqe);
+        m_in_flight--;
+
+        if (res > 0)
+        {
+            buffer->written += static_cast<size_t>(res);
+        }
+
+        if (res > 0 && buffer->written < buffer->size)
+        {
+            // Short write, queue the remainder
+            queue(buffer);
+            continue;
+        }
+
+        completed(buffer, res >= 0 && buffer->written == buffer->size);
+    }
+    while (io_uring_peek_cqe(&m_ring, &cqe) == 0);
+}
+
+#endif
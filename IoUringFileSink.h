@@ -0,0 +1,42 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef IO_URING_FILE_SINK_H
+#define IO_URING_FILE_SINK_H
+
+#ifdef HAVE_LIBURING
+
+#include <liburing.h>
+
+#include "FileSink.h"
+
+// Batches writes into an io_uring owned by the download thread. Completions
+// are reaped opportunistically on submit and synchronously on close.
+class IoUringFileSink final : public FileSink {
+    io_uring m_ring{};
+    bool m_ready{false};
+    unsigned m_queue_depth;
+    unsigned m_unsubmitted{0};
+    unsigned m_in_flight{0};
+
+public:
+    explicit IoUringFileSink(size_t queue_depth);
+    ~IoUringFileSink() override;
+
+    [[nodiscard]] auto isReady() const -> bool { return m_ready; }
+    [[nodiscard]] auto name() const -> const char* override { return "io_uring"; }
+
+protected:
+    auto submit(Buffer* buffer) -> void override;
+    auto wait(File* file) -> void override;
+    auto progress() -> void override;
+
+private:
+    auto queue(Buffer* buffer) -> void;
+    auto reap(bool block) -> void;
+};
+
+#endif
+
+#endif //IO_URING_FILE_SINK_H
@@ -0,0 +1,145 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "ObjectStore.h"
+
+#include <fmt/format.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <sys/clonefile.h>
+#elif defined(__linux__)
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+#include "Logs.h"
+
+ObjectStore::ObjectStore(std::filesystem::path root)
+    : m_root(std::move(root))
+{
+}
+
+auto ObjectStore::temporaryPath() const -> std::filesystem::path
+{
+    auto temporary_directory = m_root / "tmp";
+
+    std::error_code ec;
+    std::filesystem::create_directories(temporary_directory, ec);
+
+    return temporary_directory / fmt::format("{}-{}.tmp", getpid(), m_temporary_counter++);
+}
+
+auto ObjectStore::objectPath(const std::string& digest) const -> std::filesystem::path
+{
+    // Fan out on the first byte so no single directory holds every blob
+    return m_root / digest.substr(0, 2) / digest;
+}
+
+auto ObjectStore::store(const std::filesystem::path& temporary_path, const std::string& digest) const -> bool
+{
+    const auto object_path = objectPath(digest);
+
+    std::error_code ec;
+    if (std::filesystem::exists(object_path, ec))
+    {
+        // Same content already stored, the new copy is redundant
+        std::filesystem::remove(temporary_path, ec);
+        return true;
+    }
+
+    std::filesystem::create_directories(object_path.parent_path(), ec);
+    std::filesystem::rename(temporary_path, object_path, ec);
+
+    if (ec)
+    {
+        APP_ERROR("Unable to store object {}: {}", object_path.string(), ec.message());
+        std::filesystem::remove(temporary_path, ec);
+        return false;
+    }
+
+    return true;
+}
+
+auto ObjectStore::materialize(const std::string& digest, const std::filesystem::path& destination) const -> bool
+{
+    return link(objectPath(digest), destination);
+}
+
+auto ObjectStore::link(const std::filesystem::path& source, const std::filesystem::path& destination) -> bool
+{
+    std::error_code ec;
+    if (std::filesystem::exists(destination, ec))
+    {
+        if (std::filesystem::equivalent(source, destination, ec))
+        {
+            return true;
+        }
+
+        std::filesystem::remove(destination, ec);
+    }
+
+    std::filesystem::create_directories(destination.parent_path(), ec);
+
+    // Hardlink first, reflink when crossing devices or hitting the link limit, plain copy as last resort
+    ec.clear();
+    std::filesystem::create_hard_link(source, destination, ec);
+    if (!ec)
+    {
+        return true;
+    }
+
+    if (reflink(source, destination))
+    {
+        return true;
+    }
+
+    ec.clear();
+    std::filesystem::copy_file(source, destination, std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec)
+    {
+        APP_ERROR("Unable to materialize {} from {}: {}", destination.string(), source.string(), ec.message());
+        return false;
+    }
+
+    return true;
+}
+
+auto ObjectStore::reflink(const std::filesystem::path& source, const std::filesystem::path& destination) -> bool
+{
+#if defined(__APPLE__)
+    return clonefile(source.c_str(), destination.c_str(), 0) == 0;
+#elif defined(__linux__) && defined(FICLONE)
+    const int source_fd = ::open(source.c_str(), O_RDONLY);
+    if (source_fd < 0)
+    {
+        return false;
+    }
+
+    const int destination_fd = ::open(destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (destination_fd < 0)
+    {
+        ::close(source_fd);
+        return false;
+    }
+
+    const bool cloned = ioctl(destination_fd, FICLONE, source_fd) == 0;
+
+    ::close(destination_fd);
+    ::close(source_fd);
+
+    if (!cloned)
+    {
+        std::error_code ec;
+        std::filesystem::remove(destination, ec);
+    }
+
+    return cloned;
+#else
+    (void)source;
+    (void)destination;
+    return false;
+#endif
+}
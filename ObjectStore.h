@@ -0,0 +1,34 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef OBJECT_STORE_H
+#define OBJECT_STORE_H
+
+#include <atomic>
+#include <filesystem>
+#include <string>
+
+// Content-addressed blob store: bodies live once under objects/<hash> and
+// the human-readable data/ paths are materialized as links onto them.
+class ObjectStore {
+    std::filesystem::path m_root;
+    mutable std::atomic<size_t> m_temporary_counter{0};
+
+public:
+    explicit ObjectStore(std::filesystem::path root = "objects");
+
+    [[nodiscard]] auto temporaryPath() const -> std::filesystem::path;
+    [[nodiscard]] auto objectPath(const std::string& digest) const -> std::filesystem::path;
+
+    [[nodiscard]] auto store(const std::filesystem::path& temporary_path, const std::string& digest) const -> bool;
+    [[nodiscard]] auto materialize(const std::string& digest, const std::filesystem::path& destination) const -> bool;
+
+    // Replaces destination with a hardlink, reflink or copy of source
+    [[nodiscard]] static auto link(const std::filesystem::path& source, const std::filesystem::path& destination) -> bool;
+
+private:
+    static auto reflink(const std::filesystem::path& source, const std::filesystem::path& destination) -> bool;
+};
+
+#endif //OBJECT_STORE_H
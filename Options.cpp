@@ -0,0 +1,392 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "Options.h"
+
+#include <charconv>
+#include <iostream>
+#include <map>
+#include <string_view>
+
+auto Options::parse(const int argc, char* argv[]) -> std::optional<Options>
+{
+    Options options;
+
+    // Repeatable filters taking one value each
+    const std::map<std::string_view, std::vector<std::string>*> filter_lists = {
+        {"--exclude-lang", &options.filter.excluded_languages},
+        {"--set", &options.filter.sets},
+        {"--exclude-set", &options.filter.excluded_sets},
+        {"--serie", &options.filter.series},
+        {"--exclude-serie", &options.filter.excluded_series},
+    };
+
+    std::string_view shard;
+    auto shard_key = Shard::Key::Uri;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (const std::string_view argument = argv[i]; argument == "compact")
+        {
+            options.command = Command::Compact;
+        }
+        else if (argument == "daemon")
+        {
+            options.command = Command::Daemon;
+        }
+        else if (argument == "merge")
+        {
+            options.command = Command::Merge;
+        }
+        else if (argument == "search")
+        {
+            options.command = Command::Search;
+        }
+        else if (argument == "--dedup")
+        {
+            options.deduplicate = true;
+        }
+        else if (argument == "--verify")
+        {
+            options.verify = true;
+        }
+        else if (argument == "--pack")
+        {
+            options.pack = true;
+        }
+        else if (argument == "--card")
+        {
+            options.card = true;
+        }
+        else if (argument == "--keep-compressed")
+        {
+            options.keep_compressed = true;
+        }
+        else if (argument == "--api")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            options.api_url = argv[++i];
+            while (options.api_url.ends_with('/'))
+            {
+                options.api_url.pop_back();
+            }
+        }
+        else if (argument == "--gc")
+        {
+            options.collect_garbage = true;
+        }
+        else if (argument == "--quarantine")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            options.collect_garbage = true;
+            options.quarantine_path = argv[++i];
+        }
+        else if (argument == "--variants")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            options.variants_path = argv[++i];
+        }
+        else if (argument == "--interval")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            const std::string_view value = argv[++i];
+            if (const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), options.interval);
+                error != std::errc() || end != value.data() + value.size() || options.interval == 0)
+            {
+                std::cerr << "Invalid value for " << argument << ": " << value << std::endl;
+                return std::nullopt;
+            }
+        }
+        else if (argument == "--metrics")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            const std::string_view value = argv[++i];
+            if (const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), options.metrics_interval);
+                error != std::errc() || end != value.data() + value.size())
+            {
+                std::cerr << "Invalid value for " << argument << ": " << value << std::endl;
+                return std::nullopt;
+            }
+        }
+        else if (argument == "--revalidate-after")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            const std::string_view value = argv[++i];
+            if (const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), options.revalidate_after_days);
+                error != std::errc() || end != value.data() + value.size())
+            {
+                std::cerr << "Invalid value for " << argument << ": " << value << std::endl;
+                return std::nullopt;
+            }
+        }
+        else if (argument == "--max-requests" || argument == "--host-requests")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            const std::string_view value = argv[++i];
+            const auto requests = RateGovernor::parseRequests(value);
+            if (!requests.has_value())
+            {
+                std::cerr << "Invalid value for " << argument << ": " << value << std::endl;
+                return std::nullopt;
+            }
+
+            (argument == "--max-requests" ? options.limits.requests : options.limits.host_requests) = *requests;
+        }
+        else if (argument == "--max-bandwidth" || argument == "--host-bandwidth")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            const std::string_view value = argv[++i];
+            const auto bytes = RateGovernor::parseBytes(value);
+            if (!bytes.has_value())
+            {
+                std::cerr << "Invalid value for " << argument << ": " << value << std::endl;
+                return std::nullopt;
+            }
+
+            (argument == "--max-bandwidth" ? options.limits.bytes : options.limits.host_bytes) = *bytes;
+        }
+        else if (argument == "--socket")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            options.socket_path = argv[++i];
+        }
+        else if (argument == "--shard")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            shard = argv[++i];
+        }
+        else if (argument == "--shard-by")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            if (const std::string_view value = argv[++i]; value == "uri")
+            {
+                shard_key = Shard::Key::Uri;
+            }
+            else if (value == "lang")
+            {
+                shard_key = Shard::Key::Language;
+            }
+            else
+            {
+                std::cerr << "Invalid value for " << argument << ": " << value << std::endl;
+                return std::nullopt;
+            }
+        }
+        else if (argument == "--workers")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            const std::string_view value = argv[++i];
+            if (const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), options.workers);
+                error != std::errc() || end != value.data() + value.size() || options.workers < 2)
+            {
+                std::cerr << "Invalid value for " << argument << ", expected at least 2: " << value << std::endl;
+                return std::nullopt;
+            }
+        }
+        else if (argument == "--lang")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            options.filter.languages.emplace_back(argv[++i]);
+        }
+        else if (const auto list = filter_lists.find(argument); list != filter_lists.end())
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            list->second->emplace_back(argv[++i]);
+        }
+        else if (argument == "--released-since" || argument == "--released-until")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return std::nullopt;
+            }
+
+            const std::string_view value = argv[++i];
+            if (!SyncFilter::isDate(value))
+            {
+                std::cerr << "Invalid value for " << argument << ", expected YYYY-MM-DD: " << value << std::endl;
+                return std::nullopt;
+            }
+
+            (argument == "--released-since" ? options.filter.released_since : options.filter.released_until) = value;
+        }
+        else if (options.command == Command::Search && options.query.empty() && !argument.starts_with("--"))
+        {
+            options.query = argument;
+        }
+        else if (options.command == Command::Merge && !argument.starts_with("--"))
+        {
+            options.shard_paths.emplace_back(argument);
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << argument << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    if (options.command == Command::Search && options.query.empty())
+    {
+        std::cerr << "Missing search query" << std::endl;
+        return std::nullopt;
+    }
+
+    if (options.command == Command::Merge && options.shard_paths.empty())
+    {
+        std::cerr << "Missing shard databases to merge" << std::endl;
+        return std::nullopt;
+    }
+
+    if (!shard.empty())
+    {
+        const auto parsed = Shard::parse(shard, shard_key);
+        if (!parsed.has_value())
+        {
+            std::cerr << "Invalid value for --shard, expected <index>/<count>: " << shard << std::endl;
+            return std::nullopt;
+        }
+
+        options.shard = *parsed;
+    }
+    else
+    {
+        options.shard = Shard(0, 1, shard_key);
+    }
+
+    if (options.workers > 0 && (!shard.empty() || options.command != Command::Sync))
+    {
+        std::cerr << "--workers runs a sync and picks the shards itself" << std::endl;
+        return std::nullopt;
+    }
+
+    // The shards only plan part of the sets, none of them can tell what is no longer listed
+    if (options.workers > 0 && options.collect_garbage)
+    {
+        std::cerr << "--gc needs the plan of every set, run it without --workers" << std::endl;
+        return std::nullopt;
+    }
+
+    if (options.card && (options.filter.languages.size() != 1 || options.query.find('/') == std::string::npos))
+    {
+        std::cerr << "--card expects one --lang and a <set id>/<local id> query" << std::endl;
+        return std::nullopt;
+    }
+
+    return options;
+}
+
+auto Options::printUsage(std::ostream& os, const char* program) -> void
+{
+    os << "Usage: " << program << " [command] [options]" << std::endl
+       << "       " << program << " merge <shard database>..." << std::endl
+       << "       " << program << " search <name prefix> [--lang <lang>]..." << std::endl
+       << "       " << program << " search --card <set id>/<local id> --lang <lang>" << std::endl
+       << std::endl
+       << "Commands:" << std::endl
+       << "  (none)     Synchronize the catalog and images" << std::endl
+       << "  compact    Drop superseded entries from the packs and rewrite their index" << std::endl
+       << "  daemon     Keep running: check for changes every --interval and serve --socket" << std::endl
+       << "  merge      Merge shard databases into metadata.db and rewrite the catalogs and pack indexes" << std::endl
+       << "  search     Look cards up in the catalog/ files written by the last sync" << std::endl
+       << std::endl
+       << "Options:" << std::endl
+       << "  --api <url>        TCGdex API to synchronize from (default https://api.tcgdex.net/v2)" << std::endl
+       << "  --dedup            Store images once under objects/ and hardlink them into data/" << std::endl
+       << "  --verify           Re-hash the local store in parallel and download again mismatched files" << std::endl
+       << "  --pack             Append card images to per-language packs under packs/ instead of data/" << std::endl
+       << "  --keep-compressed  Store sets.json and cards.json gzip-compressed as received (.gz)" << std::endl
+       << "  --variants <file>  Image variants (<quality>.<format>) to download per language or set" << std::endl
+       << "  --gc               Delete the images and metadata rows of cards no longer listed" << std::endl
+       << "  --quarantine <dir> Move those images to dir instead of deleting them (implies --gc)" << std::endl
+       << "  --revalidate-after Days before the images of unchanged sets are requested again (default 7, 0 always)" << std::endl
+       << "  --interval <s>     Seconds between two checks of the daemon (default 3600)" << std::endl
+       << "  --socket <path>    Control socket of the daemon (default pokemonscraper.sock)" << std::endl
+       << "  --metrics <s>      Seconds between two resource samples in metrics.ndjson (default 10, 0 none)" << std::endl
+       << "  --max-requests     Requests per second to all hosts together (default no limit)" << std::endl
+       << "  --max-bandwidth    Bytes per second from all hosts together, K, M or G suffix (default no limit)" << std::endl
+       << "  --host-requests    Requests per second to each host (default no limit)" << std::endl
+       << "  --host-bandwidth   Bytes per second from each host, K, M or G suffix (default no limit)" << std::endl
+       << "  --shard <i>/<n>    Only sync shard i (from 0) of n, into shards/metadata-<i>-of-<n>.db" << std::endl
+       << "  --shard-by <key>   Split the shards by image uri (default) or by lang" << std::endl
+       << "  --workers <n>      Run n (at least 2) local shard processes, then merge them" << std::endl
+       << "  --lang <lang>      Only sync or search this language, may be repeated" << std::endl
+       << "  --exclude-lang     Skip a language, may be repeated" << std::endl
+       << "  --set <glob>       Only sync the sets whose id matches, may be repeated" << std::endl
+       << "  --exclude-set      Skip the sets whose id matches a glob, may be repeated" << std::endl
+       << "  --serie <id>       Only sync the sets of this serie, may be repeated" << std::endl
+       << "  --exclude-serie    Skip the sets of a serie, may be repeated" << std::endl
+       << "  --released-since   Only sync the sets released on or after a YYYY-MM-DD date" << std::endl
+       << "  --released-until   Only sync the sets released on or before a YYYY-MM-DD date" << std::endl
+       << "  --card             Look up one card by set id and local id instead of by name" << std::endl;
+}
@@ -0,0 +1,71 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "RateGovernor.h"
+#include "Shard.h"
+#include "SyncFilter.h"
+
+struct Options {
+    enum class Command {
+        Sync,
+        Compact,
+        Search,
+        Daemon,
+        Merge
+    };
+
+    Command command = Command::Sync;
+
+    // TCGdex API the JSON is requested from, a mirror or a test server
+    std::string api_url = "https://api.tcgdex.net/v2";
+    // Store bodies once under objects/ and link them into data/
+    bool deduplicate = false;
+    // Re-hash the local store and download again only what does not match
+    bool verify = false;
+    // Append card images to per-language packs under packs/ instead of data/
+    bool pack = false;
+    // Store sets.json/cards.json gzip-compressed as received (.gz)
+    bool keep_compressed = false;
+    // Image variants per language or set, high.jpg everywhere when empty
+    std::string variants_path;
+    // Delete the images and uri_metadata rows the sync no longer plans, or move them to quarantine_path when set
+    bool collect_garbage = false;
+    std::string quarantine_path;
+    // Days after which images are requested again even though their cards.json did not change, 0 for every run
+    unsigned revalidate_after_days = 7;
+
+    // Requests/s and bytes/s, for all hosts and per host; divided among the --workers
+    RateGovernor::Limits limits;
+
+    // daemon: seconds between two checks, and the control socket
+    unsigned interval = 3600;
+    std::string socket_path = "pokemonscraper.sock";
+    // Seconds between two samples of the resources written to metrics.ndjson, 0 for none
+    unsigned metrics_interval = 10;
+
+    // Part of the sync run by this process, and processes to run locally (one shard each)
+    Shard shard;
+    unsigned workers = 0;
+    // merge: shard databases to merge into metadata.db
+    std::vector<std::string> shard_paths;
+
+    // search: card name prefix, or <set id>/<local id> with --card
+    std::string query;
+    bool card = false;
+    // Part of the mirror to synchronize; its languages also restrict the search
+    SyncFilter filter;
+
+    [[nodiscard]] static auto parse(int argc, char* argv[]) -> std::optional<Options>;
+    static auto printUsage(std::ostream& os, const char* program) -> void;
+};
+
+#endif //OPTIONS_H
@@ -0,0 +1,459 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "PackArchive.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <ranges>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fmt/format.h>
+
+#include "Logs.h"
+#include "PackIndexReader.h"
+
+PackArchive::PackArchive(std::filesystem::path root)
+    : m_root(std::move(root))
+{
+}
+
+PackArchive::~PackArchive()
+{
+    closePacks();
+}
+
+auto PackArchive::temporaryPath() -> std::filesystem::path
+{
+    auto temporary_directory = m_root / "tmp";
+
+    std::error_code ec;
+    std::filesystem::create_directories(temporary_directory, ec);
+
+    return temporary_directory / fmt::format("{}-{}.tmp", getpid(), m_temporary_counter++);
+}
+
+auto PackArchive::indexPath(const std::string& group) const -> std::filesystem::path
+{
+    return m_root / fmt::format("{}.idx", group);
+}
+
+auto PackArchive::groups() const -> std::vector<std::string>
+{
+    std::vector<std::string> groups;
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(m_root, ec))
+    {
+        if (entry.path().extension() != ".pack")
+        {
+            continue;
+        }
+
+        // <group>-<generation>.pack
+        const auto stem = entry.path().stem().string();
+        if (const auto dash = stem.rfind('-'); dash != std::string::npos)
+        {
+            groups.push_back(stem.substr(0, dash));
+        }
+    }
+
+    std::ranges::sort(groups);
+    groups.erase(std::ranges::unique(groups).begin(), groups.end());
+
+    return groups;
+}
+
+auto PackArchive::append(const std::string& group, const std::filesystem::path& body_path) -> std::optional<DatabaseManager::PackEntry>
+{
+    std::lock_guard lock(m_mutex);
+
+    const auto& pack = activePack(group);
+    const int pack_fd = packFd(pack);
+    if (pack_fd < 0)
+    {
+        return std::nullopt;
+    }
+
+    const int body_fd = ::open(body_path.c_str(), O_RDONLY);
+    if (body_fd < 0)
+    {
+        APP_ERROR("Unable to open {}: {}", body_path.string(), std::strerror(errno));
+        return std::nullopt;
+    }
+
+    struct stat body_stat{};
+    struct stat pack_stat{};
+    fstat(body_fd, &body_stat);
+    fstat(pack_fd, &pack_stat);
+
+    const auto offset = static_cast<uint64_t>(pack_stat.st_size);
+    const auto length = static_cast<uint64_t>(body_stat.st_size);
+
+    const bool copied = copyRange(body_fd, 0, pack_fd, offset, length);
+
+    ::close(body_fd);
+
+    std::error_code ec;
+    std::filesystem::remove(body_path, ec);
+
+    if (!copied)
+    {
+        APP_ERROR("Unable to append {} to {}", body_path.string(), pack);
+
+        // Drop whatever was partially written
+        if (ftruncate(pack_fd, static_cast<off_t>(offset)) != 0)
+        {
+            APP_ERROR("Unable to truncate {}", pack);
+        }
+
+        return std::nullopt;
+    }
+
+    return DatabaseManager::PackEntry {"", group, pack, offset, length, ""};
+}
+
+auto PackArchive::writeIndex(const std::string& group, const std::vector<DatabaseManager::PackEntry>& entries) const -> bool
+{
+    std::vector<const DatabaseManager::PackEntry*> sorted;
+    sorted.reserve(entries.size());
+    for (const auto& entry : entries)
+    {
+        sorted.push_back(&entry);
+    }
+    std::ranges::sort(sorted, [](const auto* lhs, const auto* rhs) { return lhs->uri < rhs->uri; });
+
+    std::string strings;
+    std::unordered_map<std::string, uint32_t> pack_offsets;
+    std::vector<PackIndexEntry> index_entries;
+    index_entries.reserve(sorted.size());
+
+    for (const auto* entry : sorted)
+    {
+        PackIndexEntry index_entry{};
+        index_entry.offset = entry->offset;
+        index_entry.length = entry->length;
+
+        index_entry.uri_offset = static_cast<uint32_t>(strings.size());
+        index_entry.uri_length = static_cast<uint32_t>(entry->uri.size());
+        strings += entry->uri;
+
+        // Pack names are shared by most entries
+        auto [it, inserted] = pack_offsets.try_emplace(entry->pack, static_cast<uint32_t>(strings.size()));
+        if (inserted)
+        {
+            strings += entry->pack;
+        }
+        index_entry.pack_offset = it->second;
+        index_entry.pack_length = static_cast<uint32_t>(entry->pack.size());
+
+        index_entry.etag_offset = static_cast<uint32_t>(strings.size());
+        index_entry.etag_length = static_cast<uint32_t>(entry->etag.size());
+        strings += entry->etag;
+
+        index_entries.push_back(index_entry);
+    }
+
+    PackIndexHeader header{};
+    std::memcpy(header.magic, pack_index_magic, sizeof(pack_index_magic));
+    header.version = pack_index_version;
+    header.count = static_cast<uint32_t>(index_entries.size());
+    header.strings_offset = sizeof(PackIndexHeader) + index_entries.size() * sizeof(PackIndexEntry);
+    header.strings_size = strings.size();
+
+    // Readers may have the previous index mapped: write aside and rename
+    const auto index_path = indexPath(group);
+    const auto temporary_path = std::filesystem::path(index_path).concat(".tmp");
+
+    {
+        std::ofstream ofs(temporary_path, std::ios::out | std::ios::trunc | std::ios::binary);
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(index_entries.data()), static_cast<std::streamsize>(index_entries.size() * sizeof(PackIndexEntry)));
+        ofs.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+        // close() flushes the tail, where a full disk shows up
+        ofs.close();
+        if (!ofs)
+        {
+            APP_ERROR("Unable to write {}", temporary_path.string());
+            return false;
+        }
+    }
+
+    // Synced before the rename replaces the index readers map
+    const int temporary_fd = ::open(temporary_path.c_str(), O_RDONLY | O_CLOEXEC);
+    const int sync_error = temporary_fd < 0 || ::fsync(temporary_fd) != 0 ? errno : 0;
+    if (temporary_fd >= 0)
+    {
+        ::close(temporary_fd);
+    }
+
+    if (sync_error != 0)
+    {
+        APP_ERROR("Unable to sync {}: {}", temporary_path.string(), std::strerror(sync_error));
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporary_path, index_path, ec);
+    if (ec)
+    {
+        APP_ERROR("Unable to write {}: {}", index_path.string(), ec.message());
+        return false;
+    }
+
+    APP_INFO("{}: {} entries", index_path.string(), index_entries.size());
+
+    return true;
+}
+
+auto PackArchive::compact(const std::string& group, std::vector<DatabaseManager::PackEntry>& entries) -> bool
+{
+    std::lock_guard lock(m_mutex);
+
+    const auto current = activePack(group);
+    const auto generation = generationOf(group, current).value_or(0) + 1;
+    const auto next = fmt::format("{}-{:04}.pack", group, generation);
+
+    // Sequential reads from the old packs
+    std::ranges::sort(entries, [](const auto& lhs, const auto& rhs)
+    {
+        return std::tie(lhs.pack, lhs.offset) < std::tie(rhs.pack, rhs.offset);
+    });
+
+    const int next_fd = ::open((m_root / next).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (next_fd < 0)
+    {
+        APP_ERROR("Unable to create {}: {}", next, std::strerror(errno));
+        return false;
+    }
+
+    uint64_t offset = 0;
+    uint64_t superseded = 0;
+    for (auto& entry : entries)
+    {
+        const int source_fd = packFd(entry.pack);
+        if (source_fd < 0 || !copyRange(source_fd, entry.offset, next_fd, offset, entry.length))
+        {
+            APP_ERROR("Unable to copy {} from {}", entry.uri, entry.pack);
+
+            ::close(next_fd);
+            std::error_code ec;
+            std::filesystem::remove(m_root / next, ec);
+            return false;
+        }
+
+        entry.pack = next;
+        entry.offset = offset;
+        offset += entry.length;
+    }
+
+    // Only reported, a pack that vanished or cannot be read counts for nothing
+    std::error_code ec;
+    for (const auto& pack : std::filesystem::directory_iterator(m_root, ec))
+    {
+        if (generationOf(group, pack.path().filename().string()).has_value() && pack.path().filename() != next)
+        {
+            if (const auto size = pack.file_size(ec); !ec)
+            {
+                superseded += size;
+            }
+        }
+    }
+
+    // The previous generations are removed once the entries point here
+    if (::fsync(next_fd) != 0)
+    {
+        APP_ERROR("Unable to sync {}: {}", next, std::strerror(errno));
+
+        ::close(next_fd);
+        std::filesystem::remove(m_root / next, ec);
+        return false;
+    }
+    ::close(next_fd);
+
+    APP_INFO("{}: compacted {} bytes into {} bytes", group, superseded, offset);
+
+    // New appends go to the new generation
+    m_active_packs[group] = next;
+
+    return true;
+}
+
+auto PackArchive::abandonCompaction(const std::string& group) -> void
+{
+    std::lock_guard lock(m_mutex);
+
+    const auto it = m_active_packs.find(group);
+    if (it == m_active_packs.end())
+    {
+        return;
+    }
+
+    if (const auto fd = m_pack_fds.find(it->second); fd != m_pack_fds.end())
+    {
+        ::close(fd->second);
+        m_pack_fds.erase(fd);
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(m_root / it->second, ec);
+
+    // The highest generation left on disk is active again
+    m_active_packs.erase(it);
+}
+
+auto PackArchive::removeInactivePacks(const std::string& group) -> void
+{
+    std::lock_guard lock(m_mutex);
+
+    const auto& active = activePack(group);
+
+    std::vector<std::filesystem::path> inactive;
+    std::error_code ec;
+    for (const auto& pack : std::filesystem::directory_iterator(m_root, ec))
+    {
+        if (const auto name = pack.path().filename().string(); name != active && generationOf(group, name).has_value())
+        {
+            inactive.push_back(pack.path());
+        }
+    }
+
+    for (const auto& path : inactive)
+    {
+        if (const auto it = m_pack_fds.find(path.filename().string()); it != m_pack_fds.end())
+        {
+            ::close(it->second);
+            m_pack_fds.erase(it);
+        }
+
+        std::filesystem::remove(path, ec);
+    }
+}
+
+auto PackArchive::activePack(const std::string& group) -> const std::string&
+{
+    if (const auto it = m_active_packs.find(group); it != m_active_packs.end())
+    {
+        return it->second;
+    }
+
+    // Highest generation on disk, or the first one
+    std::optional<unsigned> latest;
+    std::error_code ec;
+    for (const auto& pack : std::filesystem::directory_iterator(m_root, ec))
+    {
+        if (const auto generation = generationOf(group, pack.path().filename().string()); generation.has_value() && (!latest || *generation > *latest))
+        {
+            latest = generation;
+        }
+    }
+
+    return m_active_packs[group] = fmt::format("{}-{:04}.pack", group, latest.value_or(0));
+}
+
+auto PackArchive::packFd(const std::string& pack) -> int
+{
+    if (const auto it = m_pack_fds.find(pack); it != m_pack_fds.end())
+    {
+        return it->second;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(m_root, ec);
+
+    const int fd = ::open((m_root / pack).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        APP_ERROR("Unable to open {}: {}", (m_root / pack).string(), std::strerror(errno));
+        return -1;
+    }
+
+    m_pack_fds.emplace(pack, fd);
+
+    return fd;
+}
+
+auto PackArchive::closePacks() -> void
+{
+    for (const auto& fd : m_pack_fds | std::views::values)
+    {
+        ::close(fd);
+    }
+
+    m_pack_fds.clear();
+}
+
+auto PackArchive::generationOf(const std::string& group, const std::string& file_name) -> std::optional<unsigned>
+{
+    // <group>-<4 digits>.pack
+    if (file_name.size() != group.size() + 10 || !file_name.starts_with(group) || file_name[group.size()] != '-' || !file_name.ends_with(".pack"))
+    {
+        return std::nullopt;
+    }
+
+    unsigned generation = 0;
+    for (size_t i = group.size() + 1; i < group.size() + 5; i++)
+    {
+        if (file_name[i] < '0' || file_name[i] > '9')
+        {
+            return std::nullopt;
+        }
+        generation = generation * 10 + (file_name[i] - '0');
+    }
+
+    return generation;
+}
+
+auto PackArchive::copyRange(const int in_fd, uint64_t in_offset, const int out_fd, uint64_t out_offset, uint64_t length) -> bool
+{
+#ifdef __linux__
+    // In-kernel copy, falls back to read/write below when unsupported
+    while (length > 0)
+    {
+        auto in = static_cast<off_t>(in_offset);
+        auto out = static_cast<off_t>(out_offset);
+
+        const ssize_t copied = copy_file_range(in_fd, &in, out_fd, &out, length, 0);
+        if (copied <= 0)
+        {
+            break;
+        }
+
+        in_offset += copied;
+        out_offset += copied;
+        length -= copied;
+    }
+#endif
+
+    char buffer[64 * 1024];
+    while (length > 0)
+    {
+        const ssize_t read = pread(in_fd, buffer, std::min<uint64_t>(sizeof(buffer), length), static_cast<off_t>(in_offset));
+        if (read <= 0)
+        {
+            return false;
+        }
+
+        for (ssize_t written_total = 0; written_total < read; )
+        {
+            const ssize_t written = pwrite(out_fd, buffer + written_total, read - written_total, static_cast<off_t>(out_offset + written_total));
+            if (written <= 0)
+            {
+                return false;
+            }
+            written_total += written;
+        }
+
+        in_offset += read;
+        out_offset += read;
+        length -= read;
+    }
+
+    return true;
+}
@@ -0,0 +1,60 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef PACK_ARCHIVE_H
+#define PACK_ARCHIVE_H
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DatabaseManager.h"
+
+// Append-only pack files: packs/<group>-<generation>.pack hold the bodies back
+// to back and packs/<group>.idx is the memory-mappable index readers use to
+// find them (see PackIndexReader.h). Compaction copies live entries into the
+// next generation and drops the previous ones.
+class PackArchive {
+    std::filesystem::path m_root;
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::string> m_active_packs;
+    std::unordered_map<std::string, int> m_pack_fds;
+    std::atomic<size_t> m_temporary_counter{0};
+
+public:
+    explicit PackArchive(std::filesystem::path root = "packs");
+    ~PackArchive();
+
+    PackArchive(const PackArchive&) = delete;
+    PackArchive& operator=(const PackArchive&) = delete;
+
+    [[nodiscard]] auto temporaryPath() -> std::filesystem::path;
+    [[nodiscard]] auto indexPath(const std::string& group) const -> std::filesystem::path;
+    [[nodiscard]] auto groups() const -> std::vector<std::string>;
+
+    // Appends the body file to the active pack of the group, the body file is removed
+    [[nodiscard]] auto append(const std::string& group, const std::filesystem::path& body_path) -> std::optional<DatabaseManager::PackEntry>;
+
+    [[nodiscard]] auto writeIndex(const std::string& group, const std::vector<DatabaseManager::PackEntry>& entries) const -> bool;
+
+    // Copies the entries into a new generation and updates their pack and offset
+    [[nodiscard]] auto compact(const std::string& group, std::vector<DatabaseManager::PackEntry>& entries) -> bool;
+    // Drops the generation written by compact(), appends go back to the previous one
+    auto abandonCompaction(const std::string& group) -> void;
+    auto removeInactivePacks(const std::string& group) -> void;
+
+private:
+    auto activePack(const std::string& group) -> const std::string&;
+    auto packFd(const std::string& pack) -> int;
+    auto closePacks() -> void;
+
+    static auto generationOf(const std::string& group, const std::string& file_name) -> std::optional<unsigned>;
+    static auto copyRange(int in_fd, uint64_t in_offset, int out_fd, uint64_t out_offset, uint64_t length) -> bool;
+};
+
+#endif //PACK_ARCHIVE_H
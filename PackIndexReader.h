@@ -0,0 +1,186 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef PACK_INDEX_READER_H
+#define PACK_INDEX_READER_H
+
+// Header only reader for the packs/<lang>.idx files, meant to be copied into
+// consumers: the index is memory-mapped and searched in place, open() only checks
+// that every string of the entries lies in the pool.
+//
+// Layout (little endian):
+//   PackIndexHeader
+//   PackIndexEntry[count], sorted by uri (byte order)
+//   string pool (uris, pack names and etags, not NUL terminated)
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct PackIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct PackIndexEntry {
+    uint64_t offset;
+    uint64_t length;
+    uint32_t uri_offset;
+    uint32_t uri_length;
+    uint32_t pack_offset;
+    uint32_t pack_length;
+    uint32_t etag_offset;
+    uint32_t etag_length;
+};
+
+static_assert(sizeof(PackIndexHeader) == 32);
+static_assert(sizeof(PackIndexEntry) == 40);
+
+inline constexpr char pack_index_magic[8] = {'P', 'K', 'S', 'C', 'I', 'D', 'X', '\0'};
+inline constexpr uint32_t pack_index_version = 1;
+
+class PackIndexReader {
+    void* m_data{MAP_FAILED};
+    size_t m_size{0};
+    const PackIndexHeader* m_header{nullptr};
+    const PackIndexEntry* m_entries{nullptr};
+    const char* m_strings{nullptr};
+
+public:
+    struct Location {
+        // Pack file name, relative to the index directory
+        std::string_view pack;
+        uint64_t offset;
+        uint64_t length;
+        std::string_view etag;
+    };
+
+    PackIndexReader() = default;
+    PackIndexReader(const PackIndexReader&) = delete;
+    PackIndexReader& operator=(const PackIndexReader&) = delete;
+
+    ~PackIndexReader()
+    {
+        close();
+    }
+
+    auto open(const std::string& path) -> bool
+    {
+        close();
+
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(PackIndexHeader))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        m_size = static_cast<size_t>(st.st_size);
+        m_data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (m_data == MAP_FAILED)
+        {
+            return false;
+        }
+
+        m_header = static_cast<const PackIndexHeader*>(m_data);
+        if (std::memcmp(m_header->magic, pack_index_magic, sizeof(pack_index_magic)) != 0 ||
+            m_header->version != pack_index_version ||
+            !fits(sizeof(PackIndexHeader), uint64_t{m_header->count} * sizeof(PackIndexEntry), m_size) ||
+            !fits(m_header->strings_offset, m_header->strings_size, m_size))
+        {
+            close();
+            return false;
+        }
+
+        m_entries = reinterpret_cast<const PackIndexEntry*>(static_cast<const char*>(m_data) + sizeof(PackIndexHeader));
+        m_strings = static_cast<const char*>(m_data) + m_header->strings_offset;
+
+        // Every string find() returns stays inside the pool
+        for (const auto* entry = m_entries; entry != m_entries + m_header->count; ++entry)
+        {
+            if (!fits(entry->uri_offset, entry->uri_length, m_header->strings_size) ||
+                !fits(entry->pack_offset, entry->pack_length, m_header->strings_size) ||
+                !fits(entry->etag_offset, entry->etag_length, m_header->strings_size))
+            {
+                close();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    auto close() -> void
+    {
+        if (m_data != MAP_FAILED)
+        {
+            munmap(m_data, m_size);
+        }
+
+        m_data = MAP_FAILED;
+        m_size = 0;
+        m_header = nullptr;
+        m_entries = nullptr;
+        m_strings = nullptr;
+    }
+
+    [[nodiscard]] auto size() const -> size_t { return m_header ? m_header->count : 0; }
+
+    [[nodiscard]] auto find(const std::string_view uri) const -> std::optional<Location>
+    {
+        if (!m_header)
+        {
+            return std::nullopt;
+        }
+
+        const auto end = m_entries + m_header->count;
+        const auto it = std::lower_bound(m_entries, end, uri, [this](const PackIndexEntry& entry, const std::string_view value)
+        {
+            return string(entry.uri_offset, entry.uri_length) < value;
+        });
+
+        if (it == end || string(it->uri_offset, it->uri_length) != uri)
+        {
+            return std::nullopt;
+        }
+
+        return Location {
+            string(it->pack_offset, it->pack_length),
+            it->offset,
+            it->length,
+            string(it->etag_offset, it->etag_length)
+        };
+    }
+
+private:
+    static auto fits(const uint64_t offset, const uint64_t length, const uint64_t size) -> bool
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    [[nodiscard]] auto string(const uint32_t offset, const uint32_t length) const -> std::string_view
+    {
+        return {m_strings + offset, length};
+    }
+};
+
+#endif //PACK_INDEX_READER_H
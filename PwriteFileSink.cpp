@@ -0,0 +1,85 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "PwriteFileSink.h"
+
+#include <cerrno>
+#include <unistd.h>
+
+PwriteFileSink::PwriteFileSink(const size_t queue_depth, const size_t threads)
+    : FileSink(queue_depth * 2), m_queue(std::max<size_t>(queue_depth * 2, 1))
+{
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); i++)
+    {
+        m_threads.emplace_back(&PwriteFileSink::run, this);
+    }
+}
+
+PwriteFileSink::~PwriteFileSink()
+{
+    {
+        std::lock_guard lock(m_queue_mutex);
+        m_stopping = true;
+    }
+    m_queue_condition.notify_all();
+
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+auto PwriteFileSink::submit(Buffer* buffer) -> void
+{
+    {
+        std::lock_guard lock(m_queue_mutex);
+        m_queue[(m_queue_head + m_queue_size++) % m_queue.size()] = buffer;
+    }
+    m_queue_condition.notify_one();
+}
+
+auto PwriteFileSink::run() -> void
+{
+    while (true)
+    {
+        Buffer* buffer;
+        {
+            std::unique_lock lock(m_queue_mutex);
+            m_queue_condition.wait(lock, [this] { return m_stopping || m_queue_size > 0; });
+
+            if (m_queue_size == 0)
+            {
+                return;
+            }
+
+            buffer = m_queue[m_queue_head];
+            m_queue_head = (m_queue_head + 1) % m_queue.size();
+            m_queue_size--;
+        }
+
+        bool success = true;
+        while (buffer->written < buffer->size)
+        {
+            const ssize_t written = pwrite(buffer->file->fd,
+                buffer->data.get() + buffer->written,
+                buffer->size - buffer->written,
+                static_cast<off_t>(buffer->offset + buffer->written));
+
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (written <= 0)
+            {
+                success = false;
+                break;
+            }
+
+            buffer->written += static_cast<size_t>(written);
+        }
+
+        completed(buffer, success);
+    }
+}
@@ -0,0 +1,37 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef PWRITE_FILE_SINK_H
+#define PWRITE_FILE_SINK_H
+
+#include <thread>
+#include <vector>
+
+#include "FileSink.h"
+
+// Portable fallback: a small pool of threads issuing blocking pwrite calls.
+class PwriteFileSink final : public FileSink {
+    std::mutex m_queue_mutex;
+    std::condition_variable m_queue_condition;
+    // Ring of submitted buffers, sized for every buffer of the sink so it never grows
+    std::vector<Buffer*> m_queue;
+    size_t m_queue_head{0};
+    size_t m_queue_size{0};
+    bool m_stopping{false};
+    std::vector<std::thread> m_threads;
+
+public:
+    explicit PwriteFileSink(size_t queue_depth, size_t threads = 4);
+    ~PwriteFileSink() override;
+
+    [[nodiscard]] auto name() const -> const char* override { return "pwrite thread pool"; }
+
+protected:
+    auto submit(Buffer* buffer) -> void override;
+
+private:
+    auto run() -> void;
+};
+
+#endif //PWRITE_FILE_SINK_H
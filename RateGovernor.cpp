@@ -0,0 +1,248 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "RateGovernor.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+auto RateGovernor::Bucket::refill(const double rate, const Clock::time_point now) -> void
+{
+    if (rate <= 0)
+    {
+        return;
+    }
+
+    // A new bucket starts full, so a run may burst one second of its rate
+    if (updated == Clock::time_point{})
+    {
+        tokens = std::max(rate, 1.0);
+    }
+    else
+    {
+        const auto elapsed = std::chrono::duration<double>(now - updated).count();
+        tokens = std::min(std::max(rate, 1.0), tokens + elapsed * rate);
+    }
+
+    updated = now;
+}
+
+auto RateGovernor::Bucket::wait(const double rate, const double needed) const -> Clock::duration
+{
+    if (rate <= 0 || tokens >= needed)
+    {
+        return Clock::duration::zero();
+    }
+
+    return std::chrono::ceil<Clock::duration>(std::chrono::duration<double>((needed - tokens) / rate));
+}
+
+auto RateGovernor::setLimits(const Limits& limits) -> void
+{
+    const std::lock_guard lock(m_mutex);
+
+    m_limits = limits;
+    m_shares.fetch_add(1, std::memory_order_relaxed);
+
+    // Refilled at the new rates from now on
+    m_requests = {};
+    m_bytes = {};
+    for (auto& [name, host] : m_hosts)
+    {
+        host.requests = {};
+        host.bytes = {};
+    }
+}
+
+auto RateGovernor::limits() const -> Limits
+{
+    const std::lock_guard lock(m_mutex);
+    return m_limits;
+}
+
+auto RateGovernor::admit(const std::string_view name) -> Clock::duration
+{
+    const auto now = Clock::now();
+
+    const std::lock_guard lock(m_mutex);
+
+    auto& entry = host(name);
+    if (now < entry.paused_until)
+    {
+        return entry.paused_until - now;
+    }
+
+    const auto host_bytes = static_cast<double>(m_limits.host_bytes);
+    const auto bytes = static_cast<double>(m_limits.bytes);
+
+    m_requests.refill(m_limits.requests, now);
+    m_bytes.refill(bytes, now);
+    entry.requests.refill(m_limits.host_requests, now);
+    entry.bytes.refill(host_bytes, now);
+
+    // Bytes are charged after the fact, a bucket in debt admits nothing until repaid
+    if (const auto wait = std::max({
+            m_requests.wait(m_limits.requests, 1),
+            entry.requests.wait(m_limits.host_requests, 1),
+            m_bytes.wait(bytes, 0),
+            entry.bytes.wait(host_bytes, 0)});
+        wait > Clock::duration::zero())
+    {
+        return wait;
+    }
+
+    if (m_limits.requests > 0)
+    {
+        m_requests.tokens -= 1;
+    }
+    if (m_limits.host_requests > 0)
+    {
+        entry.requests.tokens -= 1;
+    }
+
+    m_active++;
+    entry.active++;
+
+    if (m_limits.bytes > 0 || m_limits.host_bytes > 0)
+    {
+        m_shares.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return Clock::duration::zero();
+}
+
+auto RateGovernor::receiveSpeed(const std::string_view name) const -> curl_off_t
+{
+    const std::lock_guard lock(m_mutex);
+
+    uint64_t speed = 0;
+
+    // An equal share for each transfer running now
+    if (m_limits.bytes > 0)
+    {
+        speed = m_limits.bytes / std::max<size_t>(m_active, 1);
+    }
+
+    if (const auto it = m_hosts.find(name); m_limits.host_bytes > 0 && it != m_hosts.end())
+    {
+        const auto host_speed = m_limits.host_bytes / std::max<size_t>(it->second.active, 1);
+        speed = speed == 0 ? host_speed : std::min(speed, host_speed);
+    }
+
+    // 0 would lift the cap
+    return m_limits.bytes > 0 || m_limits.host_bytes > 0 ? static_cast<curl_off_t>(std::max<uint64_t>(speed, 1)) : 0;
+}
+
+auto RateGovernor::release(const std::string_view name, const uint64_t bytes) -> void
+{
+    const auto now = Clock::now();
+
+    const std::lock_guard lock(m_mutex);
+
+    auto& entry = host(name);
+
+    m_active -= std::min<size_t>(m_active, 1);
+    entry.active -= std::min<size_t>(entry.active, 1);
+
+    if (m_limits.bytes > 0 || m_limits.host_bytes > 0)
+    {
+        m_shares.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (m_limits.bytes > 0)
+    {
+        m_bytes.refill(static_cast<double>(m_limits.bytes), now);
+        m_bytes.tokens -= static_cast<double>(bytes);
+    }
+
+    if (m_limits.host_bytes > 0)
+    {
+        entry.bytes.refill(static_cast<double>(m_limits.host_bytes), now);
+        entry.bytes.tokens -= static_cast<double>(bytes);
+    }
+}
+
+auto RateGovernor::pause(const std::string_view name, const std::chrono::seconds delay) -> void
+{
+    const auto until = Clock::now() + delay;
+
+    const std::lock_guard lock(m_mutex);
+
+    auto& entry = host(name);
+    entry.paused_until = std::max(entry.paused_until, until);
+}
+
+auto RateGovernor::host(const std::string_view name) -> Host&
+{
+    if (const auto it = m_hosts.find(name); it != m_hosts.end())
+    {
+        return it->second;
+    }
+
+    return m_hosts.emplace(std::string(name), Host{}).first->second;
+}
+
+auto RateGovernor::hostOf(const std::string_view uri) -> std::string_view
+{
+    auto authority = uri;
+    if (const auto scheme = authority.find("://"); scheme != std::string_view::npos)
+    {
+        authority.remove_prefix(scheme + 3);
+    }
+
+    if (const auto end = authority.find_first_of("/?#"); end != std::string_view::npos)
+    {
+        authority = authority.substr(0, end);
+    }
+
+    if (const auto user_info = authority.rfind('@'); user_info != std::string_view::npos)
+    {
+        authority.remove_prefix(user_info + 1);
+    }
+
+    return authority;
+}
+
+auto RateGovernor::parseRequests(const std::string_view value) -> std::optional<double>
+{
+    double requests = 0;
+    if (const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), requests);
+        error != std::errc() || end != value.data() + value.size() || !std::isfinite(requests) || requests < 0)
+    {
+        return std::nullopt;
+    }
+
+    return requests;
+}
+
+auto RateGovernor::parseBytes(std::string_view value) -> std::optional<uint64_t>
+{
+    uint64_t multiplier = 1;
+    if (!value.empty())
+    {
+        switch (value.back())
+        {
+        case 'k': case 'K': multiplier = 1024; break;
+        case 'm': case 'M': multiplier = 1024 * 1024; break;
+        case 'g': case 'G': multiplier = 1024 * 1024 * 1024; break;
+        default: break;
+        }
+    }
+
+    if (multiplier != 1)
+    {
+        value.remove_suffix(1);
+    }
+
+    uint64_t bytes = 0;
+    if (const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), bytes);
+        value.empty() || error != std::errc() || end != value.data() + value.size() || bytes > std::numeric_limits<uint64_t>::max() / multiplier)
+    {
+        return std::nullopt;
+    }
+
+    return bytes * multiplier;
+}
@@ -0,0 +1,89 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef RATE_GOVERNOR_H
+#define RATE_GOVERNOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <curl/curl.h>
+
+// Token buckets shared by every transfer of a DownloadManager: requests/s and
+// bytes/s, for all hosts and per host. A transfer only starts once admitted,
+// its receive speed is capped to its share of the bandwidth, and its bytes are
+// charged once it ends. The shares change as transfers start and end, so the
+// running ones are capped again whenever shares() moves. Limits can be changed
+// while transfers run.
+class RateGovernor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 0 for no limit
+    struct Limits {
+        double requests = 0;
+        uint64_t bytes = 0;
+        double host_requests = 0;
+        uint64_t host_bytes = 0;
+
+        [[nodiscard]] auto any() const -> bool { return requests > 0 || bytes > 0 || host_requests > 0 || host_bytes > 0; }
+    };
+
+    auto setLimits(const Limits& limits) -> void;
+    [[nodiscard]] auto limits() const -> Limits;
+
+    // Takes a request token for host, or tells how long to wait before asking again
+    [[nodiscard]] auto admit(std::string_view host) -> Clock::duration;
+    // CURLOPT_MAX_RECV_SPEED_LARGE of a transfer running on host, 0 when unlimited
+    [[nodiscard]] auto receiveSpeed(std::string_view host) const -> curl_off_t;
+    // Changes whenever the receive speeds do
+    [[nodiscard]] auto shares() const -> uint64_t { return m_shares.load(std::memory_order_relaxed); }
+    // Ends an admitted transfer and charges its bytes
+    auto release(std::string_view host, uint64_t bytes) -> void;
+    // Nothing is admitted on host before delay, after a 429 or a 503
+    auto pause(std::string_view host, std::chrono::seconds delay) -> void;
+
+    // "<host>[:<port>]" of an URI, without allocating
+    [[nodiscard]] static auto hostOf(std::string_view uri) -> std::string_view;
+    // Requests per second, fractions allowed
+    [[nodiscard]] static auto parseRequests(std::string_view value) -> std::optional<double>;
+    // Bytes per second with an optional K, M or G (binary) suffix
+    [[nodiscard]] static auto parseBytes(std::string_view value) -> std::optional<uint64_t>;
+
+private:
+    // Holds up to one second of its rate, and may go into debt for the bytes
+    struct Bucket {
+        double tokens = 0;
+        Clock::time_point updated{};
+
+        auto refill(double rate, Clock::time_point now) -> void;
+        // Time until tokens reach needed, zero when they already have
+        [[nodiscard]] auto wait(double rate, double needed) const -> Clock::duration;
+    };
+
+    struct Host {
+        Bucket requests;
+        Bucket bytes;
+        size_t active = 0;
+        Clock::time_point paused_until{};
+    };
+
+    auto host(std::string_view name) -> Host&;
+
+    mutable std::mutex m_mutex;
+    Limits m_limits;
+    Bucket m_requests;
+    Bucket m_bytes;
+    size_t m_active = 0;
+    std::atomic<uint64_t> m_shares{0};
+    // Heterogeneous lookup, a known host costs no allocation
+    std::map<std::string, Host, std::less<>> m_hosts;
+};
+
+#endif //RATE_GOVERNOR_H
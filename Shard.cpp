@@ -0,0 +1,94 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "Shard.h"
+
+#include <charconv>
+#include <fmt/format.h>
+
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+
+Shard::Shard(const unsigned index, const unsigned count, const Key key)
+    : m_index(index)
+    , m_count(count)
+    , m_key(key)
+{
+}
+
+auto Shard::parse(const std::string_view value, const Key key) -> std::optional<Shard>
+{
+    const auto slash = value.find('/');
+    if (slash == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+
+    const auto number = [](const std::string_view text) -> std::optional<unsigned>
+    {
+        unsigned result = 0;
+        if (const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), result);
+            error != std::errc() || end != text.data() + text.size())
+        {
+            return std::nullopt;
+        }
+        return result;
+    };
+
+    const auto index = number(value.substr(0, slash));
+    const auto count = number(value.substr(slash + 1));
+
+    if (!index.has_value() || !count.has_value() || *count == 0 || *index >= *count)
+    {
+        return std::nullopt;
+    }
+
+    return Shard(*index, *count, key);
+}
+
+auto Shard::ownsLanguage(const std::string_view lang_id) const -> bool
+{
+    return m_key != Key::Language || owns(lang_id);
+}
+
+auto Shard::ownsImage(const std::string_view lang_id, const std::string_view uri) const -> bool
+{
+    return m_key == Key::Language ? owns(lang_id) : owns(uri);
+}
+
+auto Shard::name() const -> std::string
+{
+    return fmt::format("{}-of-{}", m_index, m_count);
+}
+
+auto Shard::databasePath() const -> std::string
+{
+    return isSharded() ? fmt::format("shards/metadata-{}.db", name()) : "metadata.db";
+}
+
+auto Shard::changesPath() const -> std::string
+{
+    return isSharded() ? fmt::format("shards/changes-{}.ndjson", name()) : "changes.ndjson";
+}
+
+auto Shard::metricsPath() const -> std::string
+{
+    return isSharded() ? fmt::format("shards/metrics-{}.ndjson", name()) : "metrics.ndjson";
+}
+
+auto Shard::cacheDirectory() const -> std::string
+{
+    return isSharded() ? fmt::format("cache/{}", name()) : "cache";
+}
+
+auto Shard::packGroup(const std::string& lang_id) const -> std::string
+{
+    return isSharded() && m_key == Key::Uri ? fmt::format("{}.{}", lang_id, name()) : lang_id;
+}
+
+auto Shard::owns(const std::string_view key) const -> bool
+{
+    // XXH3 is specified, so every host computes the same partition
+    return !isSharded() || XXH3_64bits(key.data(), key.size()) % m_count == m_index;
+}
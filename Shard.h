@@ -0,0 +1,62 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Part of a sync run by one worker process or host. Every worker computes the
+// whole plan and keeps its part, chosen by a hash of the image URI or of the
+// language that does not depend on the machine, so N local processes and N
+// hosts split the work the same way.
+class Shard {
+public:
+    enum class Key {
+        Uri,
+        Language
+    };
+
+private:
+    unsigned m_index = 0;
+    unsigned m_count = 1;
+    Key m_key = Key::Uri;
+
+public:
+    Shard() = default;
+    Shard(unsigned index, unsigned count, Key key);
+
+    // "<index>/<count>", index from 0
+    [[nodiscard]] static auto parse(std::string_view value, Key key) -> std::optional<Shard>;
+
+    [[nodiscard]] auto index() const -> unsigned { return m_index; }
+    [[nodiscard]] auto count() const -> unsigned { return m_count; }
+    [[nodiscard]] auto key() const -> Key { return m_key; }
+    [[nodiscard]] auto isSharded() const -> bool { return m_count > 1; }
+
+    // With the language key, whole languages (their JSON and images) belong to one shard
+    [[nodiscard]] auto ownsLanguage(std::string_view lang_id) const -> bool;
+    // With the URI key, every shard refreshes all the JSON and keeps its share of images
+    [[nodiscard]] auto ownsImage(std::string_view lang_id, std::string_view uri) const -> bool;
+
+    // "<index>-of-<count>"
+    [[nodiscard]] auto name() const -> std::string;
+    // metadata.db, or shards/metadata-<index>-of-<count>.db
+    [[nodiscard]] auto databasePath() const -> std::string;
+    // changes.ndjson, or shards/changes-<index>-of-<count>.ndjson
+    [[nodiscard]] auto changesPath() const -> std::string;
+    // metrics.ndjson, or shards/metrics-<index>-of-<count>.ndjson
+    [[nodiscard]] auto metricsPath() const -> std::string;
+    // cache/, or cache/<index>-of-<count>/ so local workers do not share files
+    [[nodiscard]] auto cacheDirectory() const -> std::string;
+    // Pack group of a language, suffixed by the shard with the URI key so workers never append to the same pack
+    [[nodiscard]] auto packGroup(const std::string& lang_id) const -> std::string;
+
+private:
+    [[nodiscard]] auto owns(std::string_view key) const -> bool;
+};
+
+#endif //SHARD_H
@@ -0,0 +1,80 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "SyncFilter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fnmatch.h>
+
+namespace {
+    auto contains(const std::vector<std::string>& values, const std::string_view value) -> bool
+    {
+        return std::ranges::find(values, value) != values.end();
+    }
+
+    auto matchesAny(const std::vector<std::string>& globs, const std::string& value) -> bool
+    {
+        return std::ranges::any_of(globs, [&value](const std::string& glob)
+        {
+            return fnmatch(glob.c_str(), value.c_str(), 0) == 0;
+        });
+    }
+}
+
+auto SyncFilter::isEmpty() const -> bool
+{
+    return languages.empty() && excluded_languages.empty() &&
+           sets.empty() && excluded_sets.empty() &&
+           !needsSetDetails();
+}
+
+auto SyncFilter::acceptsLanguage(const std::string_view lang_id) const -> bool
+{
+    return (languages.empty() || contains(languages, lang_id)) && !contains(excluded_languages, lang_id);
+}
+
+auto SyncFilter::acceptsSetId(const std::string& set_id) const -> bool
+{
+    return (sets.empty() || matchesAny(sets, set_id)) && !matchesAny(excluded_sets, set_id);
+}
+
+auto SyncFilter::needsSetDetails() const -> bool
+{
+    return !series.empty() || !excluded_series.empty() || !released_since.empty() || !released_until.empty();
+}
+
+auto SyncFilter::acceptsSetDetails(const std::string_view serie_id, const std::string_view release_date) const -> bool
+{
+    if ((!series.empty() && !contains(series, serie_id)) || contains(excluded_series, serie_id))
+    {
+        return false;
+    }
+
+    // A set without a release date is outside of any date range
+    if (!released_since.empty() && (release_date.empty() || release_date < released_since))
+    {
+        return false;
+    }
+
+    return released_until.empty() || (!release_date.empty() && release_date <= released_until);
+}
+
+auto SyncFilter::isDate(const std::string_view value) -> bool
+{
+    if (value.size() != 10 || value[4] != '-' || value[7] != '-')
+    {
+        return false;
+    }
+
+    for (const auto i : {0, 1, 2, 3, 5, 6, 8, 9})
+    {
+        if (!std::isdigit(static_cast<unsigned char>(value[i])))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,39 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef SYNC_FILTER_H
+#define SYNC_FILTER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Part of the mirror to synchronize. An empty include list selects
+// everything, includes of a kind are or-ed and excludes always win.
+struct SyncFilter {
+    std::vector<std::string> languages;
+    std::vector<std::string> excluded_languages;
+    // Globs on set ids, e.g. "sv*"
+    std::vector<std::string> sets;
+    std::vector<std::string> excluded_sets;
+    std::vector<std::string> series;
+    std::vector<std::string> excluded_series;
+    // Inclusive YYYY-MM-DD bounds on the release date
+    std::string released_since;
+    std::string released_until;
+
+    [[nodiscard]] auto isEmpty() const -> bool;
+
+    [[nodiscard]] auto acceptsLanguage(std::string_view lang_id) const -> bool;
+    [[nodiscard]] auto acceptsSetId(const std::string& set_id) const -> bool;
+
+    // Series and release dates are not in sets.json, they come from cards.json or the previous catalog
+    [[nodiscard]] auto needsSetDetails() const -> bool;
+    [[nodiscard]] auto acceptsSetDetails(std::string_view serie_id, std::string_view release_date) const -> bool;
+
+    // YYYY-MM-DD, as TCGdex gives release dates
+    [[nodiscard]] static auto isDate(std::string_view value) -> bool;
+};
+
+#endif //SYNC_FILTER_H
@@ -0,0 +1,135 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace {
+    // Index of the pool worker running on this thread, if any
+    thread_local const ThreadPool* current_pool = nullptr;
+    thread_local size_t current_worker = 0;
+}
+
+ThreadPool::ThreadPool(const size_t threads)
+{
+    const auto thread_count = std::max<size_t>(threads, 1);
+
+    m_workers.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+
+    m_threads.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        m_threads.emplace_back(&ThreadPool::run, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    wait();
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_task_condition.notify_all();
+
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+auto ThreadPool::submit(Task task) -> void
+{
+    const auto index = current_pool == this
+        ? current_worker
+        : m_next_worker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+
+    {
+        // Counted before it is queued so m_queued never goes below zero,
+        // and under m_mutex so a worker about to sleep cannot miss it
+        std::lock_guard lock(m_mutex);
+        m_pending++;
+        m_queued++;
+    }
+
+    {
+        auto& worker = *m_workers[index];
+        std::lock_guard lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+
+    m_task_condition.notify_one();
+}
+
+auto ThreadPool::wait() -> void
+{
+    std::unique_lock lock(m_mutex);
+    m_idle_condition.wait(lock, [this] { return m_pending == 0; });
+}
+
+auto ThreadPool::run(const size_t index) -> void
+{
+    current_pool = this;
+    current_worker = index;
+
+    while (true)
+    {
+        if (auto task = pop(index))
+        {
+            m_queued--;
+
+            task();
+
+            std::lock_guard lock(m_mutex);
+            if (--m_pending == 0)
+            {
+                m_idle_condition.notify_all();
+            }
+
+            continue;
+        }
+
+        std::unique_lock lock(m_mutex);
+        m_task_condition.wait(lock, [this] { return m_stopping || m_queued > 0; });
+
+        if (m_stopping && m_queued == 0)
+        {
+            return;
+        }
+    }
+}
+
+auto ThreadPool::pop(const size_t index) -> Task
+{
+    {
+        auto& own = *m_workers[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            auto task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return task;
+        }
+    }
+
+    for (size_t i = 1; i < m_workers.size(); i++)
+    {
+        auto& victim = *m_workers[(index + i) % m_workers.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            auto task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return task;
+        }
+    }
+
+    return {};
+}
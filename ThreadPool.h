@@ -0,0 +1,61 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker pops its own deque from the back and,
+// when empty, steals from the front of the others. Tasks submitted from a
+// worker go to its own deque, the others are spread round-robin.
+class ThreadPool {
+    using Task = std::function<void()>;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+
+    std::atomic<size_t> m_queued{0};
+    std::atomic<size_t> m_next_worker{0};
+
+    std::mutex m_mutex;
+    std::condition_variable m_task_condition;
+    std::condition_variable m_idle_condition;
+    size_t m_pending{0};
+    bool m_stopping{false};
+
+public:
+    explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    [[nodiscard]] auto threadCount() const -> size_t { return m_threads.size(); }
+    // Tasks submitted and not started yet
+    [[nodiscard]] auto queued() const -> size_t { return m_queued.load(std::memory_order_relaxed); }
+
+    auto submit(Task task) -> void;
+
+    // Blocks until every submitted task, and the tasks they submitted, ran
+    auto wait() -> void;
+
+private:
+    auto run(size_t index) -> void;
+    auto pop(size_t index) -> Task;
+};
+
+#endif //THREAD_POOL_H
@@ -0,0 +1,125 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "VariantProfile.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <fmt/format.h>
+
+#include "Logs.h"
+
+auto VariantProfile::load(const std::filesystem::path& path) -> std::optional<VariantProfile>
+{
+    std::ifstream ifs(path);
+    if (!ifs)
+    {
+        APP_ERROR("Unable to read variant profile {}", path.string());
+        return std::nullopt;
+    }
+
+    VariantProfile profile;
+
+    std::string line;
+    for (size_t line_number = 1; std::getline(ifs, line); line_number++)
+    {
+        if (const auto comment = line.find('#'); comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        std::istringstream iss(line);
+        std::string scope;
+        std::string list;
+
+        if (!(iss >> scope))
+        {
+            continue;
+        }
+
+        if (!(iss >> list))
+        {
+            APP_ERROR("{}:{}: No variants for {}", path.string(), line_number, scope);
+            return std::nullopt;
+        }
+
+        std::vector<Catalog::Variant> variants;
+
+        for (size_t start = 0; start <= list.size(); )
+        {
+            auto end = list.find(',', start);
+            if (end == std::string::npos)
+            {
+                end = list.size();
+            }
+
+            const auto variant = parseVariant(std::string_view(list).substr(start, end - start));
+            if (!variant.has_value())
+            {
+                APP_ERROR("{}:{}: Invalid variant {}", path.string(), line_number, list.substr(start, end - start));
+                return std::nullopt;
+            }
+
+            variants.push_back(*variant);
+            start = end + 1;
+        }
+
+        if (scope == "*")
+        {
+            profile.m_default = std::move(variants);
+        }
+        else
+        {
+            profile.m_scopes.insert_or_assign(std::move(scope), std::move(variants));
+        }
+    }
+
+    APP_INFO("Variant profile {}: {} scopes", path.string(), profile.m_scopes.size() + 1);
+
+    return profile;
+}
+
+auto VariantProfile::variantsFor(const std::string& lang_id, const std::string& set_id) const -> const std::vector<Catalog::Variant>&
+{
+    if (m_scopes.empty())
+    {
+        return m_default;
+    }
+
+    if (const auto it = m_scopes.find(fmt::format("{}/{}", lang_id, set_id)); it != m_scopes.end())
+    {
+        return it->second;
+    }
+
+    if (const auto it = m_scopes.find(lang_id); it != m_scopes.end())
+    {
+        return it->second;
+    }
+
+    return m_default;
+}
+
+auto VariantProfile::parseVariant(const std::string_view value) -> std::optional<Catalog::Variant>
+{
+    static constexpr std::array<std::string_view, 2> qualities = {"high", "low"};
+    static constexpr std::array<std::string_view, 3> formats = {"jpg", "png", "webp"};
+
+    const auto dot = value.find('.');
+    if (dot == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+
+    const auto quality = value.substr(0, dot);
+    const auto format = value.substr(dot + 1);
+
+    if (std::ranges::find(qualities, quality) == qualities.end() || std::ranges::find(formats, format) == formats.end())
+    {
+        return std::nullopt;
+    }
+
+    return Catalog::Variant{std::string(quality), std::string(format)};
+}
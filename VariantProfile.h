@@ -0,0 +1,39 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef VARIANT_PROFILE_H
+#define VARIANT_PROFILE_H
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Catalog.h"
+
+// Image variants to download per language or set, read from a file such as:
+//
+//   # scope    variants (<quality>.<format>, the first one goes in the catalog)
+//   *          high.jpg
+//   en         high.webp,low.webp
+//   fr/base1   low.png
+//
+// The most specific scope wins; without a file every card gets high.jpg.
+class VariantProfile {
+    std::vector<Catalog::Variant> m_default{Catalog::Variant{}};
+    // "<lang>" or "<lang>/<set>" -> variants
+    std::unordered_map<std::string, std::vector<Catalog::Variant>> m_scopes;
+
+public:
+    [[nodiscard]] static auto load(const std::filesystem::path& path) -> std::optional<VariantProfile>;
+
+    [[nodiscard]] auto variantsFor(const std::string& lang_id, const std::string& set_id) const -> const std::vector<Catalog::Variant>&;
+
+    // "high.webp" -> {high, webp}, only what TCGdex serves is accepted
+    [[nodiscard]] static auto parseVariant(std::string_view value) -> std::optional<Catalog::Variant>;
+};
+
+#endif //VARIANT_PROFILE_H
@@ -0,0 +1,72 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "Verifier.h"
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+
+#include "Hasher.h"
+#include "Logs.h"
+
+Verifier::Verifier(const size_t threads)
+    : m_threads(std::max<size_t>(threads, 1))
+{
+}
+
+auto Verifier::verify(const std::vector<DatabaseManager::UriMetadata>& entries) const -> std::vector<Mismatch>
+{
+    // One slot per entry, so workers never share anything but the next index
+    std::vector<std::optional<std::string>> reasons(entries.size());
+    std::atomic<size_t> next_index{0};
+
+    const auto worker = [&]
+    {
+        for (size_t i = next_index++; i < entries.size(); i = next_index++)
+        {
+            const auto& entry = entries[i];
+
+            uint64_t size = 0;
+            const auto digest = Hasher::fileDigest(entry.file_path, size);
+
+            if (!digest.has_value())
+            {
+                reasons[i] = "missing";
+            }
+            else if (size != entry.size)
+            {
+                reasons[i] = fmt::format("size {} instead of {}", size, entry.size);
+            }
+            else if (*digest != entry.digest)
+            {
+                reasons[i] = fmt::format("digest {} instead of {}", *digest, entry.digest);
+            }
+        }
+    };
+
+    const auto thread_count = std::min(m_threads, std::max<size_t>(entries.size(), 1));
+
+    APP_INFO("Verifying {} files on {} threads...", entries.size(), thread_count);
+
+    {
+        std::vector<std::jthread> threads;
+        threads.reserve(thread_count);
+        for (size_t t = 0; t < thread_count; t++)
+        {
+            threads.emplace_back(worker);
+        }
+    }
+
+    std::vector<Mismatch> mismatches;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (reasons[i].has_value())
+        {
+            mismatches.push_back({entries[i], *reasons[i]});
+        }
+    }
+
+    return mismatches;
+}
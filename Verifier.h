@@ -0,0 +1,29 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DatabaseManager.h"
+
+// Re-hashes the local store against the digests recorded in uri_metadata.
+class Verifier {
+    size_t m_threads;
+
+public:
+    explicit Verifier(size_t threads = std::thread::hardware_concurrency());
+
+    struct Mismatch {
+        DatabaseManager::UriMetadata uri_metadata;
+        std::string reason;
+    };
+
+    [[nodiscard]] auto verify(const std::vector<DatabaseManager::UriMetadata>& entries) const -> std::vector<Mismatch>;
+};
+
+#endif //VERIFIER_H
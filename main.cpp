@@ -1,339 +1,1293 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <unordered_map>
+#include <unordered_set>
 #include <ranges>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fmt/format.h>
 #include <curl/curl.h>
-#include <rapidjson/document.h>
-#include <rapidjson/istreamwrapper.h>
-#include <rapidjson/error/en.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "Logs.h"
+#include "AllocationCounter.h"
+#include "CardCatalogWriter.h"
+#include "CardSearchIndex.h"
+#include "Catalog.h"
+#include "ChangeFeed.h"
+#include "ControlSocket.h"
 #include "DatabaseManager.h"
 #include "DownloadManager.h"
+#include "GarbageCollector.h"
+#include "Instrumentation.h"
+#include "ObjectStore.h"
+#include "Options.h"
+#include "PackArchive.h"
+#include "RateGovernor.h"
+#include "Shard.h"
+#include "SyncFilter.h"
+#include "ThreadPool.h"
+#include "VariantProfile.h"
+#include "Verifier.h"
+
+// JSON bodies kept compressed as received are stored with a .gz suffix
+auto jsonFileName(const std::string_view name, const bool keep_compressed) -> std::string
+{
+    return keep_compressed ? fmt::format("{}.gz", name) : std::string(name);
+}
 
-std::string sanitizeForPath(std::string filename) {
-    static const std::unordered_map<unsigned char, char> replacements = {
-        {'<', '('},  {'>', ')'},  {':', '-'},
-        {'"', '\''}, {'/', '-'},  {'\\', '-'},
-        {'|', '-'},  {'?', ' '},  {'*', '+'}
-    };
+auto jsonEncoding(const bool keep_compressed) -> DownloadManager::Encoding
+{
+    return keep_compressed ? DownloadManager::Encoding::KeepCompressed : DownloadManager::Encoding::Compressed;
+}
 
-    // Traiter octet par octet, mais préserver les séquences UTF-8
-    for (size_t i = 0; i < filename.size(); ) {
-        // Ne remplacer que les caractères ASCII interdits
-        if (const unsigned char c = filename[i]; c < 128) {
-            if (auto it = replacements.find(c); it != replacements.end()) {
-                filename[i] = it->second;
-            } else if (c < 32) {
-                filename[i] = '_';
-            }
+// Returns the languages whose sets.json has changed
+auto refreshAllSets(const DownloadManager& download_manager, const DatabaseManager& database_manager, ChangeFeed& change_feed, const std::string& api_url, const std::map<std::string, std::string>& languages, const bool keep_compressed) -> std::unordered_set<std::string>
+{
+    APP_INFO("Refreshing all sets...");
 
-            i++;
+    std::vector<DownloadManager::DownloadParameter> parameters;
+    for (const auto& lang_id: languages | std::views::keys)
+    {
+        DownloadManager::DownloadParameter parameter;
+        parameter.uri = fmt::format("{0}/{1}/sets", api_url, Catalog::urlEncode(lang_id));
+        parameter.destination_file_path = fmt::format("data/{0}/{1}", lang_id, jsonFileName("sets.json", keep_compressed));
+        parameter.encoding = jsonEncoding(keep_compressed);
+        parameters.push_back(std::move(parameter));
+    }
+
+    std::unordered_set<std::string> changed_languages;
+
+    for (const auto results = download_manager.download(parameters); const auto& result : results)
+    {
+        if (result.success)
+        {
+            APP_TRACE("{} -> Success ({})",
+                result.url(),
+                result.has_changed ? "Has changed" : "no changes");
+
+            if (result.has_changed)
+            {
+                changed_languages.insert(std::filesystem::path(result.parameter->destination_file_path).parent_path().filename().string());
+                change_feed.recordDownload(database_manager, ChangeFeed::Kind::Sets, result);
+            }
         }
-        // Sauter les séquences UTF-8 multi-octets
-        else if (c >= 128) {
-            if ((c & 0xE0) == 0xC0) i += 2;
-            else if ((c & 0xF0) == 0xE0) i += 3;
-            else if ((c & 0xF8) == 0xF0) i += 4;
-            else i++; // Octet invalide
-        } else {
-            i++;
+        else
+        {
+            APP_TRACE("{} -> ERROR: {}",
+                result.url(),
+                result.error);
         }
     }
 
-    return filename;
+    return changed_languages;
 }
 
-std::string urlEncode(const std::string& value) {
-    std::ostringstream escaped;
-    escaped.fill('0');
-    escaped << std::hex;
-
-    for (const char c : value) {
-        // Garde alphanumérique et quelques caractères spéciaux intacts
-        if (std::isalnum(static_cast<unsigned char>(c)) ||
-            c == '-' || c == '_' || c == '.' || c == '~') {
-            escaped << c;
-            } else {
-                // Encode les autres caractères
-                escaped << std::uppercase;
-                escaped << '%' << std::setw(2)
-                        << static_cast<int>(static_cast<unsigned char>(c));
-                escaped << std::nouppercase;
-            }
+// Sorted names of the subdirectories of path
+auto listDirectories(const std::filesystem::path& path) -> std::vector<std::string>
+{
+    std::vector<std::string> names;
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(path, ec))
+    {
+        if (entry.is_directory())
+        {
+            names.push_back(entry.path().filename().string());
+        }
     }
 
-    return escaped.str();
+    std::ranges::sort(names);
+
+    return names;
 }
 
-auto refreshAllSets(const DownloadManager& download_manager, const std::map<std::string, std::string>& languages) -> void
+// TCGdex URI of a set, the parent of its card images
+auto setUri(const std::string& api_url, const std::string& lang_id, const std::string& set_id) -> std::string
 {
-    APP_INFO("Refreshing all sets...");
+    return fmt::format("{0}/{1}/sets/{2}", api_url, Catalog::urlEncode(lang_id), Catalog::urlEncode(set_id));
+}
+
+struct CardsRefresh {
+    // cards.json paths downloaded again
+    std::unordered_set<std::string> changed_paths;
+    // cards.json paths the server answered 304 for
+    std::unordered_set<std::string> unchanged_paths;
+};
+
+auto refreshAllCards(const DownloadManager& download_manager, const DatabaseManager& database_manager, ChangeFeed& change_feed, ThreadPool& thread_pool, const std::string& api_url, const Shard& shard, const SyncFilter& filter, const bool keep_compressed, const std::optional<std::unordered_set<std::string>>& only_languages = std::nullopt) -> CardsRefresh
+{
+    APP_INFO("Refreshing all cards...");
+
+    auto lang_ids = listDirectories("data");
+
+    std::erase_if(lang_ids, [&shard, &filter](const std::string& lang_id) { return !shard.ownsLanguage(lang_id) || !filter.acceptsLanguage(lang_id); });
+
+    if (only_languages.has_value())
+    {
+        std::erase_if(lang_ids, [&only_languages](const std::string& lang_id) { return !only_languages->contains(lang_id); });
+    }
+
+    // One buffer per language, merged in language order
+    std::vector<std::vector<DownloadManager::DownloadParameter>> language_parameters(lang_ids.size());
+
+    for (size_t i = 0; i < lang_ids.size(); i++)
+    {
+        thread_pool.submit([&lang_id = lang_ids[i], &parameters = language_parameters[i], &api_url, &filter, keep_compressed]
+        {
+            const auto json_set_path = std::filesystem::path("data") / lang_id / jsonFileName("sets.json", keep_compressed);
+
+            if (!std::filesystem::exists(json_set_path))
+            {
+                APP_INFO("{} does not exist", json_set_path.string());
+                return;
+            }
+
+            const auto set_ids = Catalog::readSetIds(json_set_path);
+            if (!set_ids.has_value())
+            {
+                return;
+            }
+
+            // Series and release dates of the known sets, new sets are always fetched
+            CardCatalogReader previous_catalog;
+            if (filter.needsSetDetails())
+            {
+                previous_catalog.open(CardCatalogWriter::catalogPath(lang_id).string());
+            }
+
+            parameters.reserve(set_ids->size());
+
+            for (const auto& set_id : *set_ids)
+            {
+                if (!filter.acceptsSetId(set_id))
+                {
+                    continue;
+                }
+
+                if (const auto* previous_set = previous_catalog.isOpen() ? previous_catalog.findSet(set_id) : nullptr;
+                    previous_set && !filter.acceptsSetDetails(previous_catalog.string(previous_set->serie_id), previous_catalog.string(previous_set->release_date)))
+                {
+                    continue;
+                }
+
+                DownloadManager::DownloadParameter parameter;
+                parameter.uri = setUri(api_url, lang_id, set_id);
+                parameter.destination_file_path = fmt::format("data/{0}/{1}/{2}", lang_id, set_id, jsonFileName("cards.json", keep_compressed));
+                parameter.encoding = jsonEncoding(keep_compressed);
+                parameters.push_back(std::move(parameter));
+            }
+        });
+    }
+
+    thread_pool.wait();
 
     std::vector<DownloadManager::DownloadParameter> parameters;
-    for (const auto& lang_id: languages | std::views::keys)
+
+    for (auto& buffer : language_parameters)
     {
-        parameters.push_back(DownloadManager::DownloadParameter {
-            fmt::format("https://api.tcgdex.net/v2/{0}/sets", urlEncode(lang_id)),
-            fmt::format("data/{0}/sets.json", lang_id)}
-            );
+        std::ranges::move(buffer, std::back_inserter(parameters));
     }
 
+    CardsRefresh cards_refresh;
+
     for (const auto results = download_manager.download(parameters); const auto& result : results)
     {
         if (result.success)
         {
             APP_TRACE("{} -> Success ({})",
-                result.effective_url,
+                result.url(),
                 result.has_changed ? "Has changed" : "no changes");
+
+            (result.has_changed ? cards_refresh.changed_paths : cards_refresh.unchanged_paths).insert(result.parameter->destination_file_path);
+            change_feed.recordDownload(database_manager, ChangeFeed::Kind::Cards, result);
         }
         else
         {
             APP_TRACE("{} -> ERROR: {}",
-                result.effective_url,
+                result.url(),
                 result.error);
         }
     }
+
+    return cards_refresh;
 }
 
-auto refreshAllCards(const DownloadManager& download_manager) -> void
+// With changed_only, the sets whose cards.json did not change and that are
+// already in the catalog are neither parsed nor downloaded again. Sets left
+// out by the filter are copied from the previous catalog. A shard only
+// downloads its images and leaves the catalogs to the merge.
+// The images of a set whose cards.json answered 304 are not requested when
+// they were validated under the same cards.json ETag less than
+// revalidate_after ago (0 requests them all).
+// With a garbage collector, the images a parsed set no longer lists are swept
+// once the catalogs are written.
+// Returns the number of images that changed
+auto downloadCards(const DownloadManager& download_manager, const DatabaseManager& database_manager, ChangeFeed& change_feed, const GarbageCollector* garbage_collector, ThreadPool& thread_pool, const std::string& api_url, const VariantProfile& variant_profile, const Shard& shard, const SyncFilter& filter, const CardsRefresh& cards_refresh, const std::chrono::seconds revalidate_after, const bool changed_only, const bool pack, const bool keep_compressed) -> size_t
 {
     APP_INFO("Refreshing all cards...");
 
-    std::vector<DownloadManager::DownloadParameter> parameters;
+    struct SetPlan {
+        std::string set_id;
+        // Copied from the previous catalog, without parsing nor downloading
+        bool kept = false;
+        std::optional<Catalog::Set> set;
+        std::vector<DownloadManager::DownloadParameter> parameters;
+        // Images left out because their cards.json did not change
+        size_t skipped = 0;
+        // Images recorded under the cards.json that it no longer lists, or under another name
+        std::vector<GarbageCollector::Orphan> orphans;
+    };
 
-    for (const auto data_path = std::filesystem::path("data"); const auto& language_directory : std::filesystem::directory_iterator(data_path))
-    {
-        auto lang_id = language_directory.path().filename().string();
+    struct LanguagePlan {
+        std::string lang_id;
+        CardCatalogWriter catalog_writer;
+        std::vector<SetPlan> sets;
+    };
 
-        auto json_set_path = language_directory.path() / "sets.json";
+    // Every set is parsed by the pool into its own slot, slots are merged in
+    // language then set order so the plan does not depend on scheduling
+    std::vector<LanguagePlan> languages;
 
-        if (!std::filesystem::exists(json_set_path))
+    for (auto& lang_id : listDirectories("data"))
+    {
+        if (!shard.ownsLanguage(lang_id) || !filter.acceptsLanguage(lang_id))
         {
-            APP_INFO("{} does not exist", json_set_path.string());
             continue;
         }
 
-        APP_TRACE("{}: Read json file for lang id {}...", json_set_path.string(), lang_id);
+        CardCatalogWriter catalog_writer(lang_id);
+        languages.push_back({std::move(lang_id), std::move(catalog_writer), {}});
+    }
+
+    for (auto& language : languages)
+    {
+        thread_pool.submit([&]
+        {
+            for (auto& set_id : listDirectories(std::filesystem::path("data") / language.lang_id))
+            {
+                auto& set_plan = language.sets.emplace_back();
+                set_plan.set_id = std::move(set_id);
+            }
+
+            for (auto& set_plan : language.sets)
+            {
+                thread_pool.submit([&, &lang_id = language.lang_id, &catalog_writer = language.catalog_writer]
+                {
+                    const auto json_cards_path = std::filesystem::path("data") / lang_id / set_plan.set_id / jsonFileName("cards.json", keep_compressed);
+
+                    const auto& previous_catalog = catalog_writer.previous();
+                    const auto* previous_set = previous_catalog.isOpen() ? previous_catalog.findSet(set_plan.set_id) : nullptr;
+
+                    if (!filter.acceptsSetId(set_plan.set_id) ||
+                        (previous_set && !filter.acceptsSetDetails(previous_catalog.string(previous_set->serie_id), previous_catalog.string(previous_set->release_date))))
+                    {
+                        set_plan.kept = previous_set != nullptr;
+                        return;
+                    }
+
+                    if (changed_only && !cards_refresh.changed_paths.contains(json_cards_path.string()) &&
+                        !catalog_writer.needsParsedSet(set_plan.set_id, false, variant_profile.variantsFor(lang_id, set_plan.set_id).front()))
+                    {
+                        set_plan.kept = true;
+                        return;
+                    }
+
+                    if (!std::filesystem::exists(json_cards_path))
+                    {
+                        APP_INFO("{} does not exist", json_cards_path.string());
+                        return;
+                    }
+
+                    set_plan.set = Catalog::readSet(json_cards_path, lang_id, set_plan.set_id);
+                    if (!set_plan.set.has_value())
+                    {
+                        return;
+                    }
+
+                    // Sets new to the catalog are only known once parsed
+                    if (!filter.acceptsSetDetails(set_plan.set->serie_id, set_plan.set->release_date))
+                    {
+                        set_plan.kept = previous_set != nullptr;
+                        set_plan.set.reset();
+                        return;
+                    }
+
+                    // All the variants go in the same download, so they share the multiplexed connection
+                    const auto& variants = variant_profile.variantsFor(lang_id, set_plan.set_id);
+
+                    set_plan.parameters.reserve(set_plan.set->cards.size() * variants.size());
+
+                    // Images are recorded with the cards.json ETag they were listed under
+                    auto parent_uri = setUri(api_url, lang_id, set_plan.set_id);
+                    const auto parent = database_manager.getUriMetadata(parent_uri);
+                    const auto parent_etag = parent.has_value() ? parent->etag : std::string();
+
+                    const bool parent_unchanged = revalidate_after.count() > 0 && !parent_etag.empty() &&
+                                                  cards_refresh.unchanged_paths.contains(json_cards_path.string());
+                    const auto validated_since = std::chrono::duration_cast<std::chrono::seconds>(
+                        (std::chrono::system_clock::now() - revalidate_after).time_since_epoch()).count();
+
+                    GarbageCollector::Mark mark;
+
+                    for (const auto& card : set_plan.set->cards)
+                    {
+                        for (const auto& variant : variants)
+                        {
+                            auto uri = Catalog::imageUri(card, variant);
+
+                            if (!shard.ownsImage(lang_id, uri))
+                            {
+                                continue;
+                            }
+
+                            auto destination = Catalog::imagePath(*set_plan.set, card, variant);
+
+                            if (garbage_collector)
+                            {
+                                mark.uris.insert(uri);
+                                mark.paths.insert(destination);
+                            }
+
+                            if (parent_unchanged)
+                            {
+                                if (const auto image = database_manager.getUriMetadata(uri);
+                                    image.has_value() && image->parent_uri == parent_uri && image->parent_etag == parent_etag &&
+                                    image->validated_at >= validated_since &&
+                                    (pack ? database_manager.getPackEntry(uri).has_value() : std::filesystem::exists(destination)))
+                                {
+                                    set_plan.skipped++;
+                                    continue;
+                                }
+                            }
+
+                            set_plan.parameters.push_back(DownloadManager::DownloadParameter {
+                                                    std::move(uri),
+                                                    std::move(destination),
+                                                    pack ? shard.packGroup(lang_id) : "",
+                                                    DownloadManager::Encoding::Identity,
+                                                    parent_uri,
+                                                    parent_etag}
+                                                    );
+                        }
+                    }
+
+                    if (garbage_collector)
+                    {
+                        set_plan.orphans = garbage_collector->findOrphans(parent_uri, mark);
+                    }
+                });
+            }
+        });
+    }
 
-        std::ifstream ifs(json_set_path.string());
-        rapidjson::IStreamWrapper isw(ifs);
-        rapidjson::Document doc;
+    thread_pool.wait();
 
-        doc.ParseStream(isw);
+    std::vector<DownloadManager::DownloadParameter> parameters;
+    size_t skipped_images = 0;
 
-        if (doc.HasParseError()) {
-            APP_ERROR("{}: Does not have valid JSON, removing file !", json_set_path.string());
-            APP_ERROR("  Reason: {}", rapidjson::GetParseError_En(doc.GetParseError()));
-            APP_ERROR("  At: {}", doc.GetErrorOffset());
-            APP_ERROR("  -> Removing file !", json_set_path.string());
+    for (auto& language : languages)
+    {
+        auto& catalog_writer = language.catalog_writer;
 
-            ifs.close();
+        for (auto& set_plan : language.sets)
+        {
+            skipped_images += set_plan.skipped;
 
-            std::filesystem::remove(json_set_path);
+            if (set_plan.kept)
+            {
+                catalog_writer.keepSet(set_plan.set_id);
+                continue;
+            }
 
-            continue;
+            if (!set_plan.set.has_value())
+            {
+                continue;
+            }
+
+            std::ranges::move(set_plan.parameters, std::back_inserter(parameters));
+
+            const auto json_cards_path = fmt::format("data/{0}/{1}/{2}", language.lang_id, set_plan.set_id, jsonFileName("cards.json", keep_compressed));
+
+            const auto& catalog_variant = variant_profile.variantsFor(language.lang_id, set_plan.set_id).front();
+
+            if (catalog_writer.needsParsedSet(set_plan.set_id, cards_refresh.changed_paths.contains(json_cards_path), catalog_variant))
+            {
+                catalog_writer.addSet(std::move(*set_plan.set), catalog_variant);
+            }
+            else
+            {
+                catalog_writer.keepSet(set_plan.set_id);
+            }
         }
+    }
+
+    APP_INFO("Planned {} images from {} languages on {} threads, {} skipped as their cards.json did not change", parameters.size(), languages.size(), thread_pool.threadCount(), skipped_images);
 
-        if (!doc.IsArray())
+    // Image path -> digest of the images downloaded again
+    std::unordered_map<std::string, std::string> changed_image_digests;
+    size_t changed_images = 0;
+
+    for (const auto results = download_manager.download(parameters); const auto& result : results)
+    {
+        if (result.success)
         {
-            APP_ERROR("{}: Root is not an array, removing file !", json_set_path.string());
+            APP_TRACE("{} -> Success ({})",
+                result.url(),
+                result.has_changed ? "Has changed" : "no changes");
 
-            ifs.close();
+            if (result.has_changed)
+            {
+                changed_images++;
 
-            std::filesystem::remove(json_set_path);
+                const auto uri_metadata = database_manager.getUriMetadata(result.parameter->uri);
+                if (uri_metadata.has_value())
+                {
+                    changed_image_digests.emplace(result.parameter->destination_file_path, uri_metadata->digest);
+                }
 
-            continue;
+                change_feed.recordDownload(database_manager, ChangeFeed::Kind::Image, result, uri_metadata.has_value() ? &*uri_metadata : nullptr);
+            }
+        }
+        else
+        {
+            APP_TRACE("{} -> ERROR: {}",
+                result.url(),
+                result.error);
+        }
+    }
+
+    if (shard.isSharded())
+    {
+        return changed_images;
+    }
+
+    APP_INFO("Writing card catalogs...");
+
+    for (auto& language : languages)
+    {
+        if (!language.catalog_writer.write(database_manager, changed_image_digests, &change_feed))
+        {
+            APP_ERROR("Unable to write card catalog for {}", language.lang_id);
         }
+    }
 
-        APP_TRACE("{}: Have {} sets", json_set_path.string(), doc.Size());
+    if (garbage_collector)
+    {
+        std::vector<GarbageCollector::Orphan> orphans;
 
-        for (const auto& set: doc.GetArray())
+        for (auto& language : languages)
         {
-            if (!set.IsObject() || !set.HasMember("id") || !set["id"].IsString())
+            for (auto& set_plan : language.sets)
             {
-                APP_ERROR("{}: Invalid set format, removing file !", json_set_path.string());
+                std::ranges::move(set_plan.orphans, std::back_inserter(orphans));
+            }
+        }
 
-                ifs.close();
+        garbage_collector->sweep(orphans, &change_feed);
+    }
 
-                std::filesystem::remove(json_set_path);
+    return changed_images;
+}
 
-                continue;
-            }
+auto verifyStore(const DatabaseManager& database_manager, const DownloadManager& download_manager, const ObjectStore& object_store, ChangeFeed& change_feed) -> void
+{
+    APP_INFO("Verifying local store...");
+
+    std::vector<DownloadManager::DownloadParameter> parameters;
+
+    for (const auto& [uri_metadata, reason] : Verifier().verify(database_manager.listHashedUriMetadata()))
+    {
+        APP_WARN("{}: {}, queued for download", uri_metadata.file_path, reason);
+
+        // Drop the corrupted copy so the server cannot answer 304 for it
+        std::error_code ec;
+        std::filesystem::remove(uri_metadata.file_path, ec);
 
-            std::string set_id = set["id"].GetString();
+        if (const auto blob = database_manager.getBlob(uri_metadata.uri); blob.has_value())
+        {
+            std::filesystem::remove(object_store.objectPath(blob->digest), ec);
+        }
 
-            APP_TRACE("{}: set id {}", json_set_path.string(), set_id);
+        // Fetched again as the sync fetched it, under the same cards.json
+        DownloadManager::DownloadParameter parameter;
+        parameter.uri = uri_metadata.uri;
+        parameter.destination_file_path = uri_metadata.file_path;
+        parameter.parent_uri = uri_metadata.parent_uri;
+        parameter.parent_etag = uri_metadata.parent_etag;
 
-            parameters.push_back(DownloadManager::DownloadParameter {
-                        fmt::format("https://api.tcgdex.net/v2/{0}/sets/{1}", urlEncode(lang_id), urlEncode(set_id)),
-                        fmt::format("data/{0}/{1}/cards.json", lang_id, set_id)}
-                        );
+        if (uri_metadata.file_path.ends_with(".json.gz"))
+        {
+            parameter.encoding = DownloadManager::Encoding::KeepCompressed;
         }
+        else if (uri_metadata.file_path.ends_with(".json"))
+        {
+            parameter.encoding = DownloadManager::Encoding::Compressed;
+        }
+
+        parameters.push_back(std::move(parameter));
     }
 
+    APP_INFO("{} files to download again", parameters.size());
+
     for (const auto results = download_manager.download(parameters); const auto& result : results)
     {
         if (result.success)
         {
             APP_TRACE("{} -> Success ({})",
-                result.effective_url,
+                result.url(),
                 result.has_changed ? "Has changed" : "no changes");
+
+            change_feed.recordDownload(database_manager, ChangeFeed::Kind::Image, result);
         }
         else
         {
             APP_TRACE("{} -> ERROR: {}",
-                result.effective_url,
+                result.url(),
                 result.error);
         }
     }
 }
 
-auto downloadCards(const DownloadManager& download_manager) -> void
+auto writePackIndexes(const DatabaseManager& database_manager, const PackArchive& pack_archive) -> void
 {
-    APP_INFO("Refreshing all cards...");
+    for (const auto& group : pack_archive.groups())
+    {
+        if (!pack_archive.writeIndex(group, database_manager.listPackEntries(group)))
+        {
+            APP_ERROR("Unable to write pack index for {}", group);
+        }
+    }
+}
 
-    std::vector<DownloadManager::DownloadParameter> parameters;
+auto compactPacks(const DatabaseManager& database_manager, PackArchive& pack_archive) -> void
+{
+    APP_INFO("Compacting packs...");
 
-    for (const auto data_path = std::filesystem::path("data"); const auto& language_directory : std::filesystem::directory_iterator(data_path))
+    for (const auto& group : pack_archive.groups())
     {
-        auto lang_id = language_directory.path().filename().string();
+        auto entries = database_manager.listPackEntries(group);
 
-        for (const auto& set_directory : std::filesystem::directory_iterator(language_directory))
+        if (!pack_archive.compact(group, entries))
         {
-            auto set_id = set_directory.path().filename().string();
+            APP_ERROR("Unable to compact {}", group);
+            continue;
+        }
 
-            auto json_cards_path = set_directory.path() / "cards.json";
+        // Previous generations stay until the new offsets are committed
+        if (!database_manager.beginTransaction())
+        {
+            pack_archive.abandonCompaction(group);
+            continue;
+        }
 
-            if (!std::filesystem::exists(json_cards_path))
+        const bool updated = std::ranges::all_of(entries, [&database_manager](const auto& entry)
+        {
+            if (!database_manager.upsertPackEntry(entry))
             {
-                APP_INFO("{} does not exist", json_cards_path.string());
-                continue;
+                APP_ERROR("Unable to update pack entry {}", entry.uri);
+                return false;
             }
+            return true;
+        });
 
-            APP_TRACE("{}: Read json file for lang id {} and set id {}...", json_cards_path.string(), lang_id, set_id);
+        if (!updated || !database_manager.commit())
+        {
+            // The rows still point into the previous generations
+            database_manager.rollback();
+            pack_archive.abandonCompaction(group);
+            APP_ERROR("Unable to compact {}", group);
+            continue;
+        }
 
-            std::ifstream ifs(json_cards_path.string());
-            rapidjson::IStreamWrapper isw(ifs);
-            rapidjson::Document doc;
+        pack_archive.removeInactivePacks(group);
 
-            doc.ParseStream(isw);
+        if (!pack_archive.writeIndex(group, entries))
+        {
+            APP_ERROR("Unable to write pack index for {}", group);
+        }
+    }
+}
 
-            if (doc.HasParseError()) {
-                APP_ERROR("{}: Does not have valid JSON, removing file !", json_cards_path.string());
-                APP_ERROR("  Reason: {}", rapidjson::GetParseError_En(doc.GetParseError()));
-                APP_ERROR("  At: {}", doc.GetErrorOffset());
-                APP_ERROR("  -> Removing file !", json_cards_path.string());
+// Rewrites every catalog from the local JSON and uri_metadata, after a merge
+auto rebuildCatalogs(const DatabaseManager& database_manager, ChangeFeed& change_feed, ThreadPool& thread_pool, const VariantProfile& variant_profile, const bool keep_compressed) -> void
+{
+    APP_INFO("Writing card catalogs...");
 
-                ifs.close();
+    std::vector<CardCatalogWriter> catalog_writers;
 
-                std::filesystem::remove(json_cards_path);
+    for (auto& lang_id : listDirectories("data"))
+    {
+        catalog_writers.emplace_back(std::move(lang_id));
+    }
 
-                continue;
-            }
+    for (auto& catalog_writer : catalog_writers)
+    {
+        thread_pool.submit([&]
+        {
+            const auto& lang_id = catalog_writer.langId();
 
-            if (!doc.IsObject())
+            for (const auto& set_id : listDirectories(std::filesystem::path("data") / lang_id))
             {
-                APP_ERROR("{}: Root is not an object, removing file !", json_cards_path.string());
-
-                ifs.close();
+                const auto json_cards_path = std::filesystem::path("data") / lang_id / set_id / jsonFileName("cards.json", keep_compressed);
 
-                std::filesystem::remove(json_cards_path);
+                if (!std::filesystem::exists(json_cards_path))
+                {
+                    continue;
+                }
 
-                continue;
+                if (auto set = Catalog::readSet(json_cards_path, lang_id, set_id); set.has_value())
+                {
+                    catalog_writer.addSet(std::move(*set), variant_profile.variantsFor(lang_id, set_id).front());
+                }
             }
+        });
+    }
 
-            if (!doc.HasMember("cards") || !doc["cards"].IsArray())
-            {
-                APP_ERROR("{}: No cards members found, removing file !", json_cards_path.string());
+    thread_pool.wait();
 
-                ifs.close();
+    // Digests are read from the database, one catalog at a time
+    for (auto& catalog_writer : catalog_writers)
+    {
+        if (!catalog_writer.write(database_manager, {}, &change_feed))
+        {
+            APP_ERROR("Unable to write card catalog for {}", catalog_writer.langId());
+        }
+    }
+}
 
-                std::filesystem::remove(json_cards_path);
+// The last run of every shard goes to the change feed
+auto mergeShards(const DatabaseManager& database_manager, ChangeFeed& change_feed, const std::vector<std::string>& shard_paths) -> bool
+{
+    if (!database_manager.beginMerge())
+    {
+        APP_ERROR("Unable to start merging the shards");
+        return false;
+    }
 
-                continue;
-            }
+    bool merged_all = true;
 
-            auto cards = doc["cards"].GetArray();
+    for (const auto& shard_path : shard_paths)
+    {
+        if (!std::filesystem::exists(shard_path))
+        {
+            APP_ERROR("{} does not exist", shard_path);
+            merged_all = false;
+            continue;
+        }
+
+        auto result = database_manager.mergeShard(shard_path);
+        if (!result.has_value())
+        {
+            APP_ERROR("Unable to merge {}", shard_path);
+            merged_all = false;
+            continue;
+        }
 
-            APP_TRACE("{}: Have {} cards", json_cards_path.string(), cards.Size());
+        for (const auto& conflict : result->conflicts)
+        {
+            APP_WARN("{}: conflict in {}, kept etag {} digest {}, ignored etag {} digest {}",
+                conflict.uri,
+                shard_path,
+                conflict.etag,
+                conflict.digest,
+                conflict.shard_etag,
+                conflict.shard_digest);
+        }
+
+        for (auto& change : result->changes)
+        {
+            change_feed.record(std::move(change));
+        }
+
+        APP_INFO("{}: {} uris merged, {} conflicts, {} changes", shard_path, result->merged, result->conflicts.size(), result->changes.size());
+    }
+
+    database_manager.endMerge();
+
+    return merged_all;
+}
+
+// Runs the same command once per shard with --shard <i>/<workers>, exactly as
+// separate hosts would, and returns the shard databases to merge
+auto runWorkers(const int argc, char* argv[], const Options& options) -> std::optional<std::vector<std::string>>
+{
+    std::vector<std::string> arguments;
+
+    // The limits are shared by the workers, each one gets its part of them
+    static constexpr std::string_view shared_flags[] = {"--workers", "--max-requests", "--max-bandwidth", "--host-requests", "--host-bandwidth"};
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::ranges::find(shared_flags, std::string_view(argv[i])) != std::end(shared_flags))
+        {
+            i++;
+            continue;
+        }
+
+        arguments.emplace_back(argv[i]);
+    }
 
-            size_t card_index = 0;
-            for (const auto& card: cards)
+    const auto share = [&options](const auto limit)
+    {
+        return limit / static_cast<decltype(limit)>(options.workers);
+    };
+
+    const auto add_limit = [&arguments](const char* flag, const auto limit)
+    {
+        // Never 0, which would lift the limit
+        if (limit > 0)
+        {
+            arguments.emplace_back(flag);
+            arguments.push_back(fmt::format("{}", limit));
+        }
+    };
+
+    add_limit("--max-requests", share(options.limits.requests));
+    add_limit("--max-bandwidth", std::max<uint64_t>(share(options.limits.bytes), options.limits.bytes > 0 ? 1 : 0));
+    add_limit("--host-requests", share(options.limits.host_requests));
+    add_limit("--host-bandwidth", std::max<uint64_t>(share(options.limits.host_bytes), options.limits.host_bytes > 0 ? 1 : 0));
+
+    std::vector<std::pair<Shard, pid_t>> workers;
+    bool succeeded = true;
+
+    for (unsigned index = 0; index < options.workers; index++)
+    {
+        const Shard shard(index, options.workers, options.shard.key());
+
+        auto worker_arguments = arguments;
+        worker_arguments.emplace_back("--shard");
+        worker_arguments.push_back(fmt::format("{}/{}", index, options.workers));
+
+        std::vector<char*> worker_argv;
+        worker_argv.push_back(argv[0]);
+        for (auto& argument : worker_arguments)
+        {
+            worker_argv.push_back(argument.data());
+        }
+        worker_argv.push_back(nullptr);
+
+        pid_t pid = 0;
+        if (const int rc = posix_spawnp(&pid, argv[0], nullptr, nullptr, worker_argv.data(), environ); rc != 0)
+        {
+            APP_ERROR("Unable to start worker {}: {}", shard.name(), std::strerror(rc));
+            succeeded = false;
+            break;
+        }
+
+        APP_INFO("Worker {} started (pid {})", shard.name(), pid);
+
+        workers.emplace_back(shard, pid);
+    }
+
+    std::vector<std::string> shard_paths;
+
+    for (const auto& [shard, pid] : workers)
+    {
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+        {
+            APP_ERROR("Worker {} failed", shard.name());
+            succeeded = false;
+            continue;
+        }
+
+        shard_paths.push_back(shard.databasePath());
+    }
+
+    if (!succeeded)
+    {
+        return std::nullopt;
+    }
+
+    return shard_paths;
+}
+
+auto searchCards(const Options& options) -> bool
+{
+    CardSearchIndex index("catalog");
+
+    const auto load_start = std::chrono::steady_clock::now();
+    if (!index.load())
+    {
+        APP_ERROR("No card catalog found in {}, run a sync first", "catalog");
+        return false;
+    }
+    const auto load_end = std::chrono::steady_clock::now();
+
+    APP_INFO("Loaded {} cards in {} languages in {} ms: {} KiB in memory, {} KiB mapped",
+        index.cardCount(),
+        index.languages().size(),
+        std::chrono::duration_cast<std::chrono::milliseconds>(load_end - load_start).count(),
+        index.memoryUsage() / 1024,
+        index.mappedSize() / 1024);
+
+    std::vector<CardSearchIndex::Match> matches;
+
+    const auto search_start = std::chrono::steady_clock::now();
+    if (options.card)
+    {
+        const auto separator = options.query.find('/');
+        if (const auto match = index.find(options.filter.languages.front(), std::string_view(options.query).substr(0, separator), std::string_view(options.query).substr(separator + 1)); match.has_value())
+        {
+            matches.push_back(*match);
+        }
+    }
+    else
+    {
+        matches = index.findByPrefix(options.query, options.filter.languages);
+    }
+    const auto search_end = std::chrono::steady_clock::now();
+
+    for (const auto& match : matches)
+    {
+        fmt::print("{}\t{}/{}\t{}\t{}\n", match.lang_id, match.set_id, match.local_id, match.name, match.image_path);
+    }
+
+    APP_INFO("{} matches in {} us",
+        matches.size(),
+        std::chrono::duration_cast<std::chrono::microseconds>(search_end - search_start).count());
+
+    return true;
+}
+
+namespace {
+    std::atomic<bool> stop_requested{false};
+
+    auto onStopSignal(int) -> void
+    {
+        stop_requested = true;
+    }
+}
+
+// Sync loop of the daemon mode. The database, the download manager (its
+// connections and caches) and the search index stay alive between cycles.
+// The first cycle checks everything, the next ones only check the cards.json
+// of the languages whose sets.json changed and only plan the sets whose
+// cards.json changed.
+auto runDaemon(const Options& options, DatabaseManager& database_manager, const DownloadManager& download_manager, ChangeFeed& change_feed, const GarbageCollector* garbage_collector, const PackArchive& pack_archive, const VariantProfile& variant_profile, const std::map<std::string, std::string>& languages) -> bool
+{
+    struct Status {
+        std::string state = "starting";
+        size_t cycles = 0;
+        int64_t last_started = 0;
+        int64_t last_finished = 0;
+        int64_t last_duration_ms = 0;
+        size_t changed_languages = 0;
+        size_t changed_sets = 0;
+        size_t changed_images = 0;
+        int64_t next_run = 0;
+    };
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    Status status;
+    bool sync_requested = false;
+    std::shared_ptr<const CardSearchIndex> index;
+
+    const auto unix_time = [](const std::chrono::system_clock::time_point time)
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+    };
+
+    const auto load_index = [&mutex, &index]
+    {
+        auto loaded = std::make_shared<CardSearchIndex>("catalog");
+        if (!loaded->load())
+        {
+            return;
+        }
+
+        const std::lock_guard lock(mutex);
+        index = std::move(loaded);
+    };
+
+    ThreadPool planning_pool;
+
+    // Samples the resources while the daemon runs, status takes a sample of its own
+    Instrumentation instrumentation(options.shard, std::chrono::seconds(options.metrics_interval), download_manager, database_manager, &planning_pool);
+
+    // status | sync | search <name prefix> | limit [<name> <value>], answered with one JSON line
+    ControlSocket control_socket(options.socket_path, [&](const std::string_view command) -> std::string
+    {
+        rapidjson::StringBuffer buffer;
+        rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+
+        const auto write_limits = [&writer, &download_manager]
+        {
+            const auto limits = download_manager.rateLimits();
+
+            writer.Key("limits");
+            writer.StartObject();
+            writer.Key("maxRequests"); writer.Double(limits.requests);
+            writer.Key("maxBandwidth"); writer.Uint64(limits.bytes);
+            writer.Key("hostRequests"); writer.Double(limits.host_requests);
+            writer.Key("hostBandwidth"); writer.Uint64(limits.host_bytes);
+            writer.EndObject();
+        };
+
+        writer.StartObject();
+
+        if (command.starts_with("search "))
+        {
+            std::shared_ptr<const CardSearchIndex> current;
             {
-                card_index++;
+                const std::lock_guard lock(mutex);
+                current = index;
+            }
 
-                if (!card.IsObject() || !card.HasMember("localId") || !card["localId"].IsString())
+            const auto string = [&writer](const std::string_view value)
+            {
+                writer.String(value.data(), static_cast<rapidjson::SizeType>(value.size()));
+            };
+
+            writer.Key("cards");
+            writer.StartArray();
+            if (current)
+            {
+                for (const auto& match : current->findByPrefix(command.substr(7)))
                 {
-                    APP_ERROR("{}: No localId card definition for card index {}", json_cards_path.string(), card_index);
-                    continue;
+                    writer.StartObject();
+                    writer.Key("lang"); string(match.lang_id);
+                    writer.Key("set"); string(match.set_id);
+                    writer.Key("localId"); string(match.local_id);
+                    writer.Key("name"); string(match.name);
+                    writer.Key("image"); string(match.image_path);
+                    writer.EndObject();
                 }
+            }
+            writer.EndArray();
+        }
+        else if (command == "limit" || command.starts_with("limit "))
+        {
+            // limit <max-requests|max-bandwidth|host-requests|host-bandwidth> <value>, 0 lifts it
+            if (command != "limit")
+            {
+                auto limits = download_manager.rateLimits();
 
-                std::string local_id = card["localId"].GetString();
+                const auto arguments = command.substr(6);
+                const auto separator = arguments.find(' ');
+                const auto name = arguments.substr(0, separator);
+                const auto value = separator == std::string_view::npos ? std::string_view() : arguments.substr(separator + 1);
 
-                if (!card.IsObject() || !card.HasMember("name") || !card["name"].IsString())
+                bool valid = true;
+                if (name == "max-requests" || name == "host-requests")
                 {
-                    APP_ERROR("{}: No name card definition for card index {}", json_cards_path.string(), card_index);
-                    continue;
+                    const auto requests = RateGovernor::parseRequests(value);
+                    valid = requests.has_value();
+                    (name == "max-requests" ? limits.requests : limits.host_requests) = requests.value_or(0);
+                }
+                else if (name == "max-bandwidth" || name == "host-bandwidth")
+                {
+                    const auto bytes = RateGovernor::parseBytes(value);
+                    valid = bytes.has_value();
+                    (name == "max-bandwidth" ? limits.bytes : limits.host_bytes) = bytes.value_or(0);
+                }
+                else
+                {
+                    valid = false;
                 }
 
-                std::string name = card["name"].GetString();
-
-                if (!card.IsObject() || !card.HasMember("image") || !card["image"].IsString())
+                if (!valid)
                 {
-                    APP_WARN("{}: No image card definition for card index {}", json_cards_path.string(), card_index);
-                    continue;
+                    writer.Key("error"); writer.String("expected limit <max-requests|max-bandwidth|host-requests|host-bandwidth> <value>");
+                    writer.EndObject();
+                    return buffer.GetString();
                 }
 
-                std::string image = card["image"].GetString();
+                download_manager.setRateLimits(limits);
+                APP_INFO("Rate limits changed: {} {}", name, value);
+            }
+
+            write_limits();
+        }
+        else if (command == "sync" || command == "status" || command.empty())
+        {
+            const std::lock_guard lock(mutex);
 
-                parameters.push_back(DownloadManager::DownloadParameter {
-                                        fmt::format("{0}/high.jpg", image),
-                                        fmt::format("data/{0}/{1}/{2}_high_{3}.jpg", lang_id, set_id, local_id, sanitizeForPath(name))}
-                                        );
+            if (command == "sync")
+            {
+                sync_requested = true;
+                condition.notify_all();
             }
+
+            writer.Key("state"); writer.String(status.state.c_str());
+            writer.Key("cycles"); writer.Uint64(status.cycles);
+            writer.Key("lastStarted"); writer.Int64(status.last_started);
+            writer.Key("lastFinished"); writer.Int64(status.last_finished);
+            writer.Key("lastDurationMs"); writer.Int64(status.last_duration_ms);
+            writer.Key("changedLanguages"); writer.Uint64(status.changed_languages);
+            writer.Key("changedSets"); writer.Uint64(status.changed_sets);
+            writer.Key("changedImages"); writer.Uint64(status.changed_images);
+            writer.Key("nextRun"); writer.Int64(status.next_run);
+            writer.Key("cards"); writer.Uint64(index ? index->cardCount() : 0);
+
+            const auto allocations = AllocationCounter::process();
+            writer.Key("allocations"); writer.Uint64(allocations.allocations);
+            writer.Key("curlAllocations"); writer.Uint64(allocations.curl_allocations);
+            writer.Key("liveAllocations"); writer.Int64(AllocationCounter::live());
+
+            writer.Key("resources");
+            Instrumentation::write(writer, instrumentation.sample());
+
+            write_limits();
         }
+        else
+        {
+            writer.Key("error"); writer.String("unknown command, expected status, sync, search <prefix> or limit [<name> <value>]");
+        }
+
+        writer.EndObject();
+
+        return buffer.GetString();
+    });
+
+    if (!control_socket.start())
+    {
+        return false;
     }
 
-    for (const auto results = download_manager.download(parameters); const auto& result : results)
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+
+    load_index();
+
+    if (options.metrics_interval > 0 && !instrumentation.start())
     {
-        if (result.success)
+        return false;
+    }
+
+    const std::chrono::seconds revalidate_after = std::chrono::days(options.revalidate_after_days);
+
+    for (size_t cycle = 0; !stop_requested; cycle++)
+    {
+        const bool full = cycle == 0;
+        const auto started = std::chrono::system_clock::now();
+
         {
-            APP_TRACE("{} -> Success ({})",
-                result.effective_url,
-                result.has_changed ? "Has changed" : "no changes");
+            const std::lock_guard lock(mutex);
+            status.state = full ? "full sync" : "sync";
+            status.last_started = unix_time(started);
+            sync_requested = false;
         }
-        else
+
+        APP_INFO("Daemon cycle {} ({})", cycle, full ? "full" : "incremental");
+
+        change_feed.begin();
+
+        const auto changed_languages = refreshAllSets(download_manager, database_manager, change_feed, options.api_url, languages, options.keep_compressed);
+
+        CardsRefresh cards_refresh;
+        if (full || !changed_languages.empty())
         {
-            APP_TRACE("{} -> ERROR: {}",
-                result.effective_url,
-                result.error);
+            cards_refresh = refreshAllCards(download_manager, database_manager, change_feed, planning_pool, options.api_url, options.shard, options.filter, options.keep_compressed, full ? std::nullopt : std::optional(changed_languages));
+        }
+
+        size_t changed_images = 0;
+        if (full || !cards_refresh.changed_paths.empty())
+        {
+            changed_images = downloadCards(download_manager, database_manager, change_feed, garbage_collector, planning_pool, options.api_url, variant_profile, options.shard, options.filter, cards_refresh, revalidate_after, !full, options.pack, options.keep_compressed);
+
+            if (options.pack && !options.shard.isSharded())
+            {
+                writePackIndexes(database_manager, pack_archive);
+            }
+
+            load_index();
+        }
+
+        change_feed.commit(database_manager);
+
+        const auto finished = std::chrono::system_clock::now();
+        const auto next_run = finished + std::chrono::seconds(options.interval);
+
+        {
+            const std::lock_guard lock(mutex);
+            status.state = "idle";
+            status.cycles = cycle + 1;
+            status.last_finished = unix_time(finished);
+            status.last_duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(finished - started).count();
+            status.changed_languages = changed_languages.size();
+            status.changed_sets = cards_refresh.changed_paths.size();
+            status.changed_images = changed_images;
+            status.next_run = unix_time(next_run);
+        }
+
+        // Live allocations stay flat from one cycle to the next unless memory leaks
+        APP_INFO("Daemon cycle {} done: {} languages, {} sets, {} images changed, {} live allocations", cycle, changed_languages.size(), cards_refresh.changed_paths.size(), changed_images, AllocationCounter::live());
+
+        // Signals cannot notify the condition, so wake up every second to check
+        std::unique_lock lock(mutex);
+        while (!stop_requested && !sync_requested && std::chrono::system_clock::now() < next_run)
+        {
+            condition.wait_for(lock, std::chrono::seconds(1));
         }
     }
+
+    APP_INFO("Daemon stopping");
+
+    control_socket.stop();
+    instrumentation.stop();
+
+    return true;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    const auto options = Options::parse(argc, argv);
+    if (!options.has_value())
+    {
+        Options::printUsage(std::cerr, argv[0]);
+        return EXIT_FAILURE;
+    }
+
     Logs::Initialize();
 
     APP_INFO("Application started.");
 
+    if (options->command == Options::Command::Search)
+    {
+        const auto found = searchCards(*options);
+
+        APP_INFO("Application stop.");
+
+        return found ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::vector<std::string> shardPaths = options->shard_paths;
+
+    if (options->workers > 0)
+    {
+        auto workerShardPaths = runWorkers(argc, argv, *options);
+        if (!workerShardPaths.has_value())
+        {
+            APP_ERROR("Not merging the shards: a worker failed");
+            return EXIT_FAILURE;
+        }
+
+        shardPaths = std::move(*workerShardPaths);
+    }
+
+    const auto& shard = options->shard;
+
+    if (shard.isSharded())
+    {
+        APP_INFO("Shard {} by {}", shard.name(), shard.key() == Shard::Key::Uri ? "uri" : "lang");
+
+        std::filesystem::create_directories(std::filesystem::path(shard.databasePath()).parent_path());
+    }
+
     DatabaseManager dbManager;
 
-    if (!dbManager.open("metadata.db"))
+    if (!dbManager.open(shard.databasePath()))
     {
         std::cerr << "Failed to open database." << std::endl;
         return EXIT_FAILURE;
     }
 
-    const auto downloadManager = DownloadManager(dbManager);
+    const ObjectStore objectStore("objects");
+    PackArchive packArchive("packs");
+
+    auto downloadManager = DownloadManager(dbManager);
+
+    if (options->limits.any())
+    {
+        APP_INFO("Rate limits: {} requests/s, {} bytes/s, per host {} requests/s, {} bytes/s (0 for none)",
+            options->limits.requests, options->limits.bytes, options->limits.host_requests, options->limits.host_bytes);
+    }
+
+    downloadManager.setRateLimits(options->limits);
+
+    // Next to metadata.db, so cron runs start with warm DNS, TLS and Alt-Svc caches
+    downloadManager.setCacheDirectory(shard.cacheDirectory());
+
+    if (options->deduplicate)
+    {
+        APP_INFO("Content-addressed store enabled in {}", "objects");
+
+        downloadManager.setObjectStore(&objectStore);
+    }
 
-    const std::map<std::string, std::string> languages = {
+    if (options->pack)
+    {
+        APP_INFO("Pack output enabled in {}", "packs");
+
+        downloadManager.setPackArchive(&packArchive);
+    }
+
+    if (options->command == Options::Command::Compact)
+    {
+        compactPacks(dbManager, packArchive);
+
+        dbManager.close();
+
+        APP_INFO("Application stop.");
+
+        return EXIT_SUCCESS;
+    }
+
+    ChangeFeed changeFeed(shard);
+
+    if (options->verify)
+    {
+        verifyStore(dbManager, downloadManager, objectStore, changeFeed);
+        changeFeed.commit(dbManager);
+
+        dbManager.close();
+
+        APP_INFO("Application stop.");
+
+        return EXIT_SUCCESS;
+    }
+
+    VariantProfile variantProfile;
+
+    if (!options->variants_path.empty())
+    {
+        auto profile = VariantProfile::load(options->variants_path);
+        if (!profile.has_value())
+        {
+            dbManager.close();
+            return EXIT_FAILURE;
+        }
+
+        variantProfile = std::move(*profile);
+    }
+
+    if (!shardPaths.empty())
+    {
+        const auto merged = mergeShards(dbManager, changeFeed, shardPaths);
+
+        ThreadPool catalogPool;
+        rebuildCatalogs(dbManager, changeFeed, catalogPool, variantProfile, options->keep_compressed);
+        writePackIndexes(dbManager, packArchive);
+
+        changeFeed.commit(dbManager);
+
+        dbManager.close();
+
+        APP_INFO("Application stop.");
+
+        return merged ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::map<std::string, std::string> languages = {
         {"en", "English"},
         {"fr", "Français"},
         {"es", "Español"},
@@ -354,14 +1308,68 @@ int main()
         {"zh-cn", "中文"}
     };
 
-    refreshAllSets(downloadManager, languages);
+    // The mark is the plan of the sets, a shard only plans part of them
+    std::optional<GarbageCollector> garbageCollector;
+
+    if (options->collect_garbage && shard.isSharded())
+    {
+        APP_WARN("--gc is ignored by a shard");
+    }
+    else if (options->collect_garbage)
+    {
+        APP_INFO("Garbage collection enabled{}", options->quarantine_path.empty() ? "" : fmt::format(", orphans moved to {}", options->quarantine_path));
+
+        garbageCollector.emplace(dbManager, options->deduplicate ? &objectStore : nullptr, options->quarantine_path);
+    }
 
-    refreshAllCards(downloadManager);
+    // Filters apply before any request, so a run costs what it selects
+    std::erase_if(languages, [&shard, &options](const auto& language)
+    {
+        return !shard.ownsLanguage(language.first) || !options->filter.acceptsLanguage(language.first);
+    });
+
+    if (options->command == Options::Command::Daemon)
+    {
+        const auto ran = runDaemon(*options, dbManager, downloadManager, changeFeed, garbageCollector ? &*garbageCollector : nullptr, packArchive, variantProfile, languages);
+
+        dbManager.close();
+
+        APP_INFO("Application stop.");
+
+        return ran ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-    downloadCards(downloadManager);
+    ThreadPool planningPool;
+
+    Instrumentation instrumentation(shard, std::chrono::seconds(options->metrics_interval), downloadManager, dbManager, &planningPool);
+
+    if (options->metrics_interval > 0 && !instrumentation.start())
+    {
+        dbManager.close();
+        return EXIT_FAILURE;
+    }
+
+    refreshAllSets(downloadManager, dbManager, changeFeed, options->api_url, languages, options->keep_compressed);
+
+    const auto cardsRefresh = refreshAllCards(downloadManager, dbManager, changeFeed, planningPool, options->api_url, shard, options->filter, options->keep_compressed);
+
+    downloadCards(downloadManager, dbManager, changeFeed, garbageCollector ? &*garbageCollector : nullptr, planningPool, options->api_url, variantProfile, shard, options->filter, cardsRefresh, std::chrono::days(options->revalidate_after_days), false, options->pack, options->keep_compressed);
+
+    // Pack indexes and catalogs of a shard are written by the merge
+    if (options->pack && !shard.isSharded())
+    {
+        writePackIndexes(dbManager, packArchive);
+    }
+
+    changeFeed.commit(dbManager);
+
+    instrumentation.stop();
 
     dbManager.close();
 
+    const auto allocations = AllocationCounter::process();
+    APP_INFO("{} allocations, {} in libcurl, {} still live", allocations.allocations, allocations.curl_allocations, AllocationCounter::live());
+
     APP_INFO("Application stop.");
 
     return EXIT_SUCCESS;
@@ -0,0 +1,202 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include <cstddef>
+#include <fstream>
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+#include "CardCatalogReader.h"
+#include "CardCatalogWriter.h"
+#include "Catalog.h"
+#include "DatabaseManager.h"
+#include "DownloadManager.h"
+#include "MockServer.h"
+#include "SyncFilter.h"
+#include "TestSupport.h"
+#include "VariantProfile.h"
+
+namespace {
+    auto writeFile(const std::filesystem::path& path, const std::string& content) -> void
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary) << content;
+    }
+
+    auto parameter(std::string uri, std::string destination_file_path) -> DownloadManager::DownloadParameter
+    {
+        DownloadManager::DownloadParameter download_parameter;
+        download_parameter.uri = std::move(uri);
+        download_parameter.destination_file_path = std::move(destination_file_path);
+        return download_parameter;
+    }
+
+    // sets.json and cards.json as a sync lays them out, fetched from the mock
+    class CatalogTest : public ::testing::Test {
+    protected:
+        ScratchDirectory m_scratch;
+        MockServer m_server;
+        DatabaseManager m_database_manager;
+        std::vector<std::string> m_images;
+
+        auto SetUp() -> void override
+        {
+            ASSERT_TRUE(m_server.start());
+            ASSERT_TRUE(m_database_manager.open("metadata.db"));
+
+            m_images = m_server.addCatalog({"en"}, 3, 5, 64);
+
+            std::vector<DownloadManager::DownloadParameter> download_parameters;
+            download_parameters.push_back(parameter(m_server.url("/v2/en/sets"), "data/en/sets.json"));
+            for (size_t s = 0; s < 3; s++)
+            {
+                download_parameters.push_back(parameter(m_server.url(fmt::format("/v2/en/sets/set{}", s)), fmt::format("data/en/set{}/cards.json", s)));
+            }
+
+            const DownloadManager download_manager(m_database_manager, 4);
+            for (const auto& result : download_manager.download(download_parameters))
+            {
+                ASSERT_TRUE(result.success) << result.url() << ": " << result.error;
+            }
+        }
+    };
+}
+
+TEST_F(CatalogTest, PlansTheImagesTheCardsPointAt)
+{
+    const auto set_ids = Catalog::readSetIds("data/en/sets.json");
+    ASSERT_TRUE(set_ids.has_value());
+    ASSERT_EQ(*set_ids, (std::vector<std::string> {"set0", "set1", "set2"}));
+
+    std::vector<std::string> planned;
+    for (const auto& set_id : *set_ids)
+    {
+        const auto set = Catalog::readSet(fmt::format("data/en/{}/cards.json", set_id), "en", set_id);
+        ASSERT_TRUE(set.has_value());
+        EXPECT_EQ(set->cards.size(), 5u);
+        EXPECT_FALSE(set->serie_id.empty());
+        EXPECT_TRUE(SyncFilter::isDate(set->release_date));
+
+        for (const auto& card : set->cards)
+        {
+            planned.push_back(Catalog::imageUri(card, {}));
+        }
+    }
+
+    EXPECT_EQ(planned, m_images);
+}
+
+TEST(Catalog, RemovesInvalidJson)
+{
+    const ScratchDirectory scratch;
+
+    writeFile("data/en/broken/cards.json", R"({"cards": [)");
+    EXPECT_FALSE(Catalog::readSet("data/en/broken/cards.json", "en", "broken").has_value());
+    EXPECT_FALSE(std::filesystem::exists("data/en/broken/cards.json"));
+
+    writeFile("data/en/nocards/cards.json", R"({"id": "nocards"})");
+    EXPECT_FALSE(Catalog::readSet("data/en/nocards/cards.json", "en", "nocards").has_value());
+
+    writeFile("data/fr/sets.json", R"({"id": "not an array"})");
+    EXPECT_FALSE(Catalog::readSetIds("data/fr/sets.json").has_value());
+}
+
+TEST(Catalog, SanitizesImagePaths)
+{
+    const Catalog::Set set {"en", "sv1", "", "", "", {}};
+    const Catalog::Card card {"12", "Pikachu: V/Star?", ""};
+
+    EXPECT_EQ(Catalog::imagePath(set, card, {"low", "webp"}), "data/en/sv1/12_low_Pikachu- V-Star .webp");
+    EXPECT_EQ(Catalog::imageUri({"12", "", "https://assets/en/sv/sv1/12"}, {}), "https://assets/en/sv/sv1/12/high.jpg");
+}
+
+TEST(Catalog, FiltersSetsAndVariants)
+{
+    SyncFilter filter;
+    filter.sets = {"set*"};
+    filter.excluded_sets = {"set1"};
+    filter.released_since = "2020-01-02";
+
+    EXPECT_TRUE(filter.acceptsSetId("set0"));
+    EXPECT_FALSE(filter.acceptsSetId("set1"));
+    EXPECT_FALSE(filter.acceptsSetId("other"));
+    EXPECT_TRUE(filter.needsSetDetails());
+    EXPECT_FALSE(filter.acceptsSetDetails("serie0", "2020-01-01"));
+    EXPECT_TRUE(filter.acceptsSetDetails("serie0", "2020-01-02"));
+
+    EXPECT_TRUE(VariantProfile::parseVariant("low.webp").has_value());
+    EXPECT_FALSE(VariantProfile::parseVariant("huge.gif").has_value());
+}
+
+TEST_F(CatalogTest, WritesACatalogTheReaderMaps)
+{
+    CardCatalogWriter writer("en");
+
+    for (size_t s = 0; s < 3; s++)
+    {
+        const auto set_id = fmt::format("set{}", s);
+        ASSERT_TRUE(writer.needsParsedSet(set_id, true));
+
+        auto set = Catalog::readSet(fmt::format("data/en/{}/cards.json", set_id), "en", set_id);
+        ASSERT_TRUE(set.has_value());
+        writer.addSet(std::move(*set));
+    }
+
+    ASSERT_TRUE(writer.write(m_database_manager, {}));
+
+    CardCatalogReader reader;
+    ASSERT_TRUE(reader.open(CardCatalogWriter::catalogPath("en").string()));
+    EXPECT_EQ(reader.language(), "en");
+    EXPECT_EQ(reader.sets().size(), 3u);
+    EXPECT_EQ(reader.cards().size(), 15u);
+
+    const auto* set = reader.findSet("set1");
+    ASSERT_NE(set, nullptr);
+    EXPECT_EQ(reader.string(set->name), "Set 1");
+    EXPECT_EQ(reader.cards(*set).size(), 5u);
+
+    // An unchanged set is copied from the previous catalog
+    CardCatalogWriter next("en");
+    EXPECT_FALSE(next.needsParsedSet("set0", false));
+    EXPECT_TRUE(next.needsParsedSet("set0", true));
+}
+
+TEST_F(CatalogTest, RefusesACatalogPointingOutsideItself)
+{
+    CardCatalogWriter writer("en");
+    auto set = Catalog::readSet("data/en/set0/cards.json", "en", "set0");
+    ASSERT_TRUE(set.has_value());
+    writer.addSet(std::move(*set));
+    ASSERT_TRUE(writer.write(m_database_manager, {}));
+
+    const auto path = CardCatalogWriter::catalogPath("en");
+
+    CardCatalogHeader header{};
+    std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    const auto patch = [&path](const uint64_t offset, const uint32_t value)
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    CardCatalogReader reader;
+    ASSERT_TRUE(reader.open(path.string()));
+    reader.close();
+
+    // A card of a set that does not exist
+    patch(header.cards_offset + offsetof(CardCatalogCard, set_index), 7);
+    EXPECT_FALSE(reader.open(path.string()));
+    patch(header.cards_offset + offsetof(CardCatalogCard, set_index), 0);
+
+    // More cards than the catalog holds
+    patch(header.sets_offset + offsetof(CardCatalogSet, card_count), 6);
+    EXPECT_FALSE(reader.open(path.string()));
+    patch(header.sets_offset + offsetof(CardCatalogSet, card_count), 5);
+
+    // A name past the end of the string pool
+    patch(header.sets_offset + offsetof(CardCatalogSet, name) + offsetof(CardCatalogString, length), static_cast<uint32_t>(header.strings_size) + 1);
+    EXPECT_FALSE(reader.open(path.string()));
+}
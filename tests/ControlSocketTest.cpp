@@ -0,0 +1,103 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ControlSocket.h"
+#include "TestSupport.h"
+
+namespace {
+    auto address(const std::string& path) -> sockaddr_un
+    {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+        return address;
+    }
+
+    // Sends one command line and reads the answer until the daemon closes
+    auto request(const std::string& path, const std::string& command) -> std::string
+    {
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        const auto server = address(path);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&server), sizeof(server)) != 0)
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            return {};
+        }
+
+        const auto line = command + "\n";
+        if (::write(fd, line.data(), line.size()) != static_cast<ssize_t>(line.size()))
+        {
+            ::close(fd);
+            return {};
+        }
+
+        std::string response;
+        char buffer[256];
+        for (ssize_t count; (count = ::read(fd, buffer, sizeof(buffer))) > 0; )
+        {
+            response.append(buffer, static_cast<size_t>(count));
+        }
+        ::close(fd);
+
+        return response;
+    }
+
+    auto echo(const std::string_view command) -> std::string
+    {
+        return "echo " + std::string(command);
+    }
+}
+
+TEST(ControlSocket, AnswersOneCommandPerConnection)
+{
+    const ScratchDirectory scratch;
+    ControlSocket control_socket("control.sock", echo);
+    ASSERT_TRUE(control_socket.start());
+
+    EXPECT_EQ(request("control.sock", "status"), "echo status\n");
+    EXPECT_EQ(request("control.sock", "pause"), "echo pause\n");
+
+    control_socket.stop();
+    EXPECT_FALSE(std::filesystem::exists("control.sock"));
+}
+
+TEST(ControlSocket, RefusesThePathOfARunningDaemon)
+{
+    const ScratchDirectory scratch;
+    ControlSocket running("control.sock", echo);
+    ASSERT_TRUE(running.start());
+
+    ControlSocket second("control.sock", echo);
+    EXPECT_FALSE(second.start());
+
+    // The running daemon keeps its socket
+    EXPECT_EQ(request("control.sock", "status"), "echo status\n");
+}
+
+TEST(ControlSocket, ReplacesTheSocketOfADaemonThatDidNotStopCleanly)
+{
+    const ScratchDirectory scratch;
+
+    // Bound then closed without unlinking: the file stays, nothing listens
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    const auto stale = address("control.sock");
+    ASSERT_EQ(::bind(fd, reinterpret_cast<const sockaddr*>(&stale), sizeof(stale)), 0);
+    ::close(fd);
+    ASSERT_TRUE(std::filesystem::exists("control.sock"));
+
+    ControlSocket control_socket("control.sock", echo);
+    ASSERT_TRUE(control_socket.start());
+    EXPECT_EQ(request("control.sock", "status"), "echo status\n");
+}
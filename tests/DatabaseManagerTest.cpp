@@ -0,0 +1,212 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include <gtest/gtest.h>
+
+#include "DatabaseManager.h"
+#include "TestSupport.h"
+
+namespace {
+    auto row(const std::string& uri, const std::string& etag, const std::string& digest = "", const std::string& parent_uri = "") -> DatabaseManager::UriMetadata
+    {
+        DatabaseManager::UriMetadata uri_metadata;
+        uri_metadata.uri = uri;
+        uri_metadata.etag = etag;
+        uri_metadata.digest = digest;
+        uri_metadata.size = digest.size();
+        uri_metadata.file_path = "data/" + uri.substr(uri.rfind('/') + 1);
+        uri_metadata.parent_uri = parent_uri;
+        return uri_metadata;
+    }
+}
+
+TEST(DatabaseManager, UpsertsAndReadsUriMetadata)
+{
+    const ScratchDirectory scratch;
+    DatabaseManager database_manager;
+    ASSERT_TRUE(database_manager.open("metadata.db"));
+
+    EXPECT_FALSE(database_manager.getUriMetadata("https://host/a").has_value());
+
+    ASSERT_TRUE(database_manager.upsertUriMetadata(row("https://host/a", "\"1\"", "aa")));
+    ASSERT_TRUE(database_manager.upsertUriMetadata(row("https://host/a", "\"2\"", "bb")));
+
+    const auto uri_metadata = database_manager.getUriMetadata("https://host/a");
+    ASSERT_TRUE(uri_metadata.has_value());
+    EXPECT_EQ(uri_metadata->etag, "\"2\"");
+    EXPECT_EQ(uri_metadata->digest, "bb");
+    EXPECT_EQ(uri_metadata->file_path, "data/a");
+
+    std::string etag;
+    std::string last_update;
+    EXPECT_TRUE(database_manager.getValidators("https://host/a", etag, last_update));
+    EXPECT_EQ(etag, "\"2\"");
+    EXPECT_FALSE(database_manager.getValidators("https://host/missing", etag, last_update));
+    EXPECT_TRUE(etag.empty());
+}
+
+TEST(DatabaseManager, ValidatesUnderParentAndListsByParent)
+{
+    const ScratchDirectory scratch;
+    DatabaseManager database_manager;
+    ASSERT_TRUE(database_manager.open("metadata.db"));
+
+    ASSERT_TRUE(database_manager.upsertUriMetadata(row("https://host/1.jpg", "\"1\"", "11", "https://api/set")));
+    ASSERT_TRUE(database_manager.upsertUriMetadata(row("https://host/2.jpg", "\"2\"", "22", "https://api/set")));
+    ASSERT_TRUE(database_manager.upsertUriMetadata(row("https://host/3.jpg", "\"3\"", "33", "https://api/other")));
+
+    EXPECT_TRUE(database_manager.markValidated("https://host/1.jpg", "https://api/set", "\"set\"", 1000));
+
+    const auto uri_metadata = database_manager.getUriMetadata("https://host/1.jpg");
+    ASSERT_TRUE(uri_metadata.has_value());
+    EXPECT_EQ(uri_metadata->parent_etag, "\"set\"");
+    EXPECT_EQ(uri_metadata->validated_at, 1000);
+
+    EXPECT_EQ(database_manager.listUriMetadataByParent("https://api/set").size(), 2u);
+    EXPECT_EQ(database_manager.listUriMetadataByParent("https://api/other").size(), 1u);
+
+    EXPECT_TRUE(database_manager.deleteUriMetadata("https://host/1.jpg"));
+    EXPECT_FALSE(database_manager.getUriMetadata("https://host/1.jpg").has_value());
+    EXPECT_EQ(database_manager.listUriMetadataByParent("https://api/set").size(), 1u);
+}
+
+TEST(DatabaseManager, SharesBlobsBetweenUris)
+{
+    const ScratchDirectory scratch;
+    DatabaseManager database_manager;
+    ASSERT_TRUE(database_manager.open("metadata.db"));
+
+    ASSERT_TRUE(database_manager.upsertBlob({"https://host/a", "digest", 10}));
+    EXPECT_FALSE(database_manager.isBlobShared("digest", "https://host/a"));
+
+    ASSERT_TRUE(database_manager.upsertBlob({"https://host/b", "digest", 10}));
+    EXPECT_TRUE(database_manager.isBlobShared("digest", "https://host/a"));
+
+    const auto blob = database_manager.getBlob("https://host/b");
+    ASSERT_TRUE(blob.has_value());
+    EXPECT_EQ(blob->digest, "digest");
+}
+
+TEST(DatabaseManager, CountsCommittedTransactions)
+{
+    const ScratchDirectory scratch;
+    DatabaseManager database_manager;
+    ASSERT_TRUE(database_manager.open("metadata.db"));
+
+    const auto before = database_manager.commits();
+
+    ASSERT_TRUE(database_manager.beginTransaction());
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_TRUE(database_manager.upsertUriMetadata(row("https://host/" + std::to_string(i), "\"e\"")));
+    }
+    ASSERT_TRUE(database_manager.commit());
+
+    EXPECT_EQ(database_manager.commits() - before, 1u);
+}
+
+TEST(DatabaseManager, CountsRowsPendingInOpenTransactions)
+{
+    const ScratchDirectory scratch;
+    DatabaseManager database_manager;
+    ASSERT_TRUE(database_manager.open("metadata.db"));
+
+    ASSERT_TRUE(database_manager.upsertUriMetadata(row("https://host/autocommit", "\"e\"")));
+    EXPECT_EQ(database_manager.pendingRows(), 0u);
+
+    ASSERT_TRUE(database_manager.beginTransaction());
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_TRUE(database_manager.upsertUriMetadata(row("https://host/" + std::to_string(i), "\"e\"")));
+    }
+    EXPECT_EQ(database_manager.pendingRows(), 10u);
+
+    ASSERT_TRUE(database_manager.commit());
+    EXPECT_EQ(database_manager.pendingRows(), 0u);
+    EXPECT_EQ(database_manager.connectionCount(), 1u);
+}
+
+TEST(DatabaseManager, RecordsSyncRunsAndMergesShards)
+{
+    const ScratchDirectory scratch;
+    {
+        DatabaseManager shard;
+        ASSERT_TRUE(shard.open("shard.db"));
+        ASSERT_TRUE(shard.upsertUriMetadata(row("https://host/a", "\"1\"", "aa")));
+        ASSERT_TRUE(shard.upsertUriMetadata(row("https://host/b", "\"1\"", "bb")));
+
+        DatabaseManager::SyncRun sync_run;
+        sync_run.started_at = 1;
+        sync_run.finished_at = 2;
+        sync_run.added = 1;
+        const auto id = shard.insertSyncRun(sync_run, {{"added", "image", "https://host/a", "data/a", "aa", 2}});
+        ASSERT_TRUE(id.has_value());
+        EXPECT_GT(*id, 0);
+    }
+
+    DatabaseManager database_manager;
+    ASSERT_TRUE(database_manager.open("metadata.db"));
+
+    ASSERT_TRUE(database_manager.beginMerge());
+    const auto result = database_manager.mergeShard("shard.db");
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->merged, 2u);
+    EXPECT_TRUE(result->conflicts.empty());
+    ASSERT_EQ(result->changes.size(), 1u);
+    EXPECT_EQ(result->changes[0].uri, "https://host/a");
+
+    const auto uri_metadata = database_manager.getUriMetadata("https://host/b");
+    ASSERT_TRUE(uri_metadata.has_value());
+    EXPECT_EQ(uri_metadata->digest, "bb");
+}
+
+TEST(DatabaseManager, FirstShardOfASessionWins)
+{
+    const ScratchDirectory scratch;
+    for (const auto& [path, etag] : {std::pair{"shard-0.db", "\"0\""}, std::pair{"shard-1.db", "\"1\""}})
+    {
+        DatabaseManager shard;
+        ASSERT_TRUE(shard.open(path));
+        ASSERT_TRUE(shard.upsertUriMetadata(row("https://host/shared", etag, etag)));
+        ASSERT_TRUE(shard.upsertUriMetadata(row(std::string("https://host/") + path, etag, etag)));
+    }
+
+    DatabaseManager database_manager;
+    ASSERT_TRUE(database_manager.open("metadata.db"));
+
+    ASSERT_TRUE(database_manager.beginMerge());
+    const auto first = database_manager.mergeShard("shard-0.db");
+    const auto second = database_manager.mergeShard("shard-1.db");
+    database_manager.endMerge();
+
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ(first->merged, 2u);
+    EXPECT_TRUE(first->conflicts.empty());
+    EXPECT_EQ(second->merged, 1u);
+    ASSERT_EQ(second->conflicts.size(), 1u);
+    EXPECT_EQ(second->conflicts[0].uri, "https://host/shared");
+    EXPECT_EQ(database_manager.getUriMetadata("https://host/shared")->etag, "\"0\"");
+
+    // A new session starts over: the shard merged first now wins
+    ASSERT_TRUE(database_manager.beginMerge());
+    const auto again = database_manager.mergeShard("shard-1.db");
+    database_manager.endMerge();
+
+    ASSERT_TRUE(again.has_value());
+    EXPECT_EQ(again->merged, 2u);
+    EXPECT_TRUE(again->conflicts.empty());
+    EXPECT_EQ(database_manager.getUriMetadata("https://host/shared")->etag, "\"1\"");
+}
+
+TEST(DatabaseManager, ReportsMissingShard)
+{
+    const ScratchDirectory scratch;
+    DatabaseManager database_manager;
+    ASSERT_TRUE(database_manager.open("metadata.db"));
+
+    std::filesystem::create_directory("not-a-database");
+    ASSERT_TRUE(database_manager.beginMerge());
+    EXPECT_FALSE(database_manager.mergeShard("not-a-database").has_value());
+}
@@ -0,0 +1,362 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include <chrono>
+#include <future>
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+#include "AllocationCounter.h"
+#include "DatabaseManager.h"
+#include "DownloadManager.h"
+#include "FileSink.h"
+#include "MockServer.h"
+#include "ObjectStore.h"
+#include "PackArchive.h"
+#include "PackIndexReader.h"
+#include "TestSupport.h"
+
+namespace {
+    auto parameters(const std::vector<std::string>& uris, const std::string& directory = "data") -> std::vector<DownloadManager::DownloadParameter>
+    {
+        std::vector<DownloadManager::DownloadParameter> download_parameters;
+        download_parameters.reserve(uris.size());
+
+        for (size_t i = 0; i < uris.size(); i++)
+        {
+            DownloadManager::DownloadParameter parameter;
+            parameter.uri = uris[i];
+            parameter.destination_file_path = fmt::format("{}/{}.jpg", directory, i);
+            download_parameters.push_back(std::move(parameter));
+        }
+
+        return download_parameters;
+    }
+
+    class DownloadManagerTest : public ::testing::Test {
+    protected:
+        ScratchDirectory m_scratch;
+        MockServer m_server;
+        DatabaseManager m_database_manager;
+
+        auto SetUp() -> void override
+        {
+            ASSERT_TRUE(m_server.start());
+            ASSERT_TRUE(m_database_manager.open("metadata.db"));
+        }
+    };
+}
+
+TEST_F(DownloadManagerTest, DownloadsThenRevalidatesWithEtag)
+{
+    const auto images = m_server.addCatalog({"en"}, 1, 8, 4096);
+    const DownloadManager download_manager(m_database_manager, 4);
+
+    auto download_parameters = parameters(images);
+    const auto first = download_manager.download(download_parameters);
+
+    ASSERT_EQ(first.size(), images.size());
+    for (const auto& result : first)
+    {
+        EXPECT_TRUE(result.success) << result.url() << ": " << result.error;
+        EXPECT_TRUE(result.has_changed);
+        EXPECT_TRUE(result.created);
+        EXPECT_EQ(std::filesystem::file_size(result.parameter->destination_file_path), 4096u);
+
+        // The validator is persisted with the digest of the body
+        const auto uri_metadata = m_database_manager.getUriMetadata(result.url());
+        ASSERT_TRUE(uri_metadata.has_value());
+        EXPECT_FALSE(uri_metadata->etag.empty());
+        EXPECT_FALSE(uri_metadata->digest.empty());
+        EXPECT_EQ(uri_metadata->size, 4096u);
+    }
+
+    EXPECT_EQ(m_server.counts().ok, images.size());
+    m_server.resetCounts();
+
+    const auto counters = download_manager.counters();
+    EXPECT_EQ(counters.transfers, images.size());
+    EXPECT_EQ(counters.failures, 0u);
+    EXPECT_EQ(counters.bytes_written, images.size() * 4096);
+    EXPECT_EQ(counters.queued, 0u);
+    EXPECT_EQ(counters.active, 0u);
+    EXPECT_EQ(counters.write_queue, 0u);
+    // Pooled, at most one per parallel transfer
+    EXPECT_LE(counters.easy_handles, 4u);
+
+    const auto second = download_manager.download(download_parameters);
+
+    for (const auto& result : second)
+    {
+        EXPECT_TRUE(result.success) << result.url() << ": " << result.error;
+        EXPECT_FALSE(result.has_changed);
+    }
+
+    const auto counts = m_server.counts();
+    EXPECT_EQ(counts.not_modified, images.size());
+    EXPECT_EQ(counts.ok, 0u);
+}
+
+TEST_F(DownloadManagerTest, DownloadsAgainWhatTheServerChanged)
+{
+    const auto images = m_server.addCatalog({"en"}, 1, 2, 1024);
+    const DownloadManager download_manager(m_database_manager, 4);
+
+    auto download_parameters = parameters(images);
+    ASSERT_TRUE(download_manager.download(download_parameters)[0].success);
+
+    const auto before = m_database_manager.getUriMetadata(images[0]);
+    ASSERT_TRUE(before.has_value());
+
+    m_server.setBody("/images/en/set0/1/high.jpg", std::string(2048, 'x'));
+
+    const auto results = download_manager.download(download_parameters);
+
+    EXPECT_TRUE(results[0].success);
+    EXPECT_TRUE(results[0].has_changed);
+    EXPECT_FALSE(results[0].created);
+    EXPECT_FALSE(results[1].has_changed);
+    EXPECT_EQ(std::filesystem::file_size("data/0.jpg"), 2048u);
+
+    const auto after = m_database_manager.getUriMetadata(images[0]);
+    ASSERT_TRUE(after.has_value());
+    EXPECT_NE(after->etag, before->etag);
+    EXPECT_NE(after->digest, before->digest);
+}
+
+TEST_F(DownloadManagerTest, FetchesAUriOnceForSeveralDestinations)
+{
+    const auto images = m_server.addCatalog({"en"}, 1, 1, 1024);
+    const DownloadManager download_manager(m_database_manager, 4);
+
+    auto download_parameters = parameters({images[0], images[0], images[0]});
+    const auto results = download_manager.download(download_parameters);
+
+    for (const auto& result : results)
+    {
+        EXPECT_TRUE(result.success) << result.error;
+        EXPECT_EQ(std::filesystem::file_size(result.parameter->destination_file_path), 1024u);
+    }
+
+    EXPECT_EQ(m_server.counts().requests, 1u);
+}
+
+TEST_F(DownloadManagerTest, WritesTheBodiesOfOverlappingCalls)
+{
+    // Several buffers per body, so both calls keep writes in flight at once
+    constexpr size_t image_size = 3 * FileSink::buffer_size + 123;
+    const auto images = m_server.addCatalog({"en", "fr"}, 1, 16, image_size);
+    const DownloadManager download_manager(m_database_manager, 4);
+
+    const std::vector en(images.begin(), images.begin() + 16);
+    const std::vector fr(images.begin() + 16, images.end());
+    auto en_parameters = parameters(en, "data/en");
+    auto fr_parameters = parameters(fr, "data/fr");
+
+    auto en_results = std::async(std::launch::async, [&] { return download_manager.download(en_parameters); });
+    const auto fr_results = download_manager.download(fr_parameters);
+
+    for (const auto& results : {en_results.get(), fr_results})
+    {
+        ASSERT_EQ(results.size(), 16u);
+        for (const auto& result : results)
+        {
+            EXPECT_TRUE(result.success) << result.url() << ": " << result.error;
+            EXPECT_EQ(std::filesystem::file_size(result.parameter->destination_file_path), image_size);
+        }
+    }
+
+    EXPECT_EQ(download_manager.counters().write_queue, 0u);
+}
+
+TEST_F(DownloadManagerTest, AppendsPackedBodiesToTheirGroup)
+{
+    const auto images = m_server.addCatalog({"en"}, 1, 6, 1024);
+    PackArchive pack_archive;
+    DownloadManager download_manager(m_database_manager, 4);
+    download_manager.setPackArchive(&pack_archive);
+
+    auto download_parameters = parameters(images);
+    for (auto& parameter : download_parameters)
+    {
+        parameter.pack_group = "en";
+    }
+
+    for (const auto& result : download_manager.download(download_parameters))
+    {
+        EXPECT_TRUE(result.success) << result.url() << ": " << result.error;
+        EXPECT_FALSE(std::filesystem::exists(result.parameter->destination_file_path));
+    }
+
+    const auto entries = m_database_manager.listPackEntries("en");
+    ASSERT_EQ(entries.size(), images.size());
+    EXPECT_EQ(std::filesystem::file_size("packs/en-0000.pack"), images.size() * 1024);
+    ASSERT_TRUE(pack_archive.writeIndex("en", entries));
+
+    PackIndexReader reader;
+    ASSERT_TRUE(reader.open(pack_archive.indexPath("en").string()));
+    for (const auto& image : images)
+    {
+        const auto location = reader.find(image);
+        ASSERT_TRUE(location.has_value()) << image;
+        EXPECT_EQ(location->length, 1024u);
+        EXPECT_FALSE(location->etag.empty());
+    }
+
+    // Revalidated, not appended again
+    for (const auto& result : download_manager.download(download_parameters))
+    {
+        EXPECT_TRUE(result.success) << result.url() << ": " << result.error;
+        EXPECT_FALSE(result.has_changed);
+    }
+    EXPECT_EQ(std::filesystem::file_size("packs/en-0000.pack"), images.size() * 1024);
+}
+
+TEST_F(DownloadManagerTest, StoresIdenticalBodiesOnce)
+{
+    m_server.setBody("/first", "same body");
+    m_server.setBody("/second", "same body");
+    m_server.setBody("/other", "other body");
+
+    const ObjectStore object_store;
+    DownloadManager download_manager(m_database_manager, 4);
+    download_manager.setObjectStore(&object_store);
+
+    auto download_parameters = parameters({m_server.url("/first"), m_server.url("/second"), m_server.url("/other")});
+    for (const auto& result : download_manager.download(download_parameters))
+    {
+        EXPECT_TRUE(result.success) << result.url() << ": " << result.error;
+    }
+
+    const auto first = m_database_manager.getBlob(m_server.url("/first"));
+    const auto second = m_database_manager.getBlob(m_server.url("/second"));
+    const auto other = m_database_manager.getBlob(m_server.url("/other"));
+    ASSERT_TRUE(first.has_value() && second.has_value() && other.has_value());
+    EXPECT_EQ(first->digest, second->digest);
+    EXPECT_NE(first->digest, other->digest);
+
+    // Both destinations are links onto the one object
+    EXPECT_TRUE(std::filesystem::equivalent("data/0.jpg", object_store.objectPath(first->digest)));
+    EXPECT_TRUE(std::filesystem::equivalent("data/1.jpg", object_store.objectPath(first->digest)));
+    EXPECT_TRUE(m_database_manager.isBlobShared(first->digest, m_server.url("/first")));
+
+    size_t objects = 0;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator("objects"))
+    {
+        objects += entry.is_regular_file();
+    }
+    EXPECT_EQ(objects, 2u);
+}
+
+TEST_F(DownloadManagerTest, CreatesAgainADirectoryRemovedBetweenCalls)
+{
+    m_server.setBody("/image", "first");
+    const DownloadManager download_manager(m_database_manager, 4);
+
+    auto download_parameters = parameters({m_server.url("/image")}, "data/en");
+    ASSERT_TRUE(download_manager.download(download_parameters)[0].success);
+
+    std::filesystem::remove_all("data/en");
+    m_server.setBody("/image", "second");
+
+    const auto results = download_manager.download(download_parameters);
+    EXPECT_TRUE(results[0].success) << results[0].error;
+    EXPECT_EQ(std::filesystem::file_size("data/en/0.jpg"), 6u);
+}
+
+TEST_F(DownloadManagerTest, ReportsErrorsWithoutRecordingThem)
+{
+    m_server.setBody("/ok", "body");
+    m_server.setBody("/broken", "body");
+    m_server.setStatus("/broken", 500);
+
+    MockServer stopped;
+    ASSERT_TRUE(stopped.start());
+    const auto refused = stopped.url("/refused");
+    stopped.stop();
+
+    const DownloadManager download_manager(m_database_manager, 4);
+
+    auto download_parameters = parameters({m_server.url("/missing"), m_server.url("/broken"), refused, m_server.url("/ok")});
+    const auto results = download_manager.download(download_parameters);
+
+    ASSERT_EQ(results.size(), 4u);
+    for (size_t i = 0; i < 3; i++)
+    {
+        EXPECT_FALSE(results[i].success) << results[i].url();
+        EXPECT_FALSE(results[i].error.empty());
+        EXPECT_FALSE(results[i].has_changed);
+        EXPECT_FALSE(std::filesystem::exists(results[i].parameter->destination_file_path));
+        EXPECT_FALSE(m_database_manager.getUriMetadata(results[i].url()).has_value());
+    }
+
+    EXPECT_EQ(results[0].error, "HTTP status 404");
+    EXPECT_EQ(results[1].error, "HTTP status 500");
+
+    // One failure does not fail the others
+    EXPECT_TRUE(results[3].success) << results[3].error;
+    EXPECT_EQ(download_manager.counters().failures, 3u);
+}
+
+TEST_F(DownloadManagerTest, KeepsTheFileOfAFailedRevalidation)
+{
+    m_server.setBody("/image", "first");
+    const DownloadManager download_manager(m_database_manager, 4);
+
+    auto download_parameters = parameters({m_server.url("/image")});
+    ASSERT_TRUE(download_manager.download(download_parameters)[0].success);
+
+    m_server.setStatus("/image", 429);
+    const auto results = download_manager.download(download_parameters);
+
+    EXPECT_FALSE(results[0].success);
+    EXPECT_EQ(results[0].error, "HTTP status 429");
+    EXPECT_EQ(std::filesystem::file_size("data/0.jpg"), 5u);
+
+    const auto uri_metadata = m_database_manager.getUriMetadata(m_server.url("/image"));
+    ASSERT_TRUE(uri_metadata.has_value());
+    EXPECT_EQ(uri_metadata->size, 5u);
+}
+
+TEST_F(DownloadManagerTest, BudgetThroughputAllocationsAndCommits)
+{
+    constexpr size_t image_size = 8192;
+    const auto images = m_server.addCatalog({"en"}, 4, 250, image_size);
+    const DownloadManager download_manager(m_database_manager, 50);
+
+    // Warms the connection and transfer pools, like every run after the first call
+    auto warm_up = parameters({images[0]});
+    ASSERT_TRUE(download_manager.download(warm_up)[0].success);
+
+    auto download_parameters = parameters(images);
+    const auto allocations = AllocationCounter::currentThread();
+    const auto commits = m_database_manager.commits();
+    const auto started = std::chrono::steady_clock::now();
+
+    const auto results = download_manager.download(download_parameters);
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+    const auto allocated = AllocationCounter::currentThread();
+
+    size_t succeeded = 0;
+    for (const auto& result : results)
+    {
+        succeeded += result.success ? 1 : 0;
+    }
+    ASSERT_EQ(succeeded, images.size());
+
+    const double requests_per_second = static_cast<double>(images.size()) / elapsed.count();
+    const double allocations_per_transfer = static_cast<double>(allocated.allocations - allocations.allocations) / static_cast<double>(images.size());
+    const double commits_per_transfer = static_cast<double>(m_database_manager.commits() - commits) / static_cast<double>(images.size());
+
+    RecordProperty("requests_per_second", fmt::format("{:.0f}", requests_per_second));
+    RecordProperty("allocations_per_transfer", fmt::format("{:.1f}", allocations_per_transfer));
+    RecordProperty("commits_per_transfer", fmt::format("{:.3f}", commits_per_transfer));
+    RecordProperty("max_rss_kib", std::to_string(maxRssKiB()));
+
+    EXPECT_GE(requests_per_second, Budget::min_requests_per_second);
+    EXPECT_LE(allocations_per_transfer, Budget::max_allocations_per_transfer);
+    EXPECT_LE(commits_per_transfer, Budget::max_commits_per_transfer);
+    EXPECT_LE(maxRssKiB(), Budget::max_rss_kib);
+}
@@ -0,0 +1,155 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include <algorithm>
+#include <fstream>
+#include <gtest/gtest.h>
+
+#include "DatabaseManager.h"
+#include "GarbageCollector.h"
+#include "ObjectStore.h"
+#include "TestSupport.h"
+
+namespace {
+    constexpr auto parent_uri = "https://api/v2/en/sets/set0";
+
+    auto writeFile(const std::filesystem::path& path, const std::string& content = "image") -> void
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary) << content;
+    }
+
+    // An image recorded under the cards.json of set0, its file on disk
+    auto record(const DatabaseManager& database_manager, const std::string& name, const std::string& file_path, const std::string& digest = "") -> void
+    {
+        DatabaseManager::UriMetadata row;
+        row.uri = "https://assets/en/" + name;
+        row.etag = "\"" + name + "\"";
+        row.digest = digest;
+        row.file_path = file_path;
+        row.parent_uri = parent_uri;
+        ASSERT_TRUE(database_manager.upsertUriMetadata(row));
+
+        writeFile(file_path);
+    }
+
+    auto uris(const std::vector<GarbageCollector::Orphan>& orphans) -> std::vector<std::string>
+    {
+        std::vector<std::string> uris;
+        for (const auto& orphan : orphans)
+        {
+            uris.push_back(orphan.row.uri + (orphan.file_only ? " (file)" : ""));
+        }
+        std::ranges::sort(uris);
+        return uris;
+    }
+
+    class GarbageCollectorTest : public ::testing::Test {
+    protected:
+        ScratchDirectory m_scratch;
+        DatabaseManager m_database_manager;
+
+        auto SetUp() -> void override
+        {
+            ASSERT_TRUE(m_database_manager.open("metadata.db"));
+        }
+    };
+}
+
+TEST_F(GarbageCollectorTest, FindsWhatThePlanNoLongerHas)
+{
+    record(m_database_manager, "kept", "data/en/set0/1_kept.jpg");
+    record(m_database_manager, "renamed", "data/en/set0/2_old.jpg");
+    record(m_database_manager, "removed", "data/en/set0/3_removed.jpg");
+    // Dropped from the plan, but its file is now the destination of another card
+    record(m_database_manager, "replaced", "data/en/set0/4_new.jpg");
+
+    GarbageCollector::Mark mark;
+    mark.uris = {"https://assets/en/kept", "https://assets/en/renamed", "https://assets/en/new"};
+    mark.paths = {"data/en/set0/1_kept.jpg", "data/en/set0/2_new.jpg", "data/en/set0/4_new.jpg"};
+
+    const GarbageCollector garbage_collector(m_database_manager, nullptr);
+    const auto orphans = garbage_collector.findOrphans(parent_uri, mark);
+
+    EXPECT_EQ(uris(orphans), (std::vector<std::string> {
+        "https://assets/en/removed",
+        "https://assets/en/renamed (file)",
+        "https://assets/en/replaced"}));
+
+    EXPECT_TRUE(garbage_collector.findOrphans("https://api/v2/en/sets/other", mark).empty());
+
+    // The renamed image is not downloaded yet: its row still points at the previous file
+    EXPECT_EQ(garbage_collector.sweep(orphans), 2u);
+
+    EXPECT_TRUE(std::filesystem::exists("data/en/set0/1_kept.jpg"));
+    EXPECT_TRUE(std::filesystem::exists("data/en/set0/2_old.jpg"));
+    EXPECT_FALSE(std::filesystem::exists("data/en/set0/3_removed.jpg"));
+    EXPECT_TRUE(std::filesystem::exists("data/en/set0/4_new.jpg"));
+
+    EXPECT_TRUE(m_database_manager.getUriMetadata("https://assets/en/renamed").has_value());
+    EXPECT_FALSE(m_database_manager.getUriMetadata("https://assets/en/removed").has_value());
+    EXPECT_FALSE(m_database_manager.getUriMetadata("https://assets/en/replaced").has_value());
+
+    // Once downloaded under its new name, the previous file goes
+    record(m_database_manager, "renamed", "data/en/set0/2_new.jpg");
+    EXPECT_TRUE(garbage_collector.findOrphans(parent_uri, mark).empty());
+
+    const auto renamed = std::ranges::find_if(orphans, [](const auto& orphan) { return orphan.file_only; });
+    ASSERT_NE(renamed, orphans.end());
+    EXPECT_EQ(garbage_collector.sweep({*renamed}), 1u);
+
+    EXPECT_FALSE(std::filesystem::exists("data/en/set0/2_old.jpg"));
+    EXPECT_TRUE(std::filesystem::exists("data/en/set0/2_new.jpg"));
+}
+
+TEST_F(GarbageCollectorTest, MovesOrphansToTheQuarantine)
+{
+    record(m_database_manager, "removed", "data/en/set0/3_removed.jpg");
+
+    const GarbageCollector garbage_collector(m_database_manager, nullptr, "quarantine");
+    EXPECT_EQ(garbage_collector.sweep(garbage_collector.findOrphans(parent_uri, {})), 1u);
+
+    EXPECT_FALSE(std::filesystem::exists("data/en/set0/3_removed.jpg"));
+    EXPECT_TRUE(std::filesystem::exists("quarantine/data/en/set0/3_removed.jpg"));
+    EXPECT_FALSE(m_database_manager.getUriMetadata("https://assets/en/removed").has_value());
+}
+
+TEST_F(GarbageCollectorTest, DiscardsAnObjectOnceNoUriUsesIt)
+{
+    const ObjectStore object_store;
+    const auto object_path = object_store.objectPath("abcdef");
+    writeFile(object_path);
+
+    record(m_database_manager, "first", "data/en/set0/1_first.jpg", "abcdef");
+    record(m_database_manager, "second", "data/en/set0/2_second.jpg", "abcdef");
+    ASSERT_TRUE(m_database_manager.upsertBlob({"https://assets/en/first", "abcdef", 5}));
+    ASSERT_TRUE(m_database_manager.upsertBlob({"https://assets/en/second", "abcdef", 5}));
+
+    const GarbageCollector garbage_collector(m_database_manager, &object_store);
+
+    GarbageCollector::Mark mark;
+    mark.uris = {"https://assets/en/second"};
+    mark.paths = {"data/en/set0/2_second.jpg"};
+    EXPECT_EQ(garbage_collector.sweep(garbage_collector.findOrphans(parent_uri, mark)), 1u);
+    EXPECT_TRUE(std::filesystem::exists(object_path));
+
+    EXPECT_EQ(garbage_collector.sweep(garbage_collector.findOrphans(parent_uri, {})), 1u);
+    EXPECT_FALSE(std::filesystem::exists(object_path));
+}
+
+TEST_F(GarbageCollectorTest, SweepsInBatches)
+{
+    for (size_t i = 0; i < 10; i++)
+    {
+        record(m_database_manager, std::to_string(i), "data/en/set0/" + std::to_string(i) + ".jpg");
+    }
+
+    const auto commits = m_database_manager.commits();
+
+    const GarbageCollector garbage_collector(m_database_manager, nullptr, {}, 4);
+    EXPECT_EQ(garbage_collector.sweep(garbage_collector.findOrphans(parent_uri, {})), 10u);
+
+    EXPECT_EQ(m_database_manager.commits() - commits, 3u);
+    EXPECT_TRUE(m_database_manager.listUriMetadataByParent(parent_uri).empty());
+}
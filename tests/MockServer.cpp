@@ -0,0 +1,364 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "MockServer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <fmt/format.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "Hasher.h"
+
+namespace {
+    auto reason(const int status) -> const char*
+    {
+        switch (status)
+        {
+            case 200: return "OK";
+            case 304: return "Not Modified";
+            case 404: return "Not Found";
+            case 429: return "Too Many Requests";
+            case 500: return "Internal Server Error";
+            case 503: return "Service Unavailable";
+            default: return "Unknown";
+        }
+    }
+
+    auto sendAll(const int fd, const std::string& data) -> bool
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            const ssize_t written = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            sent += static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    // Value of a header in the head of a request, names are case insensitive
+    auto header(const std::string& head, const std::string_view name) -> std::string
+    {
+        size_t line = head.find("\r\n");
+        while (line != std::string::npos && line + 2 < head.size())
+        {
+            const size_t start = line + 2;
+            const size_t end = head.find("\r\n", start);
+            const size_t colon = head.find(':', start);
+
+            if (colon != std::string::npos && colon < end && colon - start == name.size()
+                && std::equal(name.begin(), name.end(), head.begin() + static_cast<std::ptrdiff_t>(start), [](const char a, const char b) { return std::tolower(a) == std::tolower(b); }))
+            {
+                size_t value = colon + 1;
+                while (value < end && head[value] == ' ')
+                {
+                    value++;
+                }
+                return head.substr(value, end - value);
+            }
+
+            line = end;
+        }
+        return "";
+    }
+
+    auto image(const size_t seed, const size_t size) -> std::string
+    {
+        std::string body(size, '\0');
+        for (size_t i = 0; i < size; i++)
+        {
+            body[i] = static_cast<char>((i * 31 + seed * 7919) & 0xff);
+        }
+        return body;
+    }
+}
+
+MockServer::MockServer() = default;
+
+MockServer::~MockServer()
+{
+    stop();
+}
+
+auto MockServer::start() -> bool
+{
+    m_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_fd < 0)
+    {
+        return false;
+    }
+
+    constexpr int enable = 1;
+    ::setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    socklen_t length = sizeof(address);
+    if (::bind(m_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || ::listen(m_fd, SOMAXCONN) != 0
+        || ::getsockname(m_fd, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_port = ntohs(address.sin_port);
+    m_stopping = false;
+    m_accept_thread = std::thread(&MockServer::acceptLoop, this);
+
+    return true;
+}
+
+auto MockServer::stop() -> void
+{
+    if (m_fd < 0)
+    {
+        return;
+    }
+
+    m_stopping = true;
+    ::shutdown(m_fd, SHUT_RDWR);
+    if (m_accept_thread.joinable())
+    {
+        m_accept_thread.join();
+    }
+    ::close(m_fd);
+    m_fd = -1;
+
+    // Wakes the connections blocked in recv
+    std::vector<std::thread> threads;
+    {
+        const std::lock_guard lock(m_connections_mutex);
+        for (const int fd : m_connections)
+        {
+            ::shutdown(fd, SHUT_RDWR);
+        }
+        threads.swap(m_connection_threads);
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+auto MockServer::url(const std::string& path) const -> std::string
+{
+    return fmt::format("http://127.0.0.1:{}{}", m_port, path);
+}
+
+auto MockServer::setBody(const std::string& path, std::string body) -> void
+{
+    Hasher hasher;
+    hasher.update(body.data(), body.size());
+
+    const std::lock_guard lock(m_resources_mutex);
+    auto& resource = m_resources[path];
+    resource.etag = fmt::format("\"{}\"", hasher.hexDigest());
+    resource.body = std::move(body);
+}
+
+auto MockServer::setStatus(const std::string& path, const int status) -> void
+{
+    const std::lock_guard lock(m_resources_mutex);
+    m_resources[path].status = status;
+}
+
+auto MockServer::remove(const std::string& path) -> void
+{
+    const std::lock_guard lock(m_resources_mutex);
+    m_resources.erase(path);
+}
+
+auto MockServer::addCatalog(const std::vector<std::string>& languages, const size_t sets, const size_t cards, const size_t image_size) -> std::vector<std::string>
+{
+    std::vector<std::string> images;
+
+    for (const auto& lang_id : languages)
+    {
+        std::string sets_json = "[";
+
+        for (size_t s = 0; s < sets; s++)
+        {
+            const auto set_id = fmt::format("set{}", s);
+            sets_json += fmt::format("{}{{\"id\":\"{}\",\"name\":\"Set {}\"}}", s == 0 ? "" : ",", set_id, s);
+
+            std::string cards_json = fmt::format(R"({{"id":"{0}","name":"Set {1}","releaseDate":"2020-01-{2:02}","serie":{{"id":"serie{3}"}},"cards":[)", set_id, s, s % 28 + 1, s % 3);
+
+            for (size_t c = 0; c < cards; c++)
+            {
+                const auto image_path = fmt::format("/images/{}/{}/{}", lang_id, set_id, c + 1);
+                cards_json += fmt::format(R"({0}{{"localId":"{1}","name":"Card {1}","image":"{2}"}})", c == 0 ? "" : ",", c + 1, url(image_path));
+
+                setBody(image_path + "/high.jpg", image(images.size(), image_size));
+                images.push_back(url(image_path + "/high.jpg"));
+            }
+
+            cards_json += "]}";
+            setBody(fmt::format("/v2/{}/sets/{}", lang_id, set_id), std::move(cards_json));
+        }
+
+        sets_json += "]";
+        setBody(fmt::format("/v2/{}/sets", lang_id), std::move(sets_json));
+    }
+
+    return images;
+}
+
+auto MockServer::counts() const -> Counts
+{
+    return Counts {m_requests.load(), m_ok.load(), m_not_modified.load(), m_errors.load()};
+}
+
+auto MockServer::resetCounts() -> void
+{
+    m_requests = 0;
+    m_ok = 0;
+    m_not_modified = 0;
+    m_errors = 0;
+}
+
+auto MockServer::acceptLoop() -> void
+{
+    while (!m_stopping)
+    {
+        const int client_fd = ::accept4(m_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client_fd < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+
+        constexpr int enable = 1;
+        ::setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        const std::lock_guard lock(m_connections_mutex);
+        m_connections.push_back(client_fd);
+        m_connection_threads.emplace_back(&MockServer::serve, this, client_fd);
+    }
+}
+
+auto MockServer::serve(const int client_fd) -> void
+{
+    std::string buffer;
+    char chunk[16384];
+
+    while (!m_stopping)
+    {
+        const size_t end = buffer.find("\r\n\r\n");
+        if (end == std::string::npos)
+        {
+            const ssize_t received = ::recv(client_fd, chunk, sizeof(chunk), 0);
+            if (received < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (received <= 0)
+            {
+                break;
+            }
+            buffer.append(chunk, static_cast<size_t>(received));
+            continue;
+        }
+
+        // GET and HEAD only, a request has no body
+        const std::string head = buffer.substr(0, end + 2);
+        buffer.erase(0, end + 4);
+
+        const size_t method_end = head.find(' ');
+        const size_t target_end = head.find(' ', method_end + 1);
+        if (method_end == std::string::npos || target_end == std::string::npos)
+        {
+            break;
+        }
+
+        const auto method = head.substr(0, method_end);
+        auto path = head.substr(method_end + 1, target_end - method_end - 1);
+        if (const size_t query = path.find('?'); query != std::string::npos)
+        {
+            path.resize(query);
+        }
+
+        m_requests++;
+
+        if (!sendAll(client_fd, respond(method, path, header(head, "If-None-Match"))) || header(head, "Connection") == "close")
+        {
+            break;
+        }
+    }
+
+    const std::lock_guard lock(m_connections_mutex);
+    std::erase(m_connections, client_fd);
+    ::close(client_fd);
+}
+
+auto MockServer::respond(const std::string& method, const std::string& path, const std::string& if_none_match) -> std::string
+{
+    int status = 404;
+    std::string etag;
+    std::string body;
+    {
+        const std::lock_guard lock(m_resources_mutex);
+        if (const auto it = m_resources.find(path); it != m_resources.end())
+        {
+            if (it->second.status != 0)
+            {
+                status = it->second.status;
+            }
+            else if (!it->second.etag.empty() && it->second.etag == if_none_match)
+            {
+                status = 304;
+                etag = it->second.etag;
+            }
+            else if (!it->second.etag.empty())
+            {
+                status = 200;
+                etag = it->second.etag;
+                body = it->second.body;
+            }
+        }
+    }
+
+    if (status == 200) m_ok++;
+    else if (status == 304) m_not_modified++;
+    else m_errors++;
+
+    std::string response = fmt::format("HTTP/1.1 {} {}\r\nContent-Length: {}\r\n", status, reason(status), body.size());
+    if (!etag.empty())
+    {
+        response += fmt::format("ETag: {}\r\n", etag);
+    }
+    if (status == 429 || status == 503)
+    {
+        response += "Retry-After: 1\r\n";
+    }
+    response += "\r\n";
+
+    if (method != "HEAD")
+    {
+        response += body;
+    }
+
+    return response;
+}
@@ -0,0 +1,86 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef MOCK_SERVER_H
+#define MOCK_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Deterministic stand-in for the TCGdex API and its image host, on 127.0.0.1.
+// HTTP/1.1 with keep-alive, one thread per connection. Bodies get a strong
+// ETag (their XXH3 digest) and a matching If-None-Match gets a 304.
+class MockServer {
+public:
+    struct Counts {
+        uint64_t requests = 0;
+        uint64_t ok = 0;
+        uint64_t not_modified = 0;
+        uint64_t errors = 0;
+    };
+
+private:
+    struct Resource {
+        std::string body;
+        std::string etag;
+        // Answered instead of the body when not 0
+        int status = 0;
+    };
+
+    int m_fd{-1};
+    uint16_t m_port{0};
+    std::atomic<bool> m_stopping{false};
+    std::thread m_accept_thread;
+
+    std::mutex m_connections_mutex;
+    std::vector<int> m_connections;
+    std::vector<std::thread> m_connection_threads;
+
+    mutable std::mutex m_resources_mutex;
+    std::map<std::string, Resource> m_resources;
+
+    std::atomic<uint64_t> m_requests{0};
+    std::atomic<uint64_t> m_ok{0};
+    std::atomic<uint64_t> m_not_modified{0};
+    std::atomic<uint64_t> m_errors{0};
+
+public:
+    MockServer();
+    ~MockServer();
+
+    MockServer(const MockServer&) = delete;
+    MockServer& operator=(const MockServer&) = delete;
+
+    // Listens on an ephemeral port
+    [[nodiscard]] auto start() -> bool;
+    auto stop() -> void;
+
+    [[nodiscard]] auto port() const -> uint16_t { return m_port; }
+    // http://127.0.0.1:<port><path>
+    [[nodiscard]] auto url(const std::string& path = "") const -> std::string;
+
+    auto setBody(const std::string& path, std::string body) -> void;
+    // Status answered for path whatever the request, 0 to serve the body again
+    auto setStatus(const std::string& path, int status) -> void;
+    auto remove(const std::string& path) -> void;
+
+    // Under /v2/<lang>: sets, sets/<set> and the images the cards point at,
+    // <image>/high.jpg of image_size bytes. Returns the image URLs.
+    auto addCatalog(const std::vector<std::string>& languages, size_t sets, size_t cards, size_t image_size) -> std::vector<std::string>;
+
+    [[nodiscard]] auto counts() const -> Counts;
+    auto resetCounts() -> void;
+
+private:
+    auto acceptLoop() -> void;
+    auto serve(int client_fd) -> void;
+    [[nodiscard]] auto respond(const std::string& method, const std::string& path, const std::string& if_none_match) -> std::string;
+};
+
+#endif //MOCK_SERVER_H
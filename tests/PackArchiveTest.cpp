@@ -0,0 +1,152 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include <fstream>
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+#include "DatabaseManager.h"
+#include "PackArchive.h"
+#include "PackIndexReader.h"
+#include "TestSupport.h"
+
+namespace {
+    auto body(const size_t i) -> std::string
+    {
+        return fmt::format("body of image {} ", i) + std::string(100 + i, static_cast<char>('a' + i % 26));
+    }
+
+    // Appends the body as a download does: from a temporary file the pack takes over
+    auto append(PackArchive& pack_archive, const std::string& group, const size_t i) -> DatabaseManager::PackEntry
+    {
+        const auto temporary_path = pack_archive.temporaryPath();
+        std::ofstream(temporary_path, std::ios::binary) << body(i);
+
+        auto entry = pack_archive.append(group, temporary_path);
+        EXPECT_TRUE(entry.has_value());
+        EXPECT_FALSE(std::filesystem::exists(temporary_path));
+
+        entry->uri = fmt::format("https://assets/en/{}.jpg", i);
+        entry->etag = fmt::format("\"{}\"", i);
+        return *entry;
+    }
+
+    auto read(const std::string& pack, const uint64_t offset, const uint64_t length) -> std::string
+    {
+        std::ifstream ifs(std::filesystem::path("packs") / pack, std::ios::binary);
+        ifs.seekg(static_cast<std::streamoff>(offset));
+
+        std::string content(length, '\0');
+        ifs.read(content.data(), static_cast<std::streamsize>(length));
+        return content;
+    }
+
+    auto packs() -> size_t
+    {
+        size_t count = 0;
+        for (const auto& entry : std::filesystem::directory_iterator("packs"))
+        {
+            count += entry.path().extension() == ".pack";
+        }
+        return count;
+    }
+}
+
+TEST(PackArchive, AppendsBodiesTheIndexFinds)
+{
+    const ScratchDirectory scratch;
+    PackArchive pack_archive;
+
+    std::vector<DatabaseManager::PackEntry> entries;
+    for (size_t i = 0; i < 8; i++)
+    {
+        entries.push_back(append(pack_archive, "en", i));
+    }
+    entries.push_back(append(pack_archive, "fr", 8));
+
+    EXPECT_EQ(pack_archive.groups(), (std::vector<std::string> {"en", "fr"}));
+
+    entries.pop_back();
+    ASSERT_TRUE(pack_archive.writeIndex("en", entries));
+
+    PackIndexReader reader;
+    ASSERT_TRUE(reader.open(pack_archive.indexPath("en").string()));
+    EXPECT_EQ(reader.size(), 8u);
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        const auto location = reader.find(fmt::format("https://assets/en/{}.jpg", i));
+        ASSERT_TRUE(location.has_value());
+        EXPECT_EQ(location->pack, "en-0000.pack");
+        EXPECT_EQ(location->etag, fmt::format("\"{}\"", i));
+        EXPECT_EQ(read(std::string(location->pack), location->offset, location->length), body(i));
+    }
+
+    EXPECT_FALSE(reader.find("https://assets/en/8.jpg").has_value());
+}
+
+TEST(PackArchive, CompactsTheLiveEntriesIntoTheNextGeneration)
+{
+    const ScratchDirectory scratch;
+    PackArchive pack_archive;
+
+    std::vector<DatabaseManager::PackEntry> live;
+    for (size_t i = 0; i < 8; i++)
+    {
+        auto entry = append(pack_archive, "en", i);
+        // Every other image is gone from the catalog
+        if (i % 2 == 0)
+        {
+            live.push_back(std::move(entry));
+        }
+    }
+
+    const auto before = std::filesystem::file_size("packs/en-0000.pack");
+
+    ASSERT_TRUE(pack_archive.compact("en", live));
+    pack_archive.removeInactivePacks("en");
+
+    EXPECT_FALSE(std::filesystem::exists("packs/en-0000.pack"));
+    ASSERT_TRUE(std::filesystem::exists("packs/en-0001.pack"));
+    EXPECT_LT(std::filesystem::file_size("packs/en-0001.pack"), before);
+
+    for (const auto& entry : live)
+    {
+        EXPECT_EQ(entry.pack, "en-0001.pack");
+        const auto i = std::stoul(entry.uri.substr(entry.uri.rfind('/') + 1));
+        EXPECT_EQ(read(entry.pack, entry.offset, entry.length), body(i));
+    }
+
+    // Appends go to the new generation
+    EXPECT_EQ(append(pack_archive, "en", 9).pack, "en-0001.pack");
+}
+
+TEST(PackArchive, AbandonedCompactionKeepsThePreviousGeneration)
+{
+    const ScratchDirectory scratch;
+    PackArchive pack_archive;
+
+    std::vector<DatabaseManager::PackEntry> entries;
+    for (size_t i = 0; i < 4; i++)
+    {
+        entries.push_back(append(pack_archive, "en", i));
+    }
+    const auto previous = entries;
+
+    ASSERT_TRUE(pack_archive.compact("en", entries));
+    EXPECT_EQ(packs(), 2u);
+
+    // The database could not record the new offsets
+    pack_archive.abandonCompaction("en");
+
+    EXPECT_EQ(packs(), 1u);
+    EXPECT_FALSE(std::filesystem::exists("packs/en-0001.pack"));
+    EXPECT_EQ(append(pack_archive, "en", 4).pack, "en-0000.pack");
+
+    for (const auto& entry : previous)
+    {
+        const auto i = std::stoul(entry.uri.substr(entry.uri.rfind('/') + 1));
+        EXPECT_EQ(read(entry.pack, entry.offset, entry.length), body(i));
+    }
+}
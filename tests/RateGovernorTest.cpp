@@ -0,0 +1,109 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include <chrono>
+#include <gtest/gtest.h>
+
+#include "RateGovernor.h"
+
+using namespace std::chrono_literals;
+
+TEST(RateGovernor, ParsesLimits)
+{
+    EXPECT_EQ(RateGovernor::parseRequests("2.5"), 2.5);
+    EXPECT_EQ(RateGovernor::parseRequests("0"), 0.0);
+    EXPECT_FALSE(RateGovernor::parseRequests("-1").has_value());
+    EXPECT_FALSE(RateGovernor::parseRequests("10/s").has_value());
+
+    EXPECT_EQ(RateGovernor::parseBytes("512"), 512u);
+    EXPECT_EQ(RateGovernor::parseBytes("64K"), 64u * 1024);
+    EXPECT_EQ(RateGovernor::parseBytes("2m"), 2u * 1024 * 1024);
+    EXPECT_EQ(RateGovernor::parseBytes("1G"), 1024u * 1024 * 1024);
+    EXPECT_FALSE(RateGovernor::parseBytes("K").has_value());
+    EXPECT_FALSE(RateGovernor::parseBytes("1.5M").has_value());
+    EXPECT_FALSE(RateGovernor::parseBytes("99999999999999999999").has_value());
+
+    EXPECT_EQ(RateGovernor::hostOf("https://user@assets.tcgdex.net:8443/en/swsh?x#y"), "assets.tcgdex.net:8443");
+    EXPECT_EQ(RateGovernor::hostOf("http://127.0.0.1"), "127.0.0.1");
+}
+
+TEST(RateGovernor, AdmitsEverythingWithoutLimits)
+{
+    RateGovernor governor;
+    for (int i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(governor.admit("host"), RateGovernor::Clock::duration::zero());
+    }
+
+    EXPECT_EQ(governor.receiveSpeed("host"), 0);
+}
+
+TEST(RateGovernor, WaitsForRequestTokens)
+{
+    RateGovernor governor;
+    governor.setLimits({.host_requests = 4});
+
+    // A new bucket holds one second of its rate
+    for (int i = 0; i < 4; i++)
+    {
+        ASSERT_EQ(governor.admit("host"), RateGovernor::Clock::duration::zero());
+    }
+
+    const auto wait = governor.admit("host");
+    EXPECT_GT(wait, 0ms);
+    EXPECT_LE(wait, 250ms);
+
+    // Buckets are per host
+    EXPECT_EQ(governor.admit("other"), RateGovernor::Clock::duration::zero());
+}
+
+TEST(RateGovernor, SharesTheBandwidthBetweenRunningTransfers)
+{
+    RateGovernor governor;
+    governor.setLimits({.bytes = 1000, .host_bytes = 300});
+
+    ASSERT_EQ(governor.admit("a"), RateGovernor::Clock::duration::zero());
+    EXPECT_EQ(governor.receiveSpeed("a"), 300);
+
+    const auto shares = governor.shares();
+    ASSERT_EQ(governor.admit("b"), RateGovernor::Clock::duration::zero());
+    ASSERT_EQ(governor.admit("b"), RateGovernor::Clock::duration::zero());
+    ASSERT_EQ(governor.admit("b"), RateGovernor::Clock::duration::zero());
+    ASSERT_EQ(governor.admit("b"), RateGovernor::Clock::duration::zero());
+    EXPECT_NE(governor.shares(), shares);
+
+    // 1000 between 5 transfers, 300 between the 4 of b
+    EXPECT_EQ(governor.receiveSpeed("a"), 200);
+    EXPECT_EQ(governor.receiveSpeed("b"), 75);
+
+    // Alone on its host, the last transfer of b gets the whole host share
+    governor.release("b", 0);
+    governor.release("b", 0);
+    governor.release("b", 0);
+    EXPECT_EQ(governor.receiveSpeed("b"), 300);
+    EXPECT_EQ(governor.receiveSpeed("a"), 300);
+}
+
+TEST(RateGovernor, ChargesBytesAfterTheTransfer)
+{
+    RateGovernor governor;
+    governor.setLimits({.bytes = 1000});
+
+    ASSERT_EQ(governor.admit("host"), RateGovernor::Clock::duration::zero());
+    governor.release("host", 3000);
+
+    // Two seconds of debt to repay
+    const auto wait = governor.admit("host");
+    EXPECT_GT(wait, 1500ms);
+    EXPECT_LE(wait, 2000ms);
+}
+
+TEST(RateGovernor, PausesAHost)
+{
+    RateGovernor governor;
+    governor.pause("host", 30s);
+
+    EXPECT_GT(governor.admit("host"), 29s);
+    EXPECT_EQ(governor.admit("other"), RateGovernor::Clock::duration::zero());
+}
@@ -0,0 +1,174 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include <chrono>
+#include <fcntl.h>
+#include <spawn.h>
+#include <fstream>
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "MockServer.h"
+#include "TestSupport.h"
+
+extern char** environ;
+
+namespace {
+    // Given by CMake, the sync under test is the real executable
+    const char* executable = POKEMONSCRAPER_EXECUTABLE;
+
+    struct Run {
+        int status = -1;
+        double seconds = 0;
+        uint64_t max_rss_kib = 0;
+    };
+
+    // Runs a sync of arguments against the mock, its logs go to sync.log
+    auto runSync(const MockServer& server, std::vector<std::string> arguments) -> Run
+    {
+        arguments.insert(arguments.begin(), {executable, "--api", server.url("/v2")});
+
+        std::vector<char*> argv;
+        for (auto& argument : arguments)
+        {
+            argv.push_back(argument.data());
+        }
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t file_actions;
+        posix_spawn_file_actions_init(&file_actions);
+        posix_spawn_file_actions_addopen(&file_actions, STDOUT_FILENO, "sync.log", O_WRONLY | O_CREAT | O_APPEND, 0644);
+        posix_spawn_file_actions_adddup2(&file_actions, STDOUT_FILENO, STDERR_FILENO);
+
+        Run run;
+        const auto started = std::chrono::steady_clock::now();
+
+        pid_t pid = 0;
+        const int error = posix_spawn(&pid, executable, &file_actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&file_actions);
+
+        if (error != 0)
+        {
+            return run;
+        }
+
+        rusage usage{};
+        if (::wait4(pid, &run.status, 0, &usage) != pid)
+        {
+            run.status = -1;
+            return run;
+        }
+
+        run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        run.max_rss_kib = static_cast<uint64_t>(usage.ru_maxrss);
+
+        return run;
+    }
+
+    auto succeeded(const Run& run) -> bool
+    {
+        return WIFEXITED(run.status) && WEXITSTATUS(run.status) == 0;
+    }
+
+    auto lines(const std::filesystem::path& path) -> size_t
+    {
+        std::ifstream stream(path);
+        size_t count = 0;
+        for (std::string line; std::getline(stream, line);)
+        {
+            count++;
+        }
+        return count;
+    }
+
+    class SyncTest : public ::testing::Test {
+    protected:
+        ScratchDirectory m_scratch;
+        MockServer m_server;
+
+        auto SetUp() -> void override
+        {
+            ASSERT_TRUE(m_server.start());
+        }
+    };
+}
+
+TEST_F(SyncTest, SecondRunOnlyRevalidatesTheJson)
+{
+    constexpr size_t sets = 4;
+    constexpr size_t cards = 10;
+    const auto images = m_server.addCatalog({"en"}, sets, cards, 2048);
+
+    const auto first = runSync(m_server, {"--lang", "en"});
+    ASSERT_TRUE(succeeded(first)) << "see " << (m_scratch.path() / "sync.log").string();
+
+    EXPECT_EQ(m_server.counts().ok, 1 + sets + images.size());
+    EXPECT_TRUE(std::filesystem::exists("data/en/set0/1_high_Card 1.jpg"));
+    EXPECT_TRUE(std::filesystem::exists("catalog/en.cat"));
+    EXPECT_EQ(lines("changes.ndjson"), 1 + sets + images.size() + 1 + 1);
+
+    m_server.resetCounts();
+
+    const auto second = runSync(m_server, {"--lang", "en"});
+    ASSERT_TRUE(succeeded(second));
+
+    // Unchanged cards.json: their images were validated under the same ETag
+    const auto counts = m_server.counts();
+    EXPECT_EQ(counts.requests, 1 + sets);
+    EXPECT_EQ(counts.not_modified, 1 + sets);
+    EXPECT_EQ(counts.ok, 0u);
+}
+
+TEST_F(SyncTest, ChangedSetIsDownloadedAgain)
+{
+    m_server.addCatalog({"en"}, 2, 3, 1024);
+    ASSERT_TRUE(succeeded(runSync(m_server, {"--lang", "en"})));
+
+    // A card added to set1 changes its cards.json and its ETag
+    m_server.setBody("/v2/en/sets/set1", fmt::format(R"({{"id":"set1","name":"Set 1","cards":[{{"localId":"9","name":"New","image":"{}"}}]}})", m_server.url("/images/new")));
+    m_server.setBody("/images/new/high.jpg", std::string(512, 'n'));
+    m_server.resetCounts();
+
+    ASSERT_TRUE(succeeded(runSync(m_server, {"--lang", "en"})));
+
+    EXPECT_EQ(m_server.counts().ok, 2u);
+    EXPECT_EQ(std::filesystem::file_size("data/en/set1/9_high_New.jpg"), 512u);
+}
+
+TEST_F(SyncTest, FailedImagesAreRequestedAgain)
+{
+    m_server.addCatalog({"en"}, 1, 3, 1024);
+    m_server.setStatus("/images/en/set0/2/high.jpg", 500);
+
+    ASSERT_TRUE(succeeded(runSync(m_server, {"--lang", "en"})));
+    EXPECT_FALSE(std::filesystem::exists("data/en/set0/2_high_Card 2.jpg"));
+
+    m_server.setStatus("/images/en/set0/2/high.jpg", 0);
+    m_server.resetCounts();
+
+    ASSERT_TRUE(succeeded(runSync(m_server, {"--lang", "en"})));
+    EXPECT_TRUE(std::filesystem::exists("data/en/set0/2_high_Card 2.jpg"));
+}
+
+TEST_F(SyncTest, BudgetFullSync)
+{
+    constexpr size_t sets = 10;
+    constexpr size_t cards = 100;
+    const auto images = m_server.addCatalog({"en"}, sets, cards, 16 * 1024);
+
+    const auto run = runSync(m_server, {"--lang", "en"});
+    ASSERT_TRUE(succeeded(run));
+    ASSERT_EQ(m_server.counts().ok, 1 + sets + images.size());
+
+    const double requests_per_second = static_cast<double>(m_server.counts().requests) / run.seconds;
+
+    RecordProperty("requests_per_second", fmt::format("{:.0f}", requests_per_second));
+    RecordProperty("max_rss_kib", std::to_string(run.max_rss_kib));
+
+    // Start-up, planning and the catalog are in the time, hence half the floor of the transfers alone
+    EXPECT_GE(requests_per_second, Budget::min_requests_per_second / 2);
+    EXPECT_LE(run.max_rss_kib, Budget::max_rss_kib);
+}
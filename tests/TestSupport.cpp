@@ -0,0 +1,60 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#include "TestSupport.h"
+
+#include <atomic>
+#include <unistd.h>
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <sys/resource.h>
+
+#include "Logs.h"
+
+ScratchDirectory::ScratchDirectory()
+    : m_previous(std::filesystem::current_path())
+{
+    static std::atomic<int> counter{0};
+
+    const auto* test = ::testing::UnitTest::GetInstance()->current_test_info();
+    m_path = std::filesystem::temp_directory_path() / fmt::format("pokemonscraper-{}-{}-{}", test ? test->name() : "test", ::getpid(), counter++);
+
+    std::filesystem::remove_all(m_path);
+    std::filesystem::create_directories(m_path);
+    std::filesystem::current_path(m_path);
+}
+
+ScratchDirectory::~ScratchDirectory()
+{
+    std::error_code ec;
+    std::filesystem::current_path(m_previous, ec);
+    std::filesystem::remove_all(m_path, ec);
+}
+
+auto maxRssKiB() -> uint64_t
+{
+    rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss);
+}
+
+auto childrenMaxRssKiB() -> uint64_t
+{
+    rusage usage{};
+    ::getrusage(RUSAGE_CHILDREN, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss);
+}
+
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+
+    // Failures only, the suite checks results rather than log lines
+    Logs::Initialize();
+    Logs::GetAppLogger()->set_level(spdlog::level::warn);
+    Logs::GetDbLogger()->set_level(spdlog::level::warn);
+    Logs::GetCurlLogger()->set_level(spdlog::level::err);
+
+    return RUN_ALL_TESTS();
+}
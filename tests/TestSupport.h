@@ -0,0 +1,48 @@
+//
+// Created by Zéro Cool on 18/10/2026.
+//
+
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <cstdint>
+#include <filesystem>
+
+// Budgets the suite fails on, about five times what a laptop measures: loose
+// enough for a loaded CI machine, tight enough to catch a regression by a
+// factor (a transfer path that allocates per chunk, a commit per row, a sync
+// that keeps every body in memory).
+namespace Budget {
+    // Small images from the loopback mock, 50 transfers in parallel
+    inline constexpr double min_requests_per_second = 500.0;
+    // Heap allocations of the calling thread per image downloaded, curl's included
+    inline constexpr double max_allocations_per_transfer = 64.0;
+    // One transaction per batch of results, not per row
+    inline constexpr double max_commits_per_transfer = 0.05;
+    // Peak resident set of a test process, and of a whole sync run
+    inline constexpr uint64_t max_rss_kib = 128 * 1024;
+}
+
+// Fresh directory the test runs in: the components write under relative
+// paths (data/, objects/, catalog/). The previous directory is restored and
+// the scratch one removed on destruction.
+class ScratchDirectory {
+    std::filesystem::path m_previous;
+    std::filesystem::path m_path;
+
+public:
+    ScratchDirectory();
+    ~ScratchDirectory();
+
+    ScratchDirectory(const ScratchDirectory&) = delete;
+    ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+    [[nodiscard]] auto path() const -> const std::filesystem::path& { return m_path; }
+};
+
+// Peak resident set size of the process, in KiB
+[[nodiscard]] auto maxRssKiB() -> uint64_t;
+// Of the children waited for so far
+[[nodiscard]] auto childrenMaxRssKiB() -> uint64_t;
+
+#endif //TEST_SUPPORT_H